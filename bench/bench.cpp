@@ -0,0 +1,147 @@
+#include "bench.h"
+
+#include <iostream>
+#include <thread>
+
+void bench_emit(const bench_options &opt, const char *suite, const char *bench,
+                std::initializer_list<std::pair<const char *, bench_value>> fields)
+{
+    std::string line = std::string("{\"suite\":\"") + suite + "\",\"bench\":\"" + bench + "\"";
+
+    for (auto &[key, value] : fields)
+    {
+        char number[64];
+
+        line += std::string(",\"") + key + "\":";
+        if (auto s = std::get_if<std::string>(&value))
+            line += "\"" + *s + "\"";
+        else if (auto d = std::get_if<double>(&value))
+            line += (snprintf(number, sizeof(number), "%.3f", *d), number);
+        else
+            line += std::to_string(std::get<long>(value));
+    }
+
+    line += "}\n";
+    fputs(line.c_str(), opt.out);
+    fflush(opt.out);
+}
+
+bool bench_selected(const bench_options &opt, const char *bench)
+{
+    return opt.filter.empty() || std::string(bench).find(opt.filter) != std::string::npos;
+}
+
+std::string bench_format_name(uint32_t format)
+{
+    std::string name;
+
+    for (int i = 0; i < 4; i++)
+        name += (char)((format >> (i * 8)) & 0xFF);
+
+    // trailing spaces of short fourcc
+    name.erase(name.find_last_not_of(' ') + 1);
+
+    return name;
+}
+
+static void bench_usage(const char *app)
+{
+    std::cerr << "Usage: " << app << " [options]\n"
+              << "  --micro            microbenchmarks only, no display needed (default)\n"
+              << "  --e2e              end-to-end benchmarks only, needs /dev/dri/card0\n"
+              << "  --headless         end-to-end on in-memory display, same as XDRM_BACKEND=headless\n"
+              << "  --all              both suites\n"
+              << "  --filter <name>    run benchmarks whose name contains name\n"
+              << "  --time-ms <ms>     minimum time per microbenchmark, default 200\n"
+              << "  --seconds <s>      time per end-to-end case, default 2\n"
+              << "  --out <file>       write JSON lines to file instead of stdout\n"
+              << "  --conn <id> --crtc <id> --plane <id>   output for end-to-end cases\n"
+              << "  --connector <name> output for end-to-end cases by name, e.g. DSI-1\n";
+}
+
+int main(int argc, char **argv)
+{
+    bench_options opt;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (arg == "--micro")
+        {
+            opt.micro = true;
+            opt.e2e = false;
+        }
+        else if (arg == "--e2e")
+        {
+            opt.micro = false;
+            opt.e2e = true;
+        }
+        else if (arg == "--all")
+        {
+            opt.micro = opt.e2e = true;
+        }
+        else if (arg == "--headless")
+            xDRM_Set_Backend(&xdrm_backend_headless);
+        else if (value && arg == "--filter")
+            opt.filter = argv[++i];
+        else if (value && arg == "--time-ms")
+            opt.time_ms = atof(argv[++i]);
+        else if (value && arg == "--seconds")
+            opt.e2e_seconds = atof(argv[++i]);
+        else if (value && arg == "--conn")
+            opt.conn_id = strtoul(argv[++i], nullptr, 0);
+        else if (value && arg == "--crtc")
+            opt.crtc_id = strtoul(argv[++i], nullptr, 0);
+        else if (value && arg == "--plane")
+            opt.plane_id = strtoul(argv[++i], nullptr, 0);
+        else if (value && arg == "--connector")
+            opt.connector = argv[++i];
+        else if (value && arg == "--out")
+        {
+            opt.out = fopen(argv[++i], "w");
+            if (!opt.out)
+            {
+                perror("fopen");
+                return 1;
+            }
+        }
+        else
+        {
+            bench_usage(argv[0]);
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // library logs go to stderr, stdout only carries results
+    if (opt.out == stdout)
+    {
+        int fd = dup(STDOUT_FILENO);
+
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        opt.out = fd >= 0 ? fdopen(fd, "w") : nullptr;
+        if (!opt.out)
+        {
+            perror("fdopen");
+            return 1;
+        }
+    }
+
+    // machine info first, results are only comparable on the same CPU and kernel
+    bench_emit(opt, "meta", "host", {
+        {"cpus", (long)std::thread::hardware_concurrency()},
+        {"copy_kernel", std::string(xDRM_Copy_Kernel_Name(xDRM_Copy_Get_Kernel()))},
+        {"backend", std::string(xDRM_Get_Backend()->name)},
+        {"time_ms", opt.time_ms},
+    });
+
+    if (opt.micro)
+        bench_micro(opt);
+    if (opt.e2e)
+        bench_e2e(opt);
+
+    fclose(opt.out);
+
+    return 0;
+}
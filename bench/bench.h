@@ -0,0 +1,98 @@
+#pragma once
+
+#include "xdrm/xdrm.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <variant>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+
+struct bench_options
+{
+    // minimum time per measured case
+    double time_ms = 200;
+    // seconds per end-to-end case
+    double e2e_seconds = 2;
+    bool micro = true;
+    bool e2e = false;
+    // run only benchmarks whose name contains filter
+    std::string filter;
+    FILE *out = stdout;
+
+    uint32_t conn_id = CONN_ID_DSI1;
+    uint32_t crtc_id = CRTC_ID_DSI1;
+    uint32_t plane_id = PLANE_ID_DSI1;
+    // connector name like "DSI-1", takes the place of ids above when set
+    std::string connector;
+};
+
+using bench_value = std::variant<std::string, double, long>;
+
+struct bench_timing
+{
+    long iters;
+    double ns_median;
+    double ns_min;
+};
+
+/**
+ * @brief Write one result as a JSON line, suite and bench come first.
+ */
+void bench_emit(const bench_options &opt, const char *suite, const char *bench,
+                std::initializer_list<std::pair<const char *, bench_value>> fields);
+
+bool bench_selected(const bench_options &opt, const char *bench);
+
+std::string bench_format_name(uint32_t format);
+
+inline double bench_now_ns()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Time f, 5 batches each long enough for a fifth of opt.time_ms after one warm up call.
+ */
+template <class F>
+bench_timing bench_run(const bench_options &opt, F &&f)
+{
+    std::vector<double> batches;
+    long iters = 1;
+    double t;
+
+    f();
+
+    // grow batch until it takes a fifth of the budget
+    for (;;)
+    {
+        t = bench_now_ns();
+        for (long i = 0; i < iters; i++)
+            f();
+        t = bench_now_ns() - t;
+
+        if (t >= opt.time_ms * 1e6 / 5 || iters >= (1l << 30))
+            break;
+        iters *= 2;
+    }
+
+    batches.push_back(t / iters);
+    for (int b = 1; b < 5; b++)
+    {
+        t = bench_now_ns();
+        for (long i = 0; i < iters; i++)
+            f();
+        batches.push_back((bench_now_ns() - t) / iters);
+    }
+
+    std::sort(batches.begin(), batches.end());
+
+    return {iters * 5, batches[2], batches[0]};
+}
+
+void bench_micro(const bench_options &opt);
+
+void bench_e2e(const bench_options &opt);
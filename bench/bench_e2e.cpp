@@ -0,0 +1,469 @@
+#include "bench.h"
+
+#include <thread>
+#include <atomic>
+#include <signal.h>
+#include <sys/wait.h>
+
+static const uint32_t bench_formats[] = {
+    DRM_FORMAT_ARGB8888,
+    DRM_FORMAT_XRGB8888,
+    DRM_FORMAT_RGB565,
+    DRM_FORMAT_YUYV,
+    DRM_FORMAT_NV12,
+    DRM_FORMAT_NV16,
+};
+
+static const uint32_t bench_sizes[][2] = {
+    {640, 512},
+    {1280, 720},
+    {1920, 1080},
+};
+
+// size of a packed frame for xDRM_Push
+static size_t bench_frame_bytes(uint32_t format, uint32_t width, uint32_t height)
+{
+    switch (format)
+    {
+        case DRM_FORMAT_RGB565:
+        case DRM_FORMAT_YUYV:
+        case DRM_FORMAT_NV16:
+            return (size_t)width * height * 2;
+        case DRM_FORMAT_NV12:
+            return (size_t)width * height * 3 / 2;
+        default:
+            return (size_t)width * height * 4;
+    }
+}
+
+// keeps lookups which have no side effect
+static volatile uint32_t bench_sink;
+
+static double bench_percentile(std::vector<double> &v, double p)
+{
+    if (v.empty())
+        return 0;
+
+    std::sort(v.begin(), v.end());
+
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+/**
+ * @brief Run case in a child process, xDRM_Draw never returns, the display is released when the child exits.
+ */
+template <class F>
+static void bench_fork(const bench_options &opt, const char *bench, const std::string &variant, F &&f)
+{
+    double deadline;
+    int status = 0;
+    pid_t pid;
+
+    fflush(opt.out);
+    fflush(stdout);
+
+    pid = fork();
+    if (pid == 0)
+    {
+        f();
+        fflush(opt.out);
+        _exit(0);
+    }
+
+    if (pid < 0)
+    {
+        bench_emit(opt, "e2e", bench, {{"variant", variant}, {"error", std::string(strerror(errno))}});
+        return;
+    }
+
+    // a case which cannot flip never ends by itself
+    deadline = bench_now_ns() + (opt.e2e_seconds + 10) * 1e9;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+        if (bench_now_ns() > deadline)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            bench_emit(opt, "e2e", bench, {{"variant", variant}, {"error", std::string("timeout")}});
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+static int bench_init(const bench_options &opt, struct modeset_dev **dev, uint32_t width, uint32_t height, uint32_t format)
+{
+    if (!opt.connector.empty())
+        return xDRM_Init_Connector(dev, opt.connector.c_str(), width, height, 0, 0, 0, format);
+
+    return xDRM_Init(dev, opt.conn_id, opt.crtc_id, opt.plane_id, width, height, 0, 0, 0, format);
+}
+
+static int bench_open(const bench_options &opt, struct modeset_dev **dev, uint32_t width, uint32_t height, uint32_t format)
+{
+    int fd = bench_init(opt, dev, width, height, format);
+
+    if (fd >= 0)
+    {
+        std::thread([fd, dev] { xDRM_Draw(fd, *dev); }).detach();
+    }
+
+    return fd;
+}
+
+/**
+ * @brief TEST_ONLY commit of current front buffer, kernel atomic check without a flip.
+ */
+static double bench_commit_test(int fd, struct modeset_dev *dev, long *iters)
+{
+    drmModeAtomicReq *req = xdrm_backend->atomic_alloc();
+    double ns = 0;
+    long n = 0;
+
+    if (!req)
+        return 0;
+
+    for (double end = bench_now_ns() + 2e8; bench_now_ns() < end; n++)
+    {
+        double t;
+
+        xdrm_backend->atomic_set_cursor(req, 0);
+        xdrm_backend->atomic_add_property(req, dev->plane.id, dev->plane_props[MODESET_PLANE_FB_ID], dev->bufs[0].fb);
+        xdrm_backend->atomic_add_property(req, dev->plane.id, dev->plane_props[MODESET_PLANE_CRTC_ID], dev->crtc.id);
+
+        t = bench_now_ns();
+        xdrm_backend->atomic_commit(fd, req, DRM_MODE_ATOMIC_TEST_ONLY, NULL);
+        ns += bench_now_ns() - t;
+    }
+
+    xdrm_backend->atomic_free(req);
+    *iters = n;
+
+    return n ? ns / n : 0;
+}
+
+static void bench_frame(const bench_options &opt, uint32_t format, uint32_t width, uint32_t height)
+{
+    std::string variant = bench_format_name(format) + "_" + std::to_string(width) + "x" + std::to_string(height);
+
+    bench_fork(opt, "frame", variant, [&] {
+        struct modeset_dev *dev = nullptr;
+        std::vector<uint8_t> frame(bench_frame_bytes(format, width, height), 0x80);
+        std::vector<double> push, present;
+        struct modeset_latency_stats latency;
+        struct modeset_stats before, after;
+        double start, elapsed, commit_ns;
+        long flips, commit_iters = 0;
+        int fd, busy = 0;
+
+        fd = bench_open(opt, &dev, width, height, format);
+        if (fd < 0)
+        {
+            bench_emit(opt, "e2e", "frame", {{"variant", variant}, {"error", std::string("init failed")}});
+            return;
+        }
+
+        if (format == DRM_FORMAT_ARGB8888 || format == DRM_FORMAT_XRGB8888)
+            xDRM_Pattern_Fill(frame.data(), width * 4, width, height, XDRM_PATTERN_BAR, 0);
+
+        // warm up, pacer locks to vblank
+        for (int i = 0; i < 30; i++)
+        {
+            xDRM_Push(dev, (uint32_t *)frame.data(), frame.size());
+            xDRM_Wait_Present(dev);
+        }
+
+        // lock step, one frame per present
+        xDRM_ResetLatencyStats(dev);
+        xDRM_GetStats(dev, &before);
+        flips = dev->fps_stats.total_frames;
+        start = bench_now_ns();
+        while ((elapsed = bench_now_ns() - start) < opt.e2e_seconds * 1e9)
+        {
+            double t0 = bench_now_ns(), t1;
+            int ret = xDRM_Push(dev, (uint32_t *)frame.data(), frame.size());
+
+            t1 = bench_now_ns();
+            xDRM_Wait_Present(dev);
+
+            if (ret < 0)
+            {
+                busy++;
+                continue;
+            }
+            push.push_back(t1 - t0);
+            present.push_back(bench_now_ns() - t0);
+        }
+        flips = dev->fps_stats.total_frames - flips;
+        xDRM_GetLatencyStats(dev, &latency);
+        xDRM_GetStats(dev, &after);
+
+        commit_ns = bench_commit_test(fd, dev, &commit_iters);
+
+        bench_emit(opt, "e2e", "frame", {
+            {"variant", variant}, {"format", bench_format_name(format)},
+            {"width", (long)width}, {"height", (long)height},
+            {"frames", (long)push.size()}, {"busy", (long)busy},
+            {"fps", push.size() / elapsed * 1e9}, {"flips_per_s", flips / elapsed * 1e9},
+            {"push_ns_p50", bench_percentile(push, 0.5)}, {"push_ns_p99", bench_percentile(push, 0.99)},
+            {"present_ns_p50", bench_percentile(present, 0.5)}, {"present_ns_p99", bench_percentile(present, 0.99)},
+            {"present_ns_max", bench_percentile(present, 1)},
+            {"queue_ns_p99", (double)latency.stage[XDRM_LATENCY_QUEUE].p99_ns},
+            {"scanout_ns_p99", (double)latency.stage[XDRM_LATENCY_SCANOUT].p99_ns},
+            {"total_ns_p50", (double)latency.stage[XDRM_LATENCY_TOTAL].p50_ns},
+            {"total_ns_p99", (double)latency.stage[XDRM_LATENCY_TOTAL].p99_ns},
+            {"missed_vblanks", (long)(after.missed_vblanks - before.missed_vblanks)},
+            {"repeated", (long)(after.repeated - before.repeated)},
+            {"commit_test_ns", commit_ns}, {"commit_test_iters", commit_iters},
+        });
+    });
+}
+
+static void bench_push_contention(const bench_options &opt, uint32_t threads)
+{
+    const uint32_t width = 1920, height = 1080;
+    std::string variant = std::to_string(threads) + "_threads";
+
+    bench_fork(opt, "push_contention", variant, [&] {
+        struct modeset_dev *dev = nullptr;
+        std::vector<uint32_t> frame((size_t)width * height, 0xFF808080);
+        std::vector<std::thread> producers;
+        std::atomic<long> pushed{0}, busy{0}, push_ns{0};
+        double start;
+
+        if (bench_open(opt, &dev, width, height, DRM_FORMAT_ARGB8888) < 0)
+        {
+            bench_emit(opt, "e2e", "push_contention", {{"variant", variant}, {"error", std::string("init failed")}});
+            return;
+        }
+
+        // free running producers, frames beyond the queue are dropped by the mailbox
+        start = bench_now_ns();
+        for (uint32_t i = 0; i < threads; i++)
+        {
+            producers.emplace_back([&] {
+                while (bench_now_ns() - start < opt.e2e_seconds * 1e9)
+                {
+                    double t = bench_now_ns();
+                    int ret = xDRM_Push(dev, frame.data(), frame.size() * 4);
+
+                    if (ret < 0)
+                    {
+                        busy++;
+                        continue;
+                    }
+                    pushed++;
+                    push_ns += (long)(bench_now_ns() - t);
+                }
+            });
+        }
+
+        for (auto &th : producers)
+            th.join();
+
+        bench_emit(opt, "e2e", "push_contention", {
+            {"variant", variant}, {"threads", (long)threads},
+            {"width", (long)width}, {"height", (long)height}, {"format", std::string("AR24")},
+            {"pushes_per_s", pushed / opt.e2e_seconds}, {"busy_per_s", busy / opt.e2e_seconds},
+            {"push_ns_avg", pushed ? (double)push_ns / pushed : 0.0},
+        });
+    });
+}
+
+/**
+ * @brief Push to glass latency of vsynced flips against async flips, producer at refresh rate.
+ */
+static void bench_flip_mode(const bench_options &opt, bool async)
+{
+    const uint32_t width = 640, height = 512;
+    std::string variant = async ? "async" : "vsync";
+
+    bench_fork(opt, "flip_mode", variant, [&] {
+        struct modeset_dev *dev = nullptr;
+        std::vector<uint32_t> frame((size_t)width * height, 0xFF808080);
+        struct modeset_latency_stats latency;
+        struct modeset_stats before, after;
+        double start, elapsed;
+        long frames = 0;
+        int ret = 0;
+
+        if (bench_open(opt, &dev, width, height, DRM_FORMAT_ARGB8888) < 0)
+        {
+            bench_emit(opt, "e2e", "flip_mode", {{"variant", variant}, {"error", std::string("init failed")}});
+            return;
+        }
+
+        if (async)
+            ret = xDRM_Set_Async_Flip(dev, true);
+        if (ret < 0)
+        {
+            bench_emit(opt, "e2e", "flip_mode", {{"variant", variant}, {"error", std::string(strerror(-ret))}});
+            return;
+        }
+
+        // warm up, pacer locks to vblank
+        for (int i = 0; i < 30; i++)
+        {
+            xDRM_Push(dev, frame.data(), frame.size() * 4);
+            xDRM_Wait_Present(dev);
+        }
+
+        xDRM_ResetLatencyStats(dev);
+        xDRM_GetStats(dev, &before);
+        start = bench_now_ns();
+        while (bench_now_ns() - start < opt.e2e_seconds * 1e9)
+        {
+            frame[frames % frame.size()] = (uint32_t)frames;
+            xDRM_Push(dev, frame.data(), frame.size() * 4);
+            xDRM_Wait_Present(dev);
+            frames++;
+        }
+        elapsed = bench_now_ns() - start;
+        xDRM_GetStats(dev, &after);
+        xDRM_GetLatencyStats(dev, &latency);
+
+        bench_emit(opt, "e2e", "flip_mode", {
+            {"variant", variant}, {"width", (long)width}, {"height", (long)height},
+            {"frames", frames}, {"fps", frames / elapsed * 1e9},
+            {"presented", (long)(after.presented - before.presented)},
+            {"total_ns_p50", (double)latency.stage[XDRM_LATENCY_TOTAL].p50_ns},
+            {"total_ns_p99", (double)latency.stage[XDRM_LATENCY_TOTAL].p99_ns},
+            {"scanout_ns_p50", (double)latency.stage[XDRM_LATENCY_SCANOUT].p50_ns},
+            {"commit_ns_p50", (double)latency.stage[XDRM_LATENCY_COMMIT].p50_ns},
+        });
+    });
+}
+
+static void bench_prop_lookup(const bench_options &opt)
+{
+    bench_fork(opt, "prop_lookup", "plane", [&] {
+        drmModeObjectProperties *props;
+        std::vector<drmModePropertyRes *> info;
+        const struct xdrm_backend *backend = xDRM_Get_Backend();
+        int fd = backend->open();
+
+        if (fd < 0 || backend->set_client_cap(fd, DRM_CLIENT_CAP_ATOMIC, 1))
+        {
+            bench_emit(opt, "e2e", "prop_lookup", {{"variant", std::string("plane")}, {"error", std::string("no atomic device")}});
+            return;
+        }
+
+        props = backend->get_object_properties(fd, opt.plane_id, DRM_MODE_OBJECT_PLANE);
+        if (!props)
+        {
+            bench_emit(opt, "e2e", "prop_lookup", {{"variant", std::string("plane")}, {"error", std::string("no plane")}});
+            return;
+        }
+        for (uint32_t i = 0; i < props->count_props; i++)
+            info.push_back(backend->get_property(fd, props->props[i]));
+
+        // by name through ioctl per property, as setup resolves them
+        auto ioctl_lookup = bench_run(opt, [&] {
+            for (uint32_t i = 0; i < props->count_props; i++)
+            {
+                drmModePropertyRes *p = backend->get_property(fd, props->props[i]);
+                bool found = p && !strcmp(p->name, "FB_DAMAGE_CLIPS");
+
+                backend->free_property(p);
+                if (found)
+                    break;
+            }
+        });
+        bench_emit(opt, "e2e", "prop_lookup", {
+            {"variant", std::string("ioctl")}, {"props", (long)props->count_props},
+            {"iters", ioctl_lookup.iters}, {"ns_per_iter", ioctl_lookup.ns_median}, {"ns_min", ioctl_lookup.ns_min},
+        });
+
+        // by name through cached property info
+        auto cached_lookup = bench_run(opt, [&] {
+            for (auto p : info)
+            {
+                if (p && !strcmp(p->name, "FB_DAMAGE_CLIPS"))
+                {
+                    bench_sink = p->prop_id;
+                    break;
+                }
+            }
+        });
+        bench_emit(opt, "e2e", "prop_lookup", {
+            {"variant", std::string("cached")}, {"props", (long)props->count_props},
+            {"iters", cached_lookup.iters}, {"ns_per_iter", cached_lookup.ns_median}, {"ns_min", cached_lookup.ns_min},
+        });
+    });
+}
+
+/**
+ * @brief Cold start, open and modeset by xDRM_Init, then until the first pushed frame is on screen.
+ */
+static void bench_startup(const bench_options &opt)
+{
+    bench_fork(opt, "startup", "AR24_640x512", [&] {
+        std::vector<uint32_t> frame(640 * 512, 0xFF808080);
+        std::vector<double> init, first_frame;
+
+        for (double end = bench_now_ns() + opt.e2e_seconds * 1e9; bench_now_ns() < end || init.empty();)
+        {
+            struct modeset_dev *dev = nullptr;
+            struct modeset_latency_stats latency = {};
+            double start = bench_now_ns(), inited;
+            int fd = bench_init(opt, &dev, 640, 512, DRM_FORMAT_ARGB8888);
+
+            if (fd < 0)
+            {
+                bench_emit(opt, "e2e", "startup", {{"variant", std::string("AR24_640x512")}, {"error", std::string("init failed")}});
+                return;
+            }
+            inited = bench_now_ns();
+
+            // latency of a frame is recorded by the flip event which put it on screen
+            std::thread draw([fd, dev] { xDRM_Draw(fd, dev); });
+            xDRM_Push(dev, frame.data(), frame.size() * sizeof(uint32_t));
+            while (!latency.stage[XDRM_LATENCY_TOTAL].count && bench_now_ns() < end + 1e9)
+            {
+                usleep(100);
+                xDRM_GetLatencyStats(dev, &latency);
+            }
+
+            init.push_back(inited - start);
+            first_frame.push_back(bench_now_ns() - start);
+
+            xDRM_Stop_Draw(dev);
+            draw.join();
+            xDRM_Exit(fd, dev);
+        }
+
+        bench_emit(opt, "e2e", "startup", {
+            {"variant", std::string("AR24_640x512")}, {"runs", (long)init.size()},
+            {"init_ns_p50", bench_percentile(init, 0.5)}, {"init_ns_max", bench_percentile(init, 1)},
+            {"first_frame_ns_p50", bench_percentile(first_frame, 0.5)}, {"first_frame_ns_max", bench_percentile(first_frame, 1)},
+        });
+    });
+}
+
+void bench_e2e(const bench_options &opt)
+{
+    if (bench_selected(opt, "startup"))
+        bench_startup(opt);
+
+    if (bench_selected(opt, "prop_lookup"))
+        bench_prop_lookup(opt);
+
+    if (bench_selected(opt, "frame"))
+    {
+        for (auto format : bench_formats)
+            for (auto &size : bench_sizes)
+                bench_frame(opt, format, size[0], size[1]);
+    }
+
+    if (bench_selected(opt, "push_contention"))
+    {
+        for (uint32_t threads = 1; threads <= 4; threads *= 2)
+            bench_push_contention(opt, threads);
+    }
+
+    if (bench_selected(opt, "flip_mode"))
+    {
+        bench_flip_mode(opt, false);
+        bench_flip_mode(opt, true);
+    }
+}
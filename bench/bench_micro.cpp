@@ -0,0 +1,202 @@
+#include "bench.h"
+
+#include <thread>
+
+// frame sizes of the panel, 1080p and 4K
+static const uint32_t bench_sizes[][2] = {
+    {640, 512},
+    {1920, 1080},
+    {3840, 2160},
+};
+
+// dumb buffers are pitched to 64 bytes
+static uint32_t bench_pitch(uint32_t row)
+{
+    return (row + 63) & ~63u;
+}
+
+static void bench_copy(const bench_options &opt)
+{
+    for (auto &size : bench_sizes)
+    {
+        uint32_t row = size[0] * 4;
+        uint32_t pitch = bench_pitch(row);
+        std::vector<uint8_t> src((size_t)row * size[1], 0x5A);
+        std::vector<uint8_t> dst((size_t)pitch * size[1]);
+
+        for (int kernel = XDRM_COPY_SCALAR; kernel < XDRM_COPY_KERNEL_NUM; kernel++)
+        {
+            if (xDRM_Copy_Set_Kernel((enum xdrm_copy_kernel)kernel))
+                continue;
+
+            auto t = bench_run(opt, [&] { xDRM_Copy(dst.data(), pitch, src.data(), row, row, size[1]); });
+            bench_emit(opt, "micro", "copy", {
+                {"variant", std::string(xDRM_Copy_Kernel_Name((enum xdrm_copy_kernel)kernel))},
+                {"width", (long)size[0]}, {"height", (long)size[1]}, {"format", std::string("AR24")},
+                {"iters", t.iters}, {"ns_per_iter", t.ns_median}, {"ns_min", t.ns_min},
+                {"mb_per_s", (double)row * size[1] / t.ns_median * 1e3},
+            });
+        }
+    }
+
+    xDRM_Copy_Set_Kernel(XDRM_COPY_AUTO);
+}
+
+static void bench_pattern(const bench_options &opt)
+{
+    static const char *names[] = {"color", "bar", "checkerboard", "barcode", "flash"};
+    uint32_t width = 1920, height = 1080;
+    std::vector<uint8_t> dst((size_t)bench_pitch(width * 4) * height);
+    std::vector<int> threads = {1};
+
+    for (int n = 2; n <= (int)std::thread::hardware_concurrency() && n <= XDRM_PATTERN_THREAD_MAX; n *= 2)
+        threads.push_back(n);
+
+    for (int pattern = XDRM_PATTERN_COLOR; pattern < XDRM_PATTERN_CYCLE; pattern++)
+    {
+        for (int n : threads)
+        {
+            int frame = 0;
+
+            xDRM_Pattern_Set_Threads(n);
+            auto t = bench_run(opt, [&] {
+                xDRM_Pattern_Fill(dst.data(), bench_pitch(width * 4), width, height, (enum xdrm_pattern)pattern, frame++);
+            });
+            bench_emit(opt, "micro", "pattern", {
+                {"variant", std::string(names[pattern])}, {"threads", (long)n},
+                {"width", (long)width}, {"height", (long)height}, {"format", std::string("AR24")},
+                {"iters", t.iters}, {"ns_per_iter", t.ns_median}, {"ns_min", t.ns_min},
+            });
+        }
+    }
+
+    xDRM_Pattern_Set_Threads(1);
+}
+
+static void bench_blend(const bench_options &opt)
+{
+    uint32_t width = 1920, height = 1080, band = 200;
+    uint32_t pitch = bench_pitch(width * 4);
+    std::vector<uint32_t> video((size_t)width * height, 0xFF204060);
+    std::vector<uint32_t> osd((size_t)width * band), pixels(osd.size()), row(width);
+    std::vector<uint8_t> tiles(((width + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE) * ((band + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE));
+    std::vector<uint8_t> dst((size_t)pitch * height);
+    struct xdrm_blend_layer layer = {pixels.data(), tiles.data(), (width + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE,
+                                     width, band, 0, height - band};
+
+    // subtitle band, text translucent over a transparent margin
+    for (uint32_t y = 0; y < band; y++)
+        for (uint32_t x = 0; x < width; x++)
+            osd[y * width + x] = (y > band / 4 && y < band * 3 / 4 && x > width / 5 && x < width * 4 / 5) ?
+                                 ((x / 8) % 2 ? 0xFFFFFFFF : 0x80000000) : 0;
+
+    auto load = bench_run(opt, [&] { xDRM_Blend_Load(&layer, osd.data(), width * 4, false); });
+    bench_emit(opt, "micro", "blend", {
+        {"variant", std::string("load")}, {"width", (long)width}, {"height", (long)band},
+        {"iters", load.iters}, {"ns_per_iter", load.ns_median}, {"ns_min", load.ns_min},
+    });
+
+    auto compose = bench_run(opt, [&] {
+        xDRM_Blend_Compose(dst.data(), pitch, (const uint8_t *)video.data(), width * 4, 0, 0, width, height, &layer, 1, row.data());
+    });
+    bench_emit(opt, "micro", "blend", {
+        {"variant", std::string("compose")}, {"width", (long)width}, {"height", (long)height},
+        {"iters", compose.iters}, {"ns_per_iter", compose.ns_median}, {"ns_min", compose.ns_min},
+    });
+
+    for (int simd = 0; simd < 2; simd++)
+    {
+        auto t = bench_run(opt, [&] {
+            for (uint32_t y = 0; y < band; y++)
+            {
+                if (simd)
+                    xDRM_Blend(row.data(), pixels.data() + (size_t)y * width, width);
+                else
+                    xDRM_Blend_Scalar(row.data(), pixels.data() + (size_t)y * width, width);
+            }
+        });
+        bench_emit(opt, "micro", "blend", {
+            {"variant", std::string(simd ? "kernel_simd" : "kernel_scalar")}, {"width", (long)width}, {"height", (long)band},
+            {"iters", t.iters}, {"ns_per_iter", t.ns_median}, {"ns_min", t.ns_min},
+        });
+    }
+}
+
+static void bench_scale(const bench_options &opt)
+{
+    static const uint32_t cases[][4] = {
+        {640, 512, 1080, 864},
+        {640, 512, 1280, 1024},
+        {1920, 1080, 3840, 2160},
+    };
+
+    for (auto &c : cases)
+    {
+        std::vector<uint8_t> src((size_t)c[0] * c[1] * 4, 0x33);
+        std::vector<uint8_t> dst((size_t)bench_pitch(c[2] * 4) * c[3]);
+        struct xdrm_scale_scratch scratch;
+
+        // scratch kept across calls as on the display thread
+        if (xDRM_Scale_Scratch_Alloc(&scratch, c[2]))
+            continue;
+
+        auto t = bench_run(opt, [&] {
+            xDRM_Scale(dst.data(), bench_pitch(c[2] * 4), c[2], c[3], src.data(), c[0] * 4, c[0], c[1], 4, &scratch);
+        });
+        xDRM_Scale_Scratch_Free(&scratch);
+        bench_emit(opt, "micro", "scale", {
+            {"variant", std::to_string(c[0]) + "x" + std::to_string(c[1]) + "_to_" + std::to_string(c[2]) + "x" + std::to_string(c[3])},
+            {"width", (long)c[2]}, {"height", (long)c[3]}, {"format", std::string("AR24")},
+            {"iters", t.iters}, {"ns_per_iter", t.ns_median}, {"ns_min", t.ns_min},
+        });
+    }
+}
+
+static void bench_commit_build(const bench_options &opt)
+{
+    // a full flip of one plane: FB, CRTC, source and destination rect, zpos, alpha, damage
+    const int props = 12;
+    drmModeAtomicReq *reuse = drmModeAtomicAlloc();
+
+    auto build = [&](drmModeAtomicReq *req) {
+        for (int p = 0; p < props; p++)
+            drmModeAtomicAddProperty(req, PLANE_ID_DSI1, 1000 + p, p);
+    };
+
+    auto fresh = bench_run(opt, [&] {
+        drmModeAtomicReq *req = drmModeAtomicAlloc();
+
+        build(req);
+        drmModeAtomicFree(req);
+    });
+    bench_emit(opt, "micro", "commit_build", {
+        {"variant", std::string("alloc")}, {"props", (long)props},
+        {"iters", fresh.iters}, {"ns_per_iter", fresh.ns_median}, {"ns_min", fresh.ns_min},
+    });
+
+    // flip path keeps one request and rewinds it
+    auto rewind = bench_run(opt, [&] {
+        drmModeAtomicSetCursor(reuse, 0);
+        build(reuse);
+    });
+    bench_emit(opt, "micro", "commit_build", {
+        {"variant", std::string("rewind")}, {"props", (long)props},
+        {"iters", rewind.iters}, {"ns_per_iter", rewind.ns_median}, {"ns_min", rewind.ns_min},
+    });
+
+    drmModeAtomicFree(reuse);
+}
+
+void bench_micro(const bench_options &opt)
+{
+    if (bench_selected(opt, "copy"))
+        bench_copy(opt);
+    if (bench_selected(opt, "pattern"))
+        bench_pattern(opt);
+    if (bench_selected(opt, "blend"))
+        bench_blend(opt);
+    if (bench_selected(opt, "scale"))
+        bench_scale(opt);
+    if (bench_selected(opt, "commit_build"))
+        bench_commit_build(opt);
+}
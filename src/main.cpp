@@ -1,45 +1,59 @@
 #include "xdrm/xdrm.h"
 #include <iostream>
 #include <thread>
+#include <atomic>
+#include <csignal>
 
 struct modeset_dev *panel, *evf;
 uint32_t image_data[640 * 512];
+std::atomic<bool> running(true);
 
-void panel_func()
+void stop_func(int)
 {
-    int fd = xDRM_Init(&panel, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, 640, 512, 200, 200);
-    xDRM_Draw(fd, panel);
-    xDRM_Exit(fd, panel);
+    running = false;
 }
 
-void evf_func()
+void draw_func()
 {
-    int fd = xDRM_Init(&evf, CONN_ID_DSI2, CRTC_ID_DSI2, PLANE_ID_DSI2, 640, 512, 200, 200);
-    xDRM_Draw(fd, evf);
-    xDRM_Exit(fd, evf);
+    // panel and EVF share one fd and one event loop, EVF mirrors panel framebuffer, CRTCs and planes come from topology
+    int fd = xDRM_Init_Connector(&panel, "DSI-1", 640, 512, 200, 200, MODESET_BUF_DEFAULT, MODESET_FORMAT_DEFAULT);
+    xDRM_Add_Mirror_Connector(fd, panel, panel, &evf, "DSI-2", 200, 200);
+
+    // event loop on an A76 core of RK3588, above image processing workers, no page fault before vblank
+    struct xdrm_rt_config rt = {80, 1ull << 7, true};
+    xDRM_Set_Realtime(panel, &rt);
+    xDRM_Draw(fd, panel);
+    xDRM_Exit(fd, panel);
 }
 
 int main()
 {
-    std::thread th_panel = std::thread(panel_func);
-    std::thread th_evf = std::thread(evf_func);
+    std::thread th_draw = std::thread(draw_func);
+
+    // producer and its copy stay on the other A76 cores
+    struct xdrm_rt_config rt = {0, (1ull << 4) | (1ull << 5) | (1ull << 6), false};
+    xDRM_RT_Apply(&rt);
 
     // wait to finish initialize
     sleep(1);
 
+    // Ctrl-C stops producer, then draw loop, then releases planes
+    std::signal(SIGINT, stop_func);
+    std::signal(SIGTERM, stop_func);
+
     int count = 0;
-    while (1)
+    while (running)
     {
         xDRM_Pattern(image_data, 640, 512, count++);
         xDRM_Push(panel, image_data, sizeof(image_data));
-        xDRM_Push(evf, image_data, sizeof(image_data));
-        usleep(16666);
+
+        // next frame on panel vblank
+        xDRM_Wait_Present(panel);
     }
 
-    if (th_panel.joinable())
-        th_panel.join();
-    if (th_evf.joinable())
-        th_evf.join();
+    xDRM_Stop_Draw(panel);
+    if (th_draw.joinable())
+        th_draw.join();
 
     return 0;
 }
\ No newline at end of file
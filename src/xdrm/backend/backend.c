@@ -0,0 +1,131 @@
+#include "backend.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static int drm_open(void)
+{
+    return open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
+}
+
+static int drm_create_dumb(int fd, struct drm_mode_create_dumb *req)
+{
+    return drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, req);
+}
+
+static void *drm_map_dumb(int fd, uint32_t handle, uint64_t size)
+{
+    struct drm_mode_map_dumb mreq;
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.handle = handle;
+    if (drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq))
+        return MAP_FAILED;
+
+    return mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, mreq.offset);
+}
+
+static int drm_unmap_dumb(void *map, uint64_t size)
+{
+    return munmap(map, size);
+}
+
+static int drm_destroy_dumb(int fd, uint32_t handle)
+{
+    struct drm_mode_destroy_dumb dreq;
+
+    memset(&dreq, 0, sizeof(dreq));
+    dreq.handle = handle;
+
+    return drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+}
+
+static int drm_gem_close(int fd, uint32_t handle)
+{
+    struct drm_gem_close creq;
+
+    memset(&creq, 0, sizeof(creq));
+    creq.handle = handle;
+
+    return drmIoctl(fd, DRM_IOCTL_GEM_CLOSE, &creq);
+}
+
+const struct xdrm_backend xdrm_backend_drm = {
+    .name = "drm",
+
+    .open = drm_open,
+    .close = close,
+    .get_cap = drmGetCap,
+    .set_client_cap = drmSetClientCap,
+
+    .get_resources = drmModeGetResources,
+    .free_resources = drmModeFreeResources,
+    .get_plane_resources = drmModeGetPlaneResources,
+    .free_plane_resources = drmModeFreePlaneResources,
+    .get_connector = drmModeGetConnector,
+    .free_connector = drmModeFreeConnector,
+    .get_encoder = drmModeGetEncoder,
+    .free_encoder = drmModeFreeEncoder,
+    .get_crtc = drmModeGetCrtc,
+    .free_crtc = drmModeFreeCrtc,
+    .get_plane = drmModeGetPlane,
+    .free_plane = drmModeFreePlane,
+    .get_object_properties = drmModeObjectGetProperties,
+    .free_object_properties = drmModeFreeObjectProperties,
+    .get_property = drmModeGetProperty,
+    .free_property = drmModeFreeProperty,
+    .create_property_blob = drmModeCreatePropertyBlob,
+    .destroy_property_blob = drmModeDestroyPropertyBlob,
+
+    .create_dumb = drm_create_dumb,
+    .map_dumb = drm_map_dumb,
+    .unmap_dumb = drm_unmap_dumb,
+    .destroy_dumb = drm_destroy_dumb,
+    .prime_fd_to_handle = drmPrimeFDToHandle,
+    .gem_close = drm_gem_close,
+    .add_fb2 = drmModeAddFB2,
+    .rm_fb = drmModeRmFB,
+
+    .atomic_alloc = drmModeAtomicAlloc,
+    .atomic_free = drmModeAtomicFree,
+    .atomic_add_property = drmModeAtomicAddProperty,
+    .atomic_get_cursor = drmModeAtomicGetCursor,
+    .atomic_set_cursor = drmModeAtomicSetCursor,
+    .atomic_commit = drmModeAtomicCommit,
+
+    .page_flip = drmModePageFlip,
+
+    .handle_event = drmHandleEvent,
+};
+
+const struct xdrm_backend *xdrm_backend = NULL;
+
+int xDRM_Set_Backend(const struct xdrm_backend *backend)
+{
+    if (!backend)
+        return -EINVAL;
+
+    __atomic_store_n(&xdrm_backend, backend, __ATOMIC_RELEASE);
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Display backend: %s\n", backend->name);
+#endif
+
+    return 0;
+}
+
+const struct xdrm_backend *xDRM_Get_Backend(void)
+{
+    const struct xdrm_backend *backend = __atomic_load_n(&xdrm_backend, __ATOMIC_ACQUIRE);
+    const char *name;
+
+    if (backend)
+        return backend;
+
+    // CI and hosts without a GPU select headless without code change
+    name = getenv("XDRM_BACKEND");
+    xDRM_Set_Backend(name && !strcmp(name, "headless") ? &xdrm_backend_headless : &xdrm_backend_drm);
+
+    return __atomic_load_n(&xdrm_backend, __ATOMIC_ACQUIRE);
+}
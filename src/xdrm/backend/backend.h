@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include "../conf/debug.h"
+#include "../conf/device.h"
+
+// kernel 6.8, newer than libdrm of the SDK
+#ifndef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+#define DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP 0x15
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Everything xDRM asks of a display device, shaped like the libdrm calls it replaces.
+ * Calls return 0 or a non-negative value on success, on failure a negative value with errno set.
+ * Objects returned by a get call are released by the matching free call of the same backend.
+ */
+struct xdrm_backend
+{
+    const char *name;
+
+    // device
+    int (*open)(void);
+    int (*close)(int fd);
+    int (*get_cap)(int fd, uint64_t capability, uint64_t *value);
+    int (*set_client_cap)(int fd, uint64_t capability, uint64_t value);
+
+    // topology and properties
+    drmModeResPtr (*get_resources)(int fd);
+    void (*free_resources)(drmModeResPtr ptr);
+    drmModePlaneResPtr (*get_plane_resources)(int fd);
+    void (*free_plane_resources)(drmModePlaneResPtr ptr);
+    drmModeConnectorPtr (*get_connector)(int fd, uint32_t connector_id);
+    void (*free_connector)(drmModeConnectorPtr ptr);
+    drmModeEncoderPtr (*get_encoder)(int fd, uint32_t encoder_id);
+    void (*free_encoder)(drmModeEncoderPtr ptr);
+    drmModeCrtcPtr (*get_crtc)(int fd, uint32_t crtc_id);
+    void (*free_crtc)(drmModeCrtcPtr ptr);
+    drmModePlanePtr (*get_plane)(int fd, uint32_t plane_id);
+    void (*free_plane)(drmModePlanePtr ptr);
+    drmModeObjectPropertiesPtr (*get_object_properties)(int fd, uint32_t object_id, uint32_t object_type);
+    void (*free_object_properties)(drmModeObjectPropertiesPtr ptr);
+    drmModePropertyPtr (*get_property)(int fd, uint32_t property_id);
+    void (*free_property)(drmModePropertyPtr ptr);
+    int (*create_property_blob)(int fd, const void *data, size_t size, uint32_t *id);
+    int (*destroy_property_blob)(int fd, uint32_t id);
+
+    // buffers, map_dumb returns MAP_FAILED on failure
+    int (*create_dumb)(int fd, struct drm_mode_create_dumb *req);
+    void *(*map_dumb)(int fd, uint32_t handle, uint64_t size);
+    int (*unmap_dumb)(void *map, uint64_t size);
+    int (*destroy_dumb)(int fd, uint32_t handle);
+    int (*prime_fd_to_handle)(int fd, int prime_fd, uint32_t *handle);
+    int (*gem_close)(int fd, uint32_t handle);
+    int (*add_fb2)(int fd, uint32_t width, uint32_t height, uint32_t format, const uint32_t handles[4],
+                   const uint32_t pitches[4], const uint32_t offsets[4], uint32_t *fb_id, uint32_t flags);
+    int (*rm_fb)(int fd, uint32_t fb_id);
+
+    // atomic, commit returns -errno
+    drmModeAtomicReqPtr (*atomic_alloc)(void);
+    void (*atomic_free)(drmModeAtomicReqPtr req);
+    int (*atomic_add_property)(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value);
+    int (*atomic_get_cursor)(drmModeAtomicReqPtr req);
+    void (*atomic_set_cursor)(drmModeAtomicReqPtr req, int cursor);
+    int (*atomic_commit)(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *user_data);
+
+    // legacy flip of the primary plane of crtc, async flips on drivers without atomic ones, returns -errno
+    int (*page_flip)(int fd, uint32_t crtc_id, uint32_t fb_id, uint32_t flags, void *user_data);
+
+    // fd is readable when events are pending, handle_event dispatches them to context
+    int (*handle_event)(int fd, drmEventContextPtr context);
+};
+
+// libdrm on /dev/dri/card0
+extern const struct xdrm_backend xdrm_backend_drm;
+
+// display emulated in memory, flips complete on a CLOCK_MONOTONIC vblank grid
+extern const struct xdrm_backend xdrm_backend_headless;
+
+// backend of every xDRM call, resolved by xDRM_Get_Backend
+extern const struct xdrm_backend *xdrm_backend;
+
+/**
+ * @brief Choose backend for next xDRM_Init.
+ * @note Without a call, XDRM_BACKEND=headless in environment picks headless, otherwise drm.
+ *
+ * @param backend &xdrm_backend_drm, &xdrm_backend_headless or own table
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Set_Backend(const struct xdrm_backend *backend);
+
+/**
+ * @brief Backend in use, resolved from environment on first call.
+ */
+const struct xdrm_backend *xDRM_Get_Backend(void);
+
+// headless topology: connectors, CRTCs and primary planes of device.h, plus two overlay planes for either CRTC
+#define XDRM_HEADLESS_PLANE_OVERLAY0 180
+#define XDRM_HEADLESS_PLANE_OVERLAY1 190
+
+struct xdrm_headless_config
+{
+    // mode of every connector
+    uint32_t width;
+    uint32_t height;
+    uint32_t refresh_hz;
+    // planes reject src and crtc sizes which differ with -ERANGE, like a plane without scaler
+    bool no_scale;
+};
+
+struct xdrm_headless_plane
+{
+    uint32_t fb;
+    uint32_t crtc;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    // CPU view of fb, NULL when the buffer cannot be mapped
+    const uint8_t *map;
+    uint32_t pitches[4];
+    uint32_t offsets[4];
+    // 16.16 fixed point like SRC_* properties
+    uint32_t src_x, src_y, src_w, src_h;
+    int32_t crtc_x, crtc_y;
+    uint32_t crtc_w, crtc_h;
+    uint64_t zpos;
+    uint64_t alpha;
+};
+
+struct xdrm_headless_stats
+{
+    uint64_t commits;
+    uint64_t test_commits;
+    // NONBLOCK commits refused while a flip was pending
+    uint64_t busy;
+    // completed flips, one per CRTC
+    uint64_t flips;
+    uint32_t bufs;
+    uint32_t fbs;
+    uint32_t blobs;
+};
+
+/**
+ * @brief Mode and plane capability of headless device, taken by next open.
+ *
+ * @param config NULL restores 1920x1080 at 60Hz with scaling planes
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Headless_Configure(const struct xdrm_headless_config *config);
+
+/**
+ * @brief State of a headless plane as of the last commit, the frame it scans out can be read through map.
+ *
+ * @return 0 on success, -EINVAL on unknown plane, -ENODEV when headless device is not open.
+ */
+int xDRM_Headless_Get_Plane(uint32_t plane_id, struct xdrm_headless_plane *plane);
+
+/**
+ * @brief Counters of headless device since open.
+ *
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Headless_Get_Stats(struct xdrm_headless_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1581 @@
+#include "backend.h"
+
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <drm_fourcc.h>
+
+#define HEADLESS_OUTPUT_NUM 2
+#define HEADLESS_PLANE_NUM 4
+#define HEADLESS_BUF_MAX 256
+#define HEADLESS_FB_MAX 256
+#define HEADLESS_BLOB_MAX 64
+
+// object ids which collide with none of device.h
+#define HEADLESS_ENCODER_BASE 300
+#define HEADLESS_FB_BASE 1000
+#define HEADLESS_BLOB_BASE 5000
+
+enum headless_prop
+{
+    HEADLESS_PROP_CONN_CRTC_ID = 1,
+    HEADLESS_PROP_ACTIVE,
+    HEADLESS_PROP_MODE_ID,
+    // plane properties, headless_plane.state is indexed from HEADLESS_PROP_TYPE
+    HEADLESS_PROP_TYPE,
+    HEADLESS_PROP_FB_ID,
+    HEADLESS_PROP_CRTC_ID,
+    HEADLESS_PROP_SRC_X,
+    HEADLESS_PROP_SRC_Y,
+    HEADLESS_PROP_SRC_W,
+    HEADLESS_PROP_SRC_H,
+    HEADLESS_PROP_CRTC_X,
+    HEADLESS_PROP_CRTC_Y,
+    HEADLESS_PROP_CRTC_W,
+    HEADLESS_PROP_CRTC_H,
+    HEADLESS_PROP_ZPOS,
+    HEADLESS_PROP_ALPHA,
+    HEADLESS_PROP_FB_DAMAGE_CLIPS,
+    HEADLESS_PROP_NUM,
+};
+
+#define HEADLESS_PLANE_PROP(prop) ((prop) - HEADLESS_PROP_TYPE)
+#define HEADLESS_PLANE_PROP_NUM (HEADLESS_PROP_NUM - HEADLESS_PROP_TYPE)
+
+static const struct
+{
+    const char *name;
+    uint32_t object_type;
+    uint32_t flags;
+} headless_props[HEADLESS_PROP_NUM] = {
+    [HEADLESS_PROP_CONN_CRTC_ID] = {"CRTC_ID", DRM_MODE_OBJECT_CONNECTOR, DRM_MODE_PROP_OBJECT},
+    [HEADLESS_PROP_ACTIVE] = {"ACTIVE", DRM_MODE_OBJECT_CRTC, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_MODE_ID] = {"MODE_ID", DRM_MODE_OBJECT_CRTC, DRM_MODE_PROP_BLOB},
+    [HEADLESS_PROP_TYPE] = {"type", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_ENUM | DRM_MODE_PROP_IMMUTABLE},
+    [HEADLESS_PROP_FB_ID] = {"FB_ID", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_OBJECT},
+    [HEADLESS_PROP_CRTC_ID] = {"CRTC_ID", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_OBJECT},
+    [HEADLESS_PROP_SRC_X] = {"SRC_X", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_SRC_Y] = {"SRC_Y", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_SRC_W] = {"SRC_W", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_SRC_H] = {"SRC_H", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_CRTC_X] = {"CRTC_X", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_SIGNED_RANGE},
+    [HEADLESS_PROP_CRTC_Y] = {"CRTC_Y", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_SIGNED_RANGE},
+    [HEADLESS_PROP_CRTC_W] = {"CRTC_W", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_CRTC_H] = {"CRTC_H", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_ZPOS] = {"zpos", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_ALPHA] = {"alpha", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_RANGE},
+    [HEADLESS_PROP_FB_DAMAGE_CLIPS] = {"FB_DAMAGE_CLIPS", DRM_MODE_OBJECT_PLANE, DRM_MODE_PROP_BLOB},
+};
+
+// every plane scans out what modeset_format_info knows
+static const uint32_t headless_formats[] = {
+    DRM_FORMAT_ARGB8888,
+    DRM_FORMAT_XRGB8888,
+    DRM_FORMAT_RGB565,
+    DRM_FORMAT_YUYV,
+    DRM_FORMAT_NV12,
+    DRM_FORMAT_NV16,
+};
+
+struct headless_output
+{
+    uint32_t connector;
+    uint32_t encoder;
+    uint32_t crtc;
+    uint64_t connector_crtc;
+    uint64_t active;
+    uint64_t mode_blob;
+    // flip requested with PAGE_FLIP_EVENT, completes at due_ns
+    bool pending;
+    uint64_t due_ns;
+    void *user_data;
+};
+
+struct headless_plane
+{
+    uint32_t id;
+    uint32_t possible_crtcs;
+    uint64_t state[HEADLESS_PLANE_PROP_NUM];
+};
+
+struct headless_buf
+{
+    uint32_t handle;
+    uint8_t *map;
+    uint64_t size;
+    // imported dma-buf, identified like the kernel does by its file
+    bool prime;
+    dev_t dev;
+    ino_t ino;
+};
+
+struct headless_fb
+{
+    uint32_t id;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t handles[4];
+    uint32_t pitches[4];
+    uint32_t offsets[4];
+};
+
+struct headless_blob
+{
+    uint32_t id;
+    void *data;
+    size_t size;
+};
+
+struct headless_req
+{
+    struct
+    {
+        uint32_t object;
+        uint32_t prop;
+        uint64_t value;
+    } *items;
+    int count;
+    int size;
+};
+
+static struct
+{
+    pthread_mutex_t lock;
+    struct xdrm_headless_config config;
+    drmModeModeInfo mode;
+    // timerfd, readable when the earliest pending flip is due
+    int fd;
+    uint64_t epoch_ns;
+    uint64_t period_ns;
+    struct headless_output outputs[HEADLESS_OUTPUT_NUM];
+    struct headless_plane planes[HEADLESS_PLANE_NUM];
+    struct headless_buf bufs[HEADLESS_BUF_MAX];
+    struct headless_fb fbs[HEADLESS_FB_MAX];
+    struct headless_blob blobs[HEADLESS_BLOB_MAX];
+    uint32_t next_handle;
+    struct xdrm_headless_stats stats;
+} headless = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .config = {1920, 1080, 60, false},
+    .fd = -1,
+};
+
+static uint64_t headless_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// libdrm convention, -1 with errno for int calls
+static int headless_fail(int err)
+{
+    errno = err;
+
+    return -1;
+}
+
+static void *headless_fail_ptr(int err)
+{
+    errno = err;
+
+    return NULL;
+}
+
+// calls libdrm returns -errno from, errno set as well
+static int headless_error(int err)
+{
+    errno = err;
+
+    return -err;
+}
+
+/**
+ * @brief CEA like blanking, pixel clock chosen so htotal * vtotal / clock is the refresh period.
+ */
+static void headless_build_mode(drmModeModeInfo *mode, const struct xdrm_headless_config *config)
+{
+    memset(mode, 0, sizeof(*mode));
+
+    mode->hdisplay = config->width;
+    mode->hsync_start = config->width + 88;
+    mode->hsync_end = config->width + 132;
+    mode->htotal = config->width + 280;
+    mode->vdisplay = config->height;
+    mode->vsync_start = config->height + 4;
+    mode->vsync_end = config->height + 9;
+    mode->vtotal = config->height + 45;
+    mode->vrefresh = config->refresh_hz;
+    mode->clock = (uint32_t)(((uint64_t)mode->htotal * mode->vtotal * config->refresh_hz + 500) / 1000);
+    mode->type = DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
+    snprintf(mode->name, sizeof(mode->name), "%ux%u", config->width, config->height);
+}
+
+static struct headless_output *headless_find_output(uint32_t id, uint32_t object_type)
+{
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        struct headless_output *output = &headless.outputs[i];
+
+        if ((object_type == DRM_MODE_OBJECT_CONNECTOR && output->connector == id) ||
+            (object_type == DRM_MODE_OBJECT_ENCODER && output->encoder == id) ||
+            (object_type == DRM_MODE_OBJECT_CRTC && output->crtc == id))
+            return output;
+    }
+
+    return NULL;
+}
+
+static int headless_crtc_index(uint32_t crtc)
+{
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+        if (headless.outputs[i].crtc == crtc)
+            return i;
+
+    return -1;
+}
+
+static struct headless_plane *headless_find_plane(uint32_t id)
+{
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+        if (headless.planes[i].id == id)
+            return &headless.planes[i];
+
+    return NULL;
+}
+
+static struct headless_buf *headless_find_buf(uint32_t handle)
+{
+    for (int i = 0; i < HEADLESS_BUF_MAX; i++)
+        if (handle && headless.bufs[i].handle == handle)
+            return &headless.bufs[i];
+
+    return NULL;
+}
+
+static struct headless_fb *headless_find_fb(uint32_t id)
+{
+    for (int i = 0; i < HEADLESS_FB_MAX; i++)
+        if (id && headless.fbs[i].id == id)
+            return &headless.fbs[i];
+
+    return NULL;
+}
+
+static struct headless_blob *headless_find_blob(uint32_t id)
+{
+    for (int i = 0; i < HEADLESS_BLOB_MAX; i++)
+        if (id && headless.blobs[i].id == id)
+            return &headless.blobs[i];
+
+    return NULL;
+}
+
+static void headless_free_buf(struct headless_buf *buf)
+{
+    if (buf->map)
+        munmap(buf->map, buf->size);
+
+    memset(buf, 0, sizeof(*buf));
+    headless.stats.bufs--;
+}
+
+/**
+ * @brief Program timer for the earliest pending flip, disarm when none is pending.
+ */
+static void headless_arm(void)
+{
+    struct itimerspec its;
+    uint64_t due = 0;
+
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+        if (headless.outputs[i].pending && (!due || headless.outputs[i].due_ns < due))
+            due = headless.outputs[i].due_ns;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = due / 1000000000ULL;
+    its.it_value.tv_nsec = due % 1000000000ULL;
+    timerfd_settime(headless.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int headless_open(void)
+{
+    static const uint32_t connectors[] = {CONN_ID_DSI1, CONN_ID_DSI2};
+    static const uint32_t crtcs[] = {CRTC_ID_DSI1, CRTC_ID_DSI2};
+    static const uint32_t planes[] = {PLANE_ID_DSI1, PLANE_ID_DSI2, XDRM_HEADLESS_PLANE_OVERLAY0, XDRM_HEADLESS_PLANE_OVERLAY1};
+    int fd;
+
+    pthread_mutex_lock(&headless.lock);
+
+    // one device, like the single card0 of the target
+    if (headless.fd >= 0)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_fail(EBUSY);
+    }
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return -1;
+    }
+
+    headless.fd = fd;
+    headless_build_mode(&headless.mode, &headless.config);
+    // same formula as modeset_refresh_ns, the pacer sees the period the timestamps are spaced by
+    headless.period_ns = (uint64_t)headless.mode.htotal * headless.mode.vtotal * 1000000ULL / headless.mode.clock;
+    headless.epoch_ns = headless_now_ns();
+    headless.next_handle = 1;
+    memset(&headless.stats, 0, sizeof(headless.stats));
+
+    // Step 1 : outputs are lit, as left by boot splash
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        struct headless_output *output = &headless.outputs[i];
+
+        memset(output, 0, sizeof(*output));
+        output->connector = connectors[i];
+        output->encoder = HEADLESS_ENCODER_BASE + i;
+        output->crtc = crtcs[i];
+        output->connector_crtc = crtcs[i];
+        output->active = 1;
+    }
+
+    // Step 2 : planes are off, primaries bound to their CRTC, overlays for either
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+    {
+        struct headless_plane *plane = &headless.planes[i];
+
+        memset(plane, 0, sizeof(*plane));
+        plane->id = planes[i];
+        plane->possible_crtcs = i < HEADLESS_OUTPUT_NUM ? 1u << i : (1u << HEADLESS_OUTPUT_NUM) - 1;
+        plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_TYPE)] = i < HEADLESS_OUTPUT_NUM ? DRM_PLANE_TYPE_PRIMARY : DRM_PLANE_TYPE_OVERLAY;
+        plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_ZPOS)] = i < HEADLESS_OUTPUT_NUM ? 0 : i - 1;
+        plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_ALPHA)] = 0xFFFF;
+    }
+
+    pthread_mutex_unlock(&headless.lock);
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Headless display %s at %uHz, vblank every %lluns\n",
+           headless.mode.name, headless.config.refresh_hz, (unsigned long long)headless.period_ns);
+#endif
+
+    return fd;
+}
+
+static int headless_close(int fd)
+{
+    pthread_mutex_lock(&headless.lock);
+
+    if (fd < 0 || fd != headless.fd)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_fail(EBADF);
+    }
+
+    // closing the device releases whatever the client leaked
+    for (int i = 0; i < HEADLESS_BUF_MAX; i++)
+        if (headless.bufs[i].handle)
+            headless_free_buf(&headless.bufs[i]);
+    for (int i = 0; i < HEADLESS_BLOB_MAX; i++)
+        free(headless.blobs[i].data);
+    memset(headless.fbs, 0, sizeof(headless.fbs));
+    memset(headless.blobs, 0, sizeof(headless.blobs));
+
+    close(headless.fd);
+    headless.fd = -1;
+
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static int headless_get_cap(int fd, uint64_t capability, uint64_t *value)
+{
+    (void)fd;
+
+    switch (capability)
+    {
+        case DRM_CAP_DUMB_BUFFER:
+        case DRM_CAP_PRIME:
+        case DRM_CAP_TIMESTAMP_MONOTONIC:
+        case DRM_CAP_CRTC_IN_VBLANK_EVENT:
+        case DRM_CAP_ASYNC_PAGE_FLIP:
+        case DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP:
+            *value = 1;
+            return 0;
+        default:
+            *value = 0;
+            return headless_fail(EINVAL);
+    }
+}
+
+static int headless_set_client_cap(int fd, uint64_t capability, uint64_t value)
+{
+    (void)fd;
+    (void)value;
+
+    if (capability == DRM_CLIENT_CAP_UNIVERSAL_PLANES || capability == DRM_CLIENT_CAP_ATOMIC)
+        return 0;
+
+    return headless_fail(EINVAL);
+}
+
+static void headless_free_resources(drmModeResPtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->fbs);
+    free(ptr->crtcs);
+    free(ptr->connectors);
+    free(ptr->encoders);
+    free(ptr);
+}
+
+static drmModeResPtr headless_get_resources(int fd)
+{
+    drmModeResPtr res = calloc(1, sizeof(*res));
+
+    (void)fd;
+    if (!res)
+        return headless_fail_ptr(ENOMEM);
+
+    res->count_connectors = res->count_encoders = res->count_crtcs = HEADLESS_OUTPUT_NUM;
+    res->connectors = calloc(HEADLESS_OUTPUT_NUM, sizeof(uint32_t));
+    res->encoders = calloc(HEADLESS_OUTPUT_NUM, sizeof(uint32_t));
+    res->crtcs = calloc(HEADLESS_OUTPUT_NUM, sizeof(uint32_t));
+    if (!res->connectors || !res->encoders || !res->crtcs)
+    {
+        headless_free_resources(res);
+        return headless_fail_ptr(ENOMEM);
+    }
+
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        res->connectors[i] = headless.outputs[i].connector;
+        res->encoders[i] = headless.outputs[i].encoder;
+        res->crtcs[i] = headless.outputs[i].crtc;
+    }
+    res->max_width = res->max_height = 8192;
+
+    return res;
+}
+
+static void headless_free_plane_resources(drmModePlaneResPtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->planes);
+    free(ptr);
+}
+
+static drmModePlaneResPtr headless_get_plane_resources(int fd)
+{
+    drmModePlaneResPtr res = calloc(1, sizeof(*res));
+
+    (void)fd;
+    if (!res)
+        return headless_fail_ptr(ENOMEM);
+
+    res->count_planes = HEADLESS_PLANE_NUM;
+    res->planes = calloc(HEADLESS_PLANE_NUM, sizeof(uint32_t));
+    if (!res->planes)
+    {
+        headless_free_plane_resources(res);
+        return headless_fail_ptr(ENOMEM);
+    }
+
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+        res->planes[i] = headless.planes[i].id;
+
+    return res;
+}
+
+static void headless_free_connector(drmModeConnectorPtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->modes);
+    free(ptr->encoders);
+    free(ptr->props);
+    free(ptr->prop_values);
+    free(ptr);
+}
+
+static drmModeConnectorPtr headless_get_connector(int fd, uint32_t connector_id)
+{
+    struct headless_output *output = headless_find_output(connector_id, DRM_MODE_OBJECT_CONNECTOR);
+    drmModeConnectorPtr conn;
+
+    (void)fd;
+    if (!output)
+        return headless_fail_ptr(ENOENT);
+
+    conn = calloc(1, sizeof(*conn));
+    if (!conn)
+        return headless_fail_ptr(ENOMEM);
+
+    conn->connector_id = connector_id;
+    conn->encoder_id = output->encoder;
+    conn->connector_type = DRM_MODE_CONNECTOR_DSI;
+    conn->connector_type_id = output - headless.outputs + 1;
+    conn->connection = DRM_MODE_CONNECTED;
+    conn->count_modes = 1;
+    conn->modes = malloc(sizeof(drmModeModeInfo));
+    conn->count_encoders = 1;
+    conn->encoders = malloc(sizeof(uint32_t));
+    conn->count_props = 1;
+    conn->props = malloc(sizeof(uint32_t));
+    conn->prop_values = malloc(sizeof(uint64_t));
+    if (!conn->modes || !conn->encoders || !conn->props || !conn->prop_values)
+    {
+        headless_free_connector(conn);
+        return headless_fail_ptr(ENOMEM);
+    }
+
+    pthread_mutex_lock(&headless.lock);
+    conn->modes[0] = headless.mode;
+    conn->mmWidth = headless.mode.hdisplay / 4;
+    conn->mmHeight = headless.mode.vdisplay / 4;
+    conn->encoders[0] = output->encoder;
+    conn->props[0] = HEADLESS_PROP_CONN_CRTC_ID;
+    conn->prop_values[0] = output->connector_crtc;
+    pthread_mutex_unlock(&headless.lock);
+
+    return conn;
+}
+
+static drmModeEncoderPtr headless_get_encoder(int fd, uint32_t encoder_id)
+{
+    struct headless_output *output = headless_find_output(encoder_id, DRM_MODE_OBJECT_ENCODER);
+    drmModeEncoderPtr enc;
+
+    (void)fd;
+    if (!output)
+        return headless_fail_ptr(ENOENT);
+
+    enc = calloc(1, sizeof(*enc));
+    if (!enc)
+        return headless_fail_ptr(ENOMEM);
+
+    enc->encoder_id = encoder_id;
+    enc->encoder_type = DRM_MODE_ENCODER_DSI;
+    enc->crtc_id = output->crtc;
+    enc->possible_crtcs = 1u << (output - headless.outputs);
+
+    return enc;
+}
+
+static void headless_free_encoder(drmModeEncoderPtr ptr)
+{
+    free(ptr);
+}
+
+static drmModeCrtcPtr headless_get_crtc(int fd, uint32_t crtc_id)
+{
+    struct headless_output *output = headless_find_output(crtc_id, DRM_MODE_OBJECT_CRTC);
+    drmModeCrtcPtr crtc;
+
+    (void)fd;
+    if (!output)
+        return headless_fail_ptr(ENOENT);
+
+    crtc = calloc(1, sizeof(*crtc));
+    if (!crtc)
+        return headless_fail_ptr(ENOMEM);
+
+    pthread_mutex_lock(&headless.lock);
+    crtc->crtc_id = crtc_id;
+    crtc->buffer_id = headless.planes[output - headless.outputs].state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)];
+    crtc->mode = headless.mode;
+    crtc->mode_valid = output->active ? 1 : 0;
+    crtc->width = headless.mode.hdisplay;
+    crtc->height = headless.mode.vdisplay;
+    pthread_mutex_unlock(&headless.lock);
+
+    return crtc;
+}
+
+static void headless_free_crtc(drmModeCrtcPtr ptr)
+{
+    free(ptr);
+}
+
+static drmModePlanePtr headless_get_plane(int fd, uint32_t plane_id)
+{
+    struct headless_plane *plane = headless_find_plane(plane_id);
+    drmModePlanePtr info;
+
+    (void)fd;
+    if (!plane)
+        return headless_fail_ptr(ENOENT);
+
+    info = calloc(1, sizeof(*info));
+    if (!info)
+        return headless_fail_ptr(ENOMEM);
+
+    info->count_formats = sizeof(headless_formats) / sizeof(headless_formats[0]);
+    info->formats = malloc(sizeof(headless_formats));
+    if (!info->formats)
+    {
+        free(info);
+        return headless_fail_ptr(ENOMEM);
+    }
+    memcpy(info->formats, headless_formats, sizeof(headless_formats));
+
+    pthread_mutex_lock(&headless.lock);
+    info->plane_id = plane_id;
+    info->crtc_id = plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)];
+    info->fb_id = plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)];
+    info->possible_crtcs = plane->possible_crtcs;
+    pthread_mutex_unlock(&headless.lock);
+
+    return info;
+}
+
+static void headless_free_plane(drmModePlanePtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->formats);
+    free(ptr);
+}
+
+static void headless_free_object_properties(drmModeObjectPropertiesPtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->props);
+    free(ptr->prop_values);
+    free(ptr);
+}
+
+static drmModeObjectPropertiesPtr headless_get_object_properties(int fd, uint32_t object_id, uint32_t object_type)
+{
+    drmModeObjectPropertiesPtr props;
+    struct headless_output *output = NULL;
+    struct headless_plane *plane = NULL;
+    uint32_t count = 0;
+
+    (void)fd;
+
+    if (object_type == DRM_MODE_OBJECT_PLANE)
+        plane = headless_find_plane(object_id);
+    else if (object_type == DRM_MODE_OBJECT_CRTC || object_type == DRM_MODE_OBJECT_CONNECTOR)
+        output = headless_find_output(object_id, object_type);
+    if (!plane && !output)
+        return headless_fail_ptr(ENOENT);
+
+    props = calloc(1, sizeof(*props));
+    if (!props)
+        return headless_fail_ptr(ENOMEM);
+    props->props = calloc(HEADLESS_PROP_NUM, sizeof(uint32_t));
+    props->prop_values = calloc(HEADLESS_PROP_NUM, sizeof(uint64_t));
+    if (!props->props || !props->prop_values)
+    {
+        headless_free_object_properties(props);
+        return headless_fail_ptr(ENOMEM);
+    }
+
+    pthread_mutex_lock(&headless.lock);
+    for (uint32_t prop = 1; prop < HEADLESS_PROP_NUM; prop++)
+    {
+        if (headless_props[prop].object_type != object_type)
+            continue;
+
+        props->props[count] = prop;
+        if (plane)
+            props->prop_values[count] = plane->state[HEADLESS_PLANE_PROP(prop)];
+        else if (prop == HEADLESS_PROP_CONN_CRTC_ID)
+            props->prop_values[count] = output->connector_crtc;
+        else
+            props->prop_values[count] = prop == HEADLESS_PROP_ACTIVE ? output->active : output->mode_blob;
+        count++;
+    }
+    pthread_mutex_unlock(&headless.lock);
+    props->count_props = count;
+
+    return props;
+}
+
+static drmModePropertyPtr headless_get_property(int fd, uint32_t property_id)
+{
+    drmModePropertyPtr prop;
+
+    (void)fd;
+    if (property_id == 0 || property_id >= HEADLESS_PROP_NUM)
+        return headless_fail_ptr(ENOENT);
+
+    prop = calloc(1, sizeof(*prop));
+    if (!prop)
+        return headless_fail_ptr(ENOMEM);
+
+    prop->prop_id = property_id;
+    prop->flags = headless_props[property_id].flags;
+    snprintf(prop->name, sizeof(prop->name), "%s", headless_props[property_id].name);
+
+    // plane type names as the kernel reports them
+    if (property_id == HEADLESS_PROP_TYPE)
+    {
+        static const char *names[] = {"Overlay", "Primary", "Cursor"};
+
+        prop->enums = calloc(3, sizeof(*prop->enums));
+        if (!prop->enums)
+        {
+            free(prop);
+            return headless_fail_ptr(ENOMEM);
+        }
+
+        prop->count_enums = 3;
+        for (int i = 0; i < 3; i++)
+        {
+            prop->enums[i].value = i;
+            snprintf(prop->enums[i].name, sizeof(prop->enums[i].name), "%s", names[i]);
+        }
+    }
+
+    return prop;
+}
+
+static void headless_free_property(drmModePropertyPtr ptr)
+{
+    if (!ptr)
+        return;
+
+    free(ptr->values);
+    free(ptr->enums);
+    free(ptr->blob_ids);
+    free(ptr);
+}
+
+static int headless_create_property_blob(int fd, const void *data, size_t size, uint32_t *id)
+{
+    struct headless_blob *blob = NULL;
+    void *copy;
+
+    (void)fd;
+    if (!data || !size || !id)
+        return headless_error(EINVAL);
+
+    copy = malloc(size);
+    if (!copy)
+        return headless_error(ENOMEM);
+    memcpy(copy, data, size);
+
+    pthread_mutex_lock(&headless.lock);
+    for (int i = 0; i < HEADLESS_BLOB_MAX && !blob; i++)
+        if (!headless.blobs[i].id)
+            blob = &headless.blobs[i];
+    if (!blob)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        free(copy);
+        return headless_error(ENOSPC);
+    }
+    blob->id = HEADLESS_BLOB_BASE + (blob - headless.blobs);
+    blob->data = copy;
+    blob->size = size;
+    *id = blob->id;
+    headless.stats.blobs++;
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static int headless_destroy_property_blob(int fd, uint32_t id)
+{
+    struct headless_blob *blob;
+
+    (void)fd;
+    pthread_mutex_lock(&headless.lock);
+    blob = headless_find_blob(id);
+    if (!blob)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_error(ENOENT);
+    }
+    free(blob->data);
+    memset(blob, 0, sizeof(*blob));
+    headless.stats.blobs--;
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static struct headless_buf *headless_alloc_buf(void)
+{
+    for (int i = 0; i < HEADLESS_BUF_MAX; i++)
+    {
+        if (!headless.bufs[i].handle)
+        {
+            headless.bufs[i].handle = headless.next_handle++;
+            headless.stats.bufs++;
+            return &headless.bufs[i];
+        }
+    }
+
+    return NULL;
+}
+
+static int headless_create_dumb(int fd, struct drm_mode_create_dumb *req)
+{
+    struct headless_buf *buf;
+    uint64_t pitch, size;
+    void *map;
+
+    (void)fd;
+    if (!req->width || !req->height || !req->bpp)
+        return headless_fail(EINVAL);
+
+    // pitch aligned like most scanout engines want
+    pitch = (((uint64_t)req->width * req->bpp + 7) / 8 + 63) & ~63ULL;
+    size = pitch * req->height;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return headless_fail(ENOMEM);
+
+    pthread_mutex_lock(&headless.lock);
+    buf = headless_alloc_buf();
+    if (!buf)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        munmap(map, size);
+        return headless_fail(ENOSPC);
+    }
+    buf->map = map;
+    buf->size = size;
+    req->handle = buf->handle;
+    req->pitch = pitch;
+    req->size = size;
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static void *headless_map_dumb(int fd, uint32_t handle, uint64_t size)
+{
+    struct headless_buf *buf;
+    void *map = MAP_FAILED;
+
+    (void)fd;
+    pthread_mutex_lock(&headless.lock);
+    buf = headless_find_buf(handle);
+    if (buf && buf->map && size <= buf->size)
+        map = buf->map;
+    pthread_mutex_unlock(&headless.lock);
+
+    if (map == MAP_FAILED)
+        errno = EINVAL;
+
+    return map;
+}
+
+static int headless_unmap_dumb(void *map, uint64_t size)
+{
+    // memory stays with the buffer until destroy_dumb, like a kernel object outliving its mapping
+    (void)map;
+    (void)size;
+
+    return 0;
+}
+
+static int headless_destroy_dumb(int fd, uint32_t handle)
+{
+    struct headless_buf *buf;
+
+    (void)fd;
+    pthread_mutex_lock(&headless.lock);
+    buf = headless_find_buf(handle);
+    if (!buf)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_fail(ENOENT);
+    }
+    headless_free_buf(buf);
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static int headless_prime_fd_to_handle(int fd, int prime_fd, uint32_t *handle)
+{
+    struct headless_buf *buf = NULL;
+    struct stat st;
+    void *map;
+
+    (void)fd;
+    if (fstat(prime_fd, &st))
+        return -1;
+
+    pthread_mutex_lock(&headless.lock);
+
+    // the same dma-buf imports to the same handle
+    for (int i = 0; i < HEADLESS_BUF_MAX && !buf; i++)
+        if (headless.bufs[i].handle && headless.bufs[i].prime &&
+            headless.bufs[i].dev == st.st_dev && headless.bufs[i].ino == st.st_ino)
+            buf = &headless.bufs[i];
+
+    if (!buf)
+    {
+        buf = headless_alloc_buf();
+        if (!buf)
+        {
+            pthread_mutex_unlock(&headless.lock);
+            return headless_fail(ENOSPC);
+        }
+        buf->prime = true;
+        buf->dev = st.st_dev;
+        buf->ino = st.st_ino;
+
+        // readback of the scanout, an exporter which cannot be mapped still flips
+        map = st.st_size > 0 ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, prime_fd, 0) : MAP_FAILED;
+        if (map != MAP_FAILED)
+        {
+            buf->map = map;
+            buf->size = st.st_size;
+        }
+    }
+    *handle = buf->handle;
+
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static int headless_gem_close(int fd, uint32_t handle)
+{
+    return headless_destroy_dumb(fd, handle);
+}
+
+static int headless_add_fb2(int fd, uint32_t width, uint32_t height, uint32_t format, const uint32_t handles[4],
+                            const uint32_t pitches[4], const uint32_t offsets[4], uint32_t *fb_id, uint32_t flags)
+{
+    struct headless_fb *fb = NULL;
+    bool supported = false;
+
+    (void)fd;
+    (void)flags;
+
+    for (size_t i = 0; i < sizeof(headless_formats) / sizeof(headless_formats[0]); i++)
+        supported |= headless_formats[i] == format;
+    if (!supported || !width || !height || !pitches[0])
+        return headless_error(EINVAL);
+
+    pthread_mutex_lock(&headless.lock);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (handles[i] && !headless_find_buf(handles[i]))
+        {
+            pthread_mutex_unlock(&headless.lock);
+            return headless_error(ENOENT);
+        }
+    }
+
+    for (int i = 0; i < HEADLESS_FB_MAX && !fb; i++)
+        if (!headless.fbs[i].id)
+            fb = &headless.fbs[i];
+    if (!fb)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_error(ENOSPC);
+    }
+
+    fb->id = HEADLESS_FB_BASE + (fb - headless.fbs);
+    fb->width = width;
+    fb->height = height;
+    fb->format = format;
+    memcpy(fb->handles, handles, sizeof(fb->handles));
+    memcpy(fb->pitches, pitches, sizeof(fb->pitches));
+    memcpy(fb->offsets, offsets, sizeof(fb->offsets));
+    *fb_id = fb->id;
+    headless.stats.fbs++;
+
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static int headless_rm_fb(int fd, uint32_t fb_id)
+{
+    struct headless_fb *fb;
+
+    (void)fd;
+    pthread_mutex_lock(&headless.lock);
+
+    fb = headless_find_fb(fb_id);
+    if (!fb)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_error(ENOENT);
+    }
+
+    // removing a framebuffer which is scanned out turns its plane off
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+    {
+        uint64_t *state = headless.planes[i].state;
+
+        if (state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)] == fb_id)
+        {
+            state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)] = 0;
+            state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)] = 0;
+        }
+    }
+
+    memset(fb, 0, sizeof(*fb));
+    headless.stats.fbs--;
+
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+static drmModeAtomicReqPtr headless_atomic_alloc(void)
+{
+    return (drmModeAtomicReqPtr)calloc(1, sizeof(struct headless_req));
+}
+
+static void headless_atomic_free(drmModeAtomicReqPtr req)
+{
+    struct headless_req *r = (struct headless_req *)req;
+
+    if (!r)
+        return;
+
+    free(r->items);
+    free(r);
+}
+
+static int headless_atomic_add_property(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value)
+{
+    struct headless_req *r = (struct headless_req *)req;
+
+    if (!r)
+        return headless_error(EINVAL);
+
+    if (r->count == r->size)
+    {
+        int size = r->size ? r->size * 2 : 16;
+        void *items = realloc(r->items, size * sizeof(*r->items));
+
+        if (!items)
+            return headless_error(ENOMEM);
+        r->items = items;
+        r->size = size;
+    }
+
+    r->items[r->count].object = object_id;
+    r->items[r->count].prop = property_id;
+    r->items[r->count].value = value;
+
+    return ++r->count;
+}
+
+static int headless_atomic_get_cursor(drmModeAtomicReqPtr req)
+{
+    return ((struct headless_req *)req)->count;
+}
+
+static void headless_atomic_set_cursor(drmModeAtomicReqPtr req, int cursor)
+{
+    ((struct headless_req *)req)->count = cursor;
+}
+
+/**
+ * @brief Atomic check of one plane, what a display driver without scaling limits refuses.
+ */
+static int headless_check_plane(const struct headless_plane *plane, const uint64_t *state)
+{
+    uint64_t fb_id = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)];
+    uint64_t crtc = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)];
+    uint64_t src_x = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_X)];
+    uint64_t src_y = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_Y)];
+    uint64_t src_w = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_W)];
+    uint64_t src_h = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_H)];
+    uint64_t crtc_w = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_W)];
+    uint64_t crtc_h = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_H)];
+    uint64_t damage = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_DAMAGE_CLIPS)];
+    const struct headless_fb *fb;
+    int index;
+
+    // plane off needs both FB and CRTC cleared
+    if (!fb_id || !crtc)
+        return fb_id || crtc ? -EINVAL : 0;
+
+    fb = headless_find_fb(fb_id);
+    index = headless_crtc_index(crtc);
+    if (!fb || index < 0)
+        return headless_error(ENOENT);
+    if (!(plane->possible_crtcs & (1u << index)) || !headless.outputs[index].active)
+        return headless_error(EINVAL);
+    if (!src_w || !src_h || !crtc_w || !crtc_h)
+        return headless_error(EINVAL);
+
+    // source in 16.16 within framebuffer
+    if (src_x + src_w > ((uint64_t)fb->width << 16) || src_y + src_h > ((uint64_t)fb->height << 16))
+        return headless_error(ENOSPC);
+
+    if (headless.config.no_scale && ((src_w >> 16) != crtc_w || (src_h >> 16) != crtc_h))
+        return headless_error(ERANGE);
+
+    if (damage && !headless_find_blob(damage))
+        return headless_error(ENOENT);
+
+    return 0;
+}
+
+/**
+ * @brief Flip event of output, on the first vblank after now or, when async, right away.
+ */
+static void headless_queue_event(struct headless_output *output, uint64_t now, uint32_t flags, void *user_data)
+{
+    output->pending = true;
+    output->due_ns = (flags & DRM_MODE_PAGE_FLIP_ASYNC) ? now :
+                     headless.epoch_ns + ((now - headless.epoch_ns) / headless.period_ns + 1) * headless.period_ns;
+    output->user_data = user_data;
+}
+
+static int headless_atomic_commit(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *user_data)
+{
+    struct headless_req *r = (struct headless_req *)req;
+    uint64_t planes[HEADLESS_PLANE_NUM][HEADLESS_PLANE_PROP_NUM];
+    uint64_t connector_crtc[HEADLESS_OUTPUT_NUM], active[HEADLESS_OUTPUT_NUM], mode_blob[HEADLESS_OUTPUT_NUM];
+    bool touched[HEADLESS_OUTPUT_NUM] = {false};
+    uint64_t now;
+    int ret = 0;
+
+    if (!r)
+        return headless_error(EINVAL);
+
+    pthread_mutex_lock(&headless.lock);
+
+    if (fd < 0 || fd != headless.fd)
+    {
+        ret = -EBADF;
+        goto out;
+    }
+
+    // Step 1 : apply request over a copy of current state
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+        memcpy(planes[i], headless.planes[i].state, sizeof(planes[i]));
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        connector_crtc[i] = headless.outputs[i].connector_crtc;
+        active[i] = headless.outputs[i].active;
+        mode_blob[i] = headless.outputs[i].mode_blob;
+    }
+
+    for (int n = 0; n < r->count; n++)
+    {
+        uint32_t object = r->items[n].object;
+        uint32_t prop = r->items[n].prop;
+        uint64_t value = r->items[n].value;
+        struct headless_plane *plane = headless_find_plane(object);
+        struct headless_output *output;
+        int index;
+
+        if (prop == 0 || prop >= HEADLESS_PROP_NUM || (headless_props[prop].flags & DRM_MODE_PROP_IMMUTABLE))
+        {
+            ret = -EINVAL;
+            goto out;
+        }
+
+        // async commit may only change FB_ID of primary planes, like the kernel
+        if ((flags & DRM_MODE_PAGE_FLIP_ASYNC) && (!plane || prop != HEADLESS_PROP_FB_ID ||
+            plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_TYPE)] != DRM_PLANE_TYPE_PRIMARY))
+        {
+            ret = -EINVAL;
+            goto out;
+        }
+
+        if (plane && headless_props[prop].object_type == DRM_MODE_OBJECT_PLANE)
+        {
+            uint64_t *state = planes[plane - headless.planes];
+            int old_crtc = headless_crtc_index(state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)]);
+            int new_crtc;
+
+            state[HEADLESS_PLANE_PROP(prop)] = value;
+            new_crtc = headless_crtc_index(state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)]);
+            // a plane update flips the CRTC it leaves and the one it lands on
+            if (old_crtc >= 0)
+                touched[old_crtc] = true;
+            if (new_crtc >= 0)
+                touched[new_crtc] = true;
+            continue;
+        }
+
+        output = headless_find_output(object, headless_props[prop].object_type);
+        if (!output)
+        {
+            ret = -ENOENT;
+            goto out;
+        }
+        index = output - headless.outputs;
+
+        if (prop == HEADLESS_PROP_CONN_CRTC_ID)
+        {
+            if (value && headless_crtc_index(value) != index)
+            {
+                ret = -EINVAL;
+                goto out;
+            }
+            connector_crtc[index] = value;
+        }
+        else if (prop == HEADLESS_PROP_ACTIVE)
+            active[index] = value;
+        else
+        {
+            const struct headless_blob *blob = headless_find_blob(value);
+            const drmModeModeInfo *mode = blob && blob->size >= sizeof(*mode) ? blob->data : NULL;
+
+            // the only mode the panel has
+            if (value && (!mode || mode->hdisplay != headless.mode.hdisplay || mode->vdisplay != headless.mode.vdisplay))
+            {
+                ret = -EINVAL;
+                goto out;
+            }
+            mode_blob[index] = value;
+        }
+        touched[index] = true;
+    }
+
+    // Step 2 : check new state
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        if (active[i] && !headless.outputs[i].active && (!connector_crtc[i] || !mode_blob[i]))
+        {
+            ret = -EINVAL;
+            goto out;
+        }
+    }
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+    {
+        uint64_t *state = planes[i];
+
+        ret = headless_check_plane(&headless.planes[i], state);
+        if (ret)
+            goto out;
+    }
+
+    // Step 3 : a CRTC takes one flip per vblank
+    if (flags & DRM_MODE_ATOMIC_NONBLOCK)
+    {
+        for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+        {
+            if (touched[i] && headless.outputs[i].pending)
+            {
+                headless.stats.busy++;
+                ret = -EBUSY;
+                goto out;
+            }
+        }
+    }
+
+    if (flags & DRM_MODE_ATOMIC_TEST_ONLY)
+    {
+        headless.stats.test_commits++;
+        goto out;
+    }
+
+    // Step 4 : latch, damage is per commit
+    for (int i = 0; i < HEADLESS_PLANE_NUM; i++)
+    {
+        memcpy(headless.planes[i].state, planes[i], sizeof(planes[i]));
+        headless.planes[i].state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_DAMAGE_CLIPS)] = 0;
+    }
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        headless.outputs[i].connector_crtc = connector_crtc[i];
+        headless.outputs[i].active = active[i];
+        headless.outputs[i].mode_blob = mode_blob[i];
+    }
+    headless.stats.commits++;
+
+    // Step 5 : flips complete on the first vblank after commit, async ones at once
+    if (flags & DRM_MODE_PAGE_FLIP_EVENT)
+    {
+        now = headless_now_ns();
+        for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+        {
+            if (!touched[i] || !headless.outputs[i].active)
+                continue;
+
+            headless_queue_event(&headless.outputs[i], now, flags, user_data);
+        }
+        headless_arm();
+    }
+
+out:
+    pthread_mutex_unlock(&headless.lock);
+
+    if (ret)
+        errno = -ret;
+
+    return ret;
+}
+
+static int headless_page_flip(int fd, uint32_t crtc_id, uint32_t fb_id, uint32_t flags, void *user_data)
+{
+    struct headless_output *output;
+    struct headless_plane *plane;
+    const struct headless_fb *fb, *old;
+    int ret = 0;
+
+    pthread_mutex_lock(&headless.lock);
+
+    if (fd < 0 || fd != headless.fd)
+    {
+        ret = -EBADF;
+        goto out;
+    }
+
+    // primary plane of CRTC must be on, the new framebuffer must look like the shown one
+    output = headless_find_output(crtc_id, DRM_MODE_OBJECT_CRTC);
+    plane = output ? &headless.planes[output - headless.outputs] : NULL;
+    fb = headless_find_fb(fb_id);
+    old = plane ? headless_find_fb(plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)]) : NULL;
+    if (!output || !fb)
+    {
+        ret = -ENOENT;
+        goto out;
+    }
+    if (!output->active || !old || plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)] != crtc_id ||
+        fb->format != old->format || fb->width != old->width || fb->height != old->height || fb->pitches[0] != old->pitches[0])
+    {
+        ret = -EINVAL;
+        goto out;
+    }
+
+    if (output->pending)
+    {
+        headless.stats.busy++;
+        ret = -EBUSY;
+        goto out;
+    }
+
+    plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)] = fb_id;
+    plane->state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_DAMAGE_CLIPS)] = 0;
+    headless.stats.commits++;
+
+    if (flags & DRM_MODE_PAGE_FLIP_EVENT)
+    {
+        headless_queue_event(output, headless_now_ns(), flags, user_data);
+        headless_arm();
+    }
+
+out:
+    pthread_mutex_unlock(&headless.lock);
+
+    if (ret)
+        errno = -ret;
+
+    return ret;
+}
+
+static int headless_handle_event(int fd, drmEventContextPtr context)
+{
+    struct
+    {
+        uint32_t crtc;
+        uint32_t sequence;
+        uint64_t time_ns;
+        void *user_data;
+    } events[HEADLESS_OUTPUT_NUM];
+    uint64_t expirations, now;
+    int count = 0;
+
+    pthread_mutex_lock(&headless.lock);
+
+    if (fd < 0 || fd != headless.fd)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return headless_fail(EBADF);
+    }
+
+    // Step 1 : collect flips whose vblank passed, stamped with the vblank itself
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return -1;
+    }
+
+    now = headless_now_ns();
+    for (int i = 0; i < HEADLESS_OUTPUT_NUM; i++)
+    {
+        struct headless_output *output = &headless.outputs[i];
+
+        if (!output->pending || output->due_ns > now)
+            continue;
+
+        events[count].crtc = output->crtc;
+        events[count].sequence = (uint32_t)((output->due_ns - headless.epoch_ns) / headless.period_ns);
+        events[count].time_ns = output->due_ns;
+        events[count].user_data = output->user_data;
+        count++;
+
+        output->pending = false;
+        headless.stats.flips++;
+    }
+    headless_arm();
+
+    pthread_mutex_unlock(&headless.lock);
+
+    // Step 2 : dispatch unlocked, handlers commit the next frame
+    for (int i = 0; i < count; i++)
+    {
+        unsigned int sec = events[i].time_ns / 1000000000ULL;
+        unsigned int usec = events[i].time_ns % 1000000000ULL / 1000;
+
+        if (context->version >= 3 && context->page_flip_handler2)
+            context->page_flip_handler2(fd, events[i].sequence, sec, usec, events[i].crtc, events[i].user_data);
+        else if (context->page_flip_handler)
+            context->page_flip_handler(fd, events[i].sequence, sec, usec, events[i].user_data);
+    }
+
+    return 0;
+}
+
+const struct xdrm_backend xdrm_backend_headless = {
+    .name = "headless",
+
+    .open = headless_open,
+    .close = headless_close,
+    .get_cap = headless_get_cap,
+    .set_client_cap = headless_set_client_cap,
+
+    .get_resources = headless_get_resources,
+    .free_resources = headless_free_resources,
+    .get_plane_resources = headless_get_plane_resources,
+    .free_plane_resources = headless_free_plane_resources,
+    .get_connector = headless_get_connector,
+    .free_connector = headless_free_connector,
+    .get_encoder = headless_get_encoder,
+    .free_encoder = headless_free_encoder,
+    .get_crtc = headless_get_crtc,
+    .free_crtc = headless_free_crtc,
+    .get_plane = headless_get_plane,
+    .free_plane = headless_free_plane,
+    .get_object_properties = headless_get_object_properties,
+    .free_object_properties = headless_free_object_properties,
+    .get_property = headless_get_property,
+    .free_property = headless_free_property,
+    .create_property_blob = headless_create_property_blob,
+    .destroy_property_blob = headless_destroy_property_blob,
+
+    .create_dumb = headless_create_dumb,
+    .map_dumb = headless_map_dumb,
+    .unmap_dumb = headless_unmap_dumb,
+    .destroy_dumb = headless_destroy_dumb,
+    .prime_fd_to_handle = headless_prime_fd_to_handle,
+    .gem_close = headless_gem_close,
+    .add_fb2 = headless_add_fb2,
+    .rm_fb = headless_rm_fb,
+
+    .atomic_alloc = headless_atomic_alloc,
+    .atomic_free = headless_atomic_free,
+    .atomic_add_property = headless_atomic_add_property,
+    .atomic_get_cursor = headless_atomic_get_cursor,
+    .atomic_set_cursor = headless_atomic_set_cursor,
+    .atomic_commit = headless_atomic_commit,
+
+    .page_flip = headless_page_flip,
+
+    .handle_event = headless_handle_event,
+};
+
+int xDRM_Headless_Configure(const struct xdrm_headless_config *config)
+{
+    static const struct xdrm_headless_config defaults = {1920, 1080, 60, false};
+
+    if (config && (!config->width || !config->height || config->width > 8192 || config->height > 8192 ||
+                   !config->refresh_hz || config->refresh_hz > 1000))
+        return -EINVAL;
+
+    pthread_mutex_lock(&headless.lock);
+    headless.config = config ? *config : defaults;
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+int xDRM_Headless_Get_Plane(uint32_t plane_id, struct xdrm_headless_plane *plane)
+{
+    const struct headless_plane *p;
+    const struct headless_fb *fb;
+    const struct headless_buf *buf;
+    const uint64_t *state;
+
+    if (!plane)
+        return -EINVAL;
+
+    pthread_mutex_lock(&headless.lock);
+
+    if (headless.fd < 0)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return -ENODEV;
+    }
+
+    p = headless_find_plane(plane_id);
+    if (!p)
+    {
+        pthread_mutex_unlock(&headless.lock);
+        return -EINVAL;
+    }
+
+    state = p->state;
+    memset(plane, 0, sizeof(*plane));
+    plane->fb = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_FB_ID)];
+    plane->crtc = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_ID)];
+    plane->src_x = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_X)];
+    plane->src_y = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_Y)];
+    plane->src_w = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_W)];
+    plane->src_h = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_SRC_H)];
+    plane->crtc_x = (int32_t)state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_X)];
+    plane->crtc_y = (int32_t)state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_Y)];
+    plane->crtc_w = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_W)];
+    plane->crtc_h = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_CRTC_H)];
+    plane->zpos = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_ZPOS)];
+    plane->alpha = state[HEADLESS_PLANE_PROP(HEADLESS_PROP_ALPHA)];
+
+    fb = headless_find_fb(plane->fb);
+    if (fb)
+    {
+        plane->format = fb->format;
+        plane->width = fb->width;
+        plane->height = fb->height;
+        memcpy(plane->pitches, fb->pitches, sizeof(plane->pitches));
+        memcpy(plane->offsets, fb->offsets, sizeof(plane->offsets));
+        buf = headless_find_buf(fb->handles[0]);
+        plane->map = buf ? buf->map : NULL;
+    }
+
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
+
+int xDRM_Headless_Get_Stats(struct xdrm_headless_stats *stats)
+{
+    if (!stats)
+        return -EINVAL;
+
+    pthread_mutex_lock(&headless.lock);
+    *stats = headless.stats;
+    pthread_mutex_unlock(&headless.lock);
+
+    return 0;
+}
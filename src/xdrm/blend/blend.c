@@ -0,0 +1,270 @@
+#include "blend.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+
+// x / 255 rounded, exact for x <= 255 * 255
+static inline uint32_t blend_div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void xDRM_Blend_Scalar(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t s = src[i];
+        uint32_t inv = 255 - (s >> 24);
+        uint32_t d = dst[i];
+        uint32_t out = 0;
+
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t c = ((s >> shift) & 0xFF) + blend_div255(((d >> shift) & 0xFF) * inv);
+
+            out |= (c > 255 ? 255 : c) << shift;
+        }
+
+        dst[i] = out;
+    }
+}
+
+#if defined(__aarch64__)
+static void blend_neon(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+    uint32_t i = 0;
+
+    // 8 pixels, channels deinterleaved so alpha is one register
+    for (; i + 8 <= count; i += 8)
+    {
+        uint8x8x4_t s = vld4_u8((const uint8_t *)(src + i));
+        uint8x8x4_t d = vld4_u8((const uint8_t *)(dst + i));
+        uint8x8_t inv = vmvn_u8(s.val[3]);
+
+        for (int c = 0; c < 4; c++)
+        {
+            uint16x8_t t = vmull_u8(d.val[c], inv);
+
+            // (t + ((t + 128) >> 8) + 128) >> 8, same rounding as blend_div255
+            d.val[c] = vqadd_u8(s.val[c], vraddhn_u16(t, vrshrq_n_u16(t, 8)));
+        }
+
+        vst4_u8((uint8_t *)(dst + i), d);
+    }
+
+    xDRM_Blend_Scalar(dst + i, src + i, count - i);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+// two pixels widened to 16bit lanes
+static inline __m128i blend_sse2_half(__m128i d, __m128i s)
+{
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i full = _mm_set1_epi16(255);
+    // alpha is lane 3 of each pixel, broadcast to its 4 lanes
+    __m128i inv = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF));
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(d, inv), bias);
+
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void blend_sse2(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = blend_sse2_half(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+        __m128i hi = blend_sse2_half(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+
+    xDRM_Blend_Scalar(dst + i, src + i, count - i);
+}
+#endif
+
+void xDRM_Blend(uint32_t *dst, const uint32_t *src, uint32_t count)
+{
+#if defined(__aarch64__)
+    blend_neon(dst, src, count);
+#elif defined(__x86_64__) || defined(__i386__)
+    blend_sse2(dst, src, count);
+#else
+    xDRM_Blend_Scalar(dst, src, count);
+#endif
+}
+
+void xDRM_Blend_Load(struct xdrm_blend_layer *layer, const uint32_t *data, uint32_t stride, bool premultiplied)
+{
+    uint32_t tiles_y = (layer->height + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE;
+
+    // Step 1 : copy, premultiply straight alpha once here instead of every frame
+    for (uint32_t y = 0; y < layer->height; y++)
+    {
+        const uint32_t *s = (const uint32_t *)((const uint8_t *)data + (size_t)y * stride);
+        uint32_t *d = layer->pixels + (size_t)y * layer->width;
+
+        if (premultiplied)
+        {
+            memcpy(d, s, layer->width * 4);
+            continue;
+        }
+
+        for (uint32_t x = 0; x < layer->width; x++)
+        {
+            uint32_t p = s[x];
+            uint32_t a = p >> 24;
+
+            if (a == 255 || a == 0)
+            {
+                d[x] = a ? p : 0;
+                continue;
+            }
+
+            d[x] = (a << 24) |
+                   (blend_div255(((p >> 16) & 0xFF) * a) << 16) |
+                   (blend_div255(((p >> 8) & 0xFF) * a) << 8) |
+                   blend_div255((p & 0xFF) * a);
+        }
+    }
+
+    // Step 2 : classify tiles, composing skips transparent ones and copies opaque ones
+    for (uint32_t ty = 0; ty < tiles_y; ty++)
+    {
+        for (uint32_t tx = 0; tx < layer->tiles_x; tx++)
+        {
+            uint32_t x0 = tx * XDRM_BLEND_TILE;
+            uint32_t y0 = ty * XDRM_BLEND_TILE;
+            uint32_t x1 = x0 + XDRM_BLEND_TILE < layer->width ? x0 + XDRM_BLEND_TILE : layer->width;
+            uint32_t y1 = y0 + XDRM_BLEND_TILE < layer->height ? y0 + XDRM_BLEND_TILE : layer->height;
+            bool transparent = true;
+            bool opaque = true;
+
+            for (uint32_t y = y0; y < y1 && (transparent || opaque); y++)
+            {
+                const uint32_t *p = layer->pixels + (size_t)y * layer->width;
+
+                for (uint32_t x = x0; x < x1; x++)
+                {
+                    transparent &= p[x] == 0;
+                    opaque &= (p[x] >> 24) == 255;
+                }
+            }
+
+            layer->tiles[ty * layer->tiles_x + tx] = transparent ? XDRM_BLEND_TRANSPARENT :
+                                                     opaque ? XDRM_BLEND_OPAQUE : XDRM_BLEND_MIXED;
+        }
+    }
+}
+
+/**
+ * @brief Range of layer tiles touched by frame row fy within [x, x + width), false when none.
+ */
+static bool blend_layer_span(const struct xdrm_blend_layer *layer, uint32_t fy, uint32_t x, uint32_t width,
+                             uint32_t *x0, uint32_t *x1)
+{
+    if (fy < layer->y || fy >= layer->y + layer->height)
+        return false;
+
+    *x0 = x > layer->x ? x : layer->x;
+    *x1 = x + width < layer->x + layer->width ? x + width : layer->x + layer->width;
+
+    return *x0 < *x1;
+}
+
+static bool blend_row_visible(const struct xdrm_blend_layer *layers, uint32_t count, uint32_t fy, uint32_t x, uint32_t width)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const struct xdrm_blend_layer *layer = &layers[i];
+        const uint8_t *tiles;
+        uint32_t x0, x1;
+
+        if (!blend_layer_span(layer, fy, x, width, &x0, &x1))
+            continue;
+
+        tiles = layer->tiles + ((fy - layer->y) / XDRM_BLEND_TILE) * layer->tiles_x;
+        for (uint32_t tx = (x0 - layer->x) / XDRM_BLEND_TILE; tx <= (x1 - 1 - layer->x) / XDRM_BLEND_TILE; tx++)
+        {
+            if (tiles[tx] != XDRM_BLEND_TRANSPARENT)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Blend one row of layer over row, which holds frame pixels from x on.
+ */
+static void blend_layer_row(uint32_t *row, const struct xdrm_blend_layer *layer, uint32_t fy, uint32_t x, uint32_t width)
+{
+    const uint8_t *tiles;
+    const uint32_t *pixels;
+    uint32_t x0, x1;
+
+    if (!blend_layer_span(layer, fy, x, width, &x0, &x1))
+        return;
+
+    tiles = layer->tiles + ((fy - layer->y) / XDRM_BLEND_TILE) * layer->tiles_x;
+    pixels = layer->pixels + (size_t)(fy - layer->y) * layer->width;
+
+    // consecutive tiles of one class are handled as a single span
+    while (x0 < x1)
+    {
+        uint32_t tx = (x0 - layer->x) / XDRM_BLEND_TILE;
+        uint8_t kind = tiles[tx];
+        uint32_t end = layer->x + (tx + 1) * XDRM_BLEND_TILE;
+
+        while (end < x1 && tiles[(end - layer->x) / XDRM_BLEND_TILE] == kind)
+            end += XDRM_BLEND_TILE;
+        if (end > x1)
+            end = x1;
+
+        if (kind == XDRM_BLEND_OPAQUE)
+            memcpy(row + (x0 - x), pixels + (x0 - layer->x), (end - x0) * 4);
+        else if (kind == XDRM_BLEND_MIXED)
+            xDRM_Blend(row + (x0 - x), pixels + (x0 - layer->x), end - x0);
+
+        x0 = end;
+    }
+}
+
+void xDRM_Blend_Compose(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+                        uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                        const struct xdrm_blend_layer *layers, uint32_t count, uint32_t *row)
+{
+    uint32_t r = 0;
+
+    while (r < height)
+    {
+        uint32_t run = 0;
+
+        // Step 1 : rows without visible layer pixels go straight to dst
+        while (r + run < height && !blend_row_visible(layers, count, y + r + run, x, width))
+            run++;
+
+        if (run)
+        {
+            xDRM_Copy(dst + (size_t)r * dst_stride, dst_stride, src + (size_t)r * src_stride, src_stride, width * 4, run);
+            r += run;
+            continue;
+        }
+
+        // Step 2 : blend in a cached row, dst is write-combined and written once
+        memcpy(row, src + (size_t)r * src_stride, width * 4);
+        for (uint32_t i = 0; i < count; i++)
+            blend_layer_row(row, &layers[i], y + r, x, width);
+        xDRM_Copy(dst + (size_t)r * dst_stride, dst_stride, (const uint8_t *)row, 0, width * 4, 1);
+        r++;
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "../copy/copy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// layers are classified by square tiles of XDRM_BLEND_TILE pixels
+#define XDRM_BLEND_TILE 16
+
+enum xdrm_blend_tile
+{
+    // every pixel is 0, video passes through
+    XDRM_BLEND_TRANSPARENT = 0,
+    // every alpha is 0xFF, layer replaces video
+    XDRM_BLEND_OPAQUE,
+    // blended per pixel
+    XDRM_BLEND_MIXED,
+};
+
+struct xdrm_blend_layer
+{
+    // premultiplied ARGB8888, width x height packed
+    uint32_t *pixels;
+    // enum xdrm_blend_tile per tile, row major
+    uint8_t *tiles;
+    uint32_t tiles_x;
+    uint32_t width;
+    uint32_t height;
+    // position on frame, layer lies inside frame
+    uint32_t x;
+    uint32_t y;
+};
+
+/**
+ * @brief Blend premultiplied src over dst in place, dst = src + dst * (255 - src alpha) / 255.
+ * @note Reference for the SIMD kernels, results are bit exact.
+ *
+ * @param dst ARGB8888 pixels, alpha of result follows the same rule
+ * @param src premultiplied ARGB8888 pixels
+ * @param count number of pixels
+ */
+void xDRM_Blend_Scalar(uint32_t *dst, const uint32_t *src, uint32_t count);
+
+/**
+ * @brief Same as xDRM_Blend_Scalar with NEON or SSE2.
+ */
+void xDRM_Blend(uint32_t *dst, const uint32_t *src, uint32_t count);
+
+/**
+ * @brief Copy an ARGB8888 image into layer, premultiply it and classify its tiles.
+ * @note Done once per layer update, so every composed frame only reads the result.
+ *
+ * @param layer layer with pixels and tiles allocated for width x height
+ * @param data source image
+ * @param stride bytes per row of data
+ * @param premultiplied data is already premultiplied
+ */
+void xDRM_Blend_Load(struct xdrm_blend_layer *layer, const uint32_t *data, uint32_t stride, bool premultiplied);
+
+/**
+ * @brief Compose layers over a region of video and write it to dst in one pass.
+ * @note Each covered row is blended in a cached row and streamed to dst by xDRM_Copy,
+ *       rows and tiles without visible layer pixels are copied without blending.
+ *
+ * @param dst destination at (x, y) of frame, write-combined dumb buffer
+ * @param dst_stride bytes per destination row
+ * @param src video at (x, y) of frame, ARGB8888
+ * @param src_stride bytes per source row
+ * @param x region on frame
+ * @param y region on frame
+ * @param width region width
+ * @param height region height
+ * @param layers bottom first
+ * @param count number of layers
+ * @param row scratch of width pixels, stays in cache
+ */
+void xDRM_Blend_Compose(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride,
+                        uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                        const struct xdrm_blend_layer *layers, uint32_t count, uint32_t *row);
+
+#ifdef __cplusplus
+}
+#endif
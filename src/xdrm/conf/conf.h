@@ -3,13 +3,23 @@
 #include "debug.h"
 #include "device.h"
 
+#include "../backend/backend.h"
+#include "../blend/blend.h"
+#include "../copy/copy.h"
 #include "../fps/fps.h"
+#include "../latency/latency.h"
+#include "../pacing/pacing.h"
 #include "../pattern/pattern.h"
+#include "../rt/rt.h"
+#include "../scale/scale.h"
+#include "../topology/topology.h"
+#include "../trace/trace.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// props point into topology, owned by it
 struct drm_object
 {
     drmModeObjectProperties *props;
@@ -17,41 +27,255 @@ struct drm_object
     uint32_t id;
 };
 
+// plane properties used by flip, resolved once at setup
+enum modeset_plane_prop
+{
+    MODESET_PLANE_FB_ID = 0,
+    MODESET_PLANE_CRTC_ID,
+    MODESET_PLANE_SRC_X,
+    MODESET_PLANE_SRC_Y,
+    MODESET_PLANE_SRC_W,
+    MODESET_PLANE_SRC_H,
+    MODESET_PLANE_CRTC_X,
+    MODESET_PLANE_CRTC_Y,
+    MODESET_PLANE_CRTC_W,
+    MODESET_PLANE_CRTC_H,
+    MODESET_PLANE_ZPOS,
+    MODESET_PLANE_FB_DAMAGE_CLIPS,
+    MODESET_PLANE_ALPHA,
+    MODESET_PLANE_PROP_NUM,
+};
+
+// dumb buffers per device, chosen at xDRM_Init between 2 and MODESET_BUF_MAX
+#define MODESET_BUF_MAX 8
+#define MODESET_BUF_DEFAULT 3
+
+// dma-buf framebuffers cached per device by xDRM_ImportDmabuf, kept in bufs after the dumb buffers
+#define MODESET_IMPORT_MAX 8
+
+// overlay planes per output, added by xDRM_Add_Layer, and CPU composed layers, added by xDRM_Add_Soft_Layer
+#define MODESET_LAYER_MAX 3
+
+// outputs sharing one fd and one event loop, linked by modeset_dev::next
+#define MODESET_OUTPUT_MAX 4
+
+enum modeset_buf_state
+{
+    MODESET_BUF_FREE = 0,
+    MODESET_BUF_ACQUIRED,
+    MODESET_BUF_QUEUED,
+    MODESET_BUF_PENDING,
+    MODESET_BUF_SCANOUT,
+    // import slot which holds no dma-buf
+    MODESET_BUF_UNUSED,
+    MODESET_BUF_STATE_NUM,
+};
+
+struct modeset_rect
+{
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+// where the source goes on the CRTC, set by xDRM_Set_Scale
+enum modeset_scale
+{
+    // 1:1 at x_offset, y_offset
+    MODESET_SCALE_NONE = 0,
+    // largest size keeping aspect ratio, letterboxed
+    MODESET_SCALE_FIT,
+    // cover the whole mode keeping aspect ratio, source is cropped
+    MODESET_SCALE_FILL,
+    // largest integer multiple which fits, centred
+    MODESET_SCALE_INTEGER,
+    // explicit rect on CRTC
+    MODESET_SCALE_RECT,
+};
+
+struct modeset_layout
+{
+    // region of source shown
+    struct modeset_rect src;
+    // region of CRTC it covers
+    struct modeset_rect crtc;
+    // plane cannot scale, frames are scaled by CPU into modeset_dev::scaled
+    bool cpu_scale;
+    // stacking order, 0 for the video plane of an output
+    uint32_t zpos;
+    // plane opacity, 0xFFFF is opaque
+    uint16_t alpha;
+};
+
+// scanout formats: ARGB8888, XRGB8888, RGB565, YUYV, NV12, NV16
+#define MODESET_FORMAT_DEFAULT DRM_FORMAT_ARGB8888
+
 struct modeset_buf
 {
     uint32_t width;
     uint32_t height;
+    uint32_t format;
+    // pitch of plane 0, same as pitches[0]
     uint32_t stride;
     uint32_t size;
     uint32_t handle;
     uint32_t fb;
+    // NULL for an imported dma-buf, CPU never touches it
     uint8_t *map;
+    // dma-buf fd which fb was imported from, cache key, -1 for dumb buffers
+    int dmabuf_fd;
+
+    // YUV planes share one dumb buffer, plane n starts at map + offsets[n]
+    uint32_t planes;
+    uint32_t pitches[4];
+    uint32_t offsets[4];
+
+    // ownership is handed over by atomic compare-and-swap on state
+    enum modeset_buf_state state;
+    uint64_t seq;
+
+    // changed against the frame submitted before this one, sent as FB_DAMAGE_CLIPS and
+    // summed up by xDRM_PushRegion to find what an older buffer misses
+    struct modeset_rect damage;
+
+    // when the frame in it passed each stage, recorded once its flip completes
+    struct xdrm_latency_stamp stamp;
+};
+
+struct modeset_buf_stats
+{
+    // buffers in swapchain
+    uint32_t count;
+    // frames allowed to wait for display
+    uint32_t queue_depth;
+    // buffers per enum modeset_buf_state, import slots included
+    uint32_t state[MODESET_BUF_STATE_NUM];
+};
+
+// frame accounting since xDRM_Init, read by xDRM_GetStats
+struct modeset_stats
+{
+    // vblanks since first flip, from kernel sequence of flip events
+    uint64_t vblanks;
+    // vblanks which passed without a flip completing, the display side committed late
+    uint64_t missed_vblanks;
+    // flips which brought a new frame
+    uint64_t presented;
+    // flips which showed the same frame again because nothing was queued, producer starved
+    uint64_t repeated;
+    // flips which showed the same frame again by choice of pacer, target fps below refresh
+    uint64_t held;
+    // submitted frames handed back unseen, newer ones took their place in the queue
+    uint64_t overwritten;
+    // pushes refused with -EBUSY, every buffer was on screen, in flight or acquired
+    uint64_t busy;
+};
+
+struct modeset_latency_stats
+{
+    // per enum xdrm_latency_stage, frames which reached the screen since xDRM_Init or last reset
+    struct xdrm_latency_summary stage[XDRM_LATENCY_STAGE_NUM];
 };
 
 struct modeset_dev
 {
     struct modeset_dev *next;
+    // scan out front buffer of this output instead of own buffers
+    struct modeset_dev *mirror_of;
+    // overlay plane on the CRTC of this output, flips along with it
+    struct modeset_dev *layer_of;
+    // buffer of a layer in the request being committed, -1 when its plane is not in it
+    int layer_buf;
+
+    // DRM fd, for imports made from producer side
+    int fd;
+    // snapshot of fd taken by xDRM_Init, shared by the whole list
+    struct xdrm_topology *topology;
 
     unsigned int front_buf;
-    struct modeset_buf bufs[2];
+    // dumb buffers first, then MODESET_IMPORT_MAX import slots
+    struct modeset_buf bufs[MODESET_BUF_MAX + MODESET_IMPORT_MAX];
+    uint32_t buf_count;
+    uint32_t format;
+    uint32_t queue_depth;
+    uint64_t submit_seq;
     struct drm_object connector;
     struct drm_object crtc;
     struct drm_object plane;
+    // property id per enum modeset_plane_prop, 0 when plane lacks it
+    uint32_t plane_props[MODESET_PLANE_PROP_NUM];
+
+    // reused by every flip, rewound with drmModeAtomicSetCursor
+    drmModeAtomicReq *flip_req;
+    // geometry not committed yet, otherwise flip only sends FB_ID
+    bool plane_dirty;
+    // FB_DAMAGE_CLIPS blob of the request being committed
+    uint32_t damage_blob;
 
     uint32_t src_width;
     uint32_t src_height;
     int x_offset;
     int y_offset;
 
+    // geometry of flips, owned by display side
+    struct modeset_layout layout;
+    // written by xDRM_Set_Scale, taken by display side when layout_seq moves, odd while writing
+    struct modeset_layout layout_pending;
+    uint32_t layout_seq;
+    uint32_t layout_applied;
+
+    // CPU scale fallback, mode sized, allocated on first use
+    struct modeset_buf scaled[2];
+    // seq of the frame held by each scaled buffer
+    uint64_t scaled_seq[2];
+    int scaled_front;
+    int scaled_next;
+    // row scratch of xDRM_Scale per plane of format, allocated along with scaled
+    struct xdrm_scale_scratch scale_scratch[2];
+
+    // composed by CPU into pushed frames when no overlay plane is free, bottom first, owned by producer
+    struct xdrm_blend_layer soft_layers[MODESET_LAYER_MAX];
+    uint32_t soft_layer_count;
+    // scratch row of src_width pixels for composing
+    uint32_t *soft_row;
+
     drmModeModeInfo mode;
     uint32_t mode_blob_id;
 
+    struct frame_pacer pacer;
+    struct fps_stats fps_stats;
+    // applied by xDRM_Draw to the display thread, set on the list head
+    struct xdrm_rt_config rt;
+    // per enum xdrm_latency_stage, a mirror records into its source
+    struct xdrm_latency_hist latency[XDRM_LATENCY_STAGE_NUM];
+    // counters grow by relaxed atomics, producers count overwritten and busy
+    struct modeset_stats stats;
+    // kernel sequence of last flip event, 0 before first one
+    unsigned int stats_sequence;
+    // print stats once per stats_log_ms from flip events, 0 for off
+    uint32_t stats_log_ms;
+    uint64_t stats_log_ns;
+    struct modeset_stats stats_logged;
+
     bool pflip_pending;
+    // flip to queue after event dispatch, kept when commit hit EBUSY
+    bool pflip_due;
+    bool pflip_due_present;
     bool cleanup;
 
-    uint32_t *data_buffer;
-    pthread_mutex_t buffer_mutex;
-    bool buffer_updated;
+    // eventfd of the list, polled by xDRM_Draw beside fd, -1 when it could not be created
+    int wake_fd;
+    // flip only when a new frame or layout waits, producers wake the loop
+    bool present_on_push;
+    // flip a new frame at once with DRM_MODE_PAGE_FLIP_ASYNC, tearing allowed, implies present on push
+    bool async_flip;
+    // async flips go through legacy page flip, driver has no atomic async flip
+    bool async_legacy;
+    // nothing to flip, set by display side, cleared by the producer which wakes it
+    bool idle;
+    // xDRM_Draw returns, set on list head by xDRM_Stop_Draw
+    bool quit;
 };
 
 #ifdef __cplusplus
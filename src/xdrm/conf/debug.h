@@ -8,6 +8,9 @@ extern "C" {
 
 #define __ENABLE_PATTERN__ 0
 
+// frame lifecycle events to trace_marker or ring, see trace/trace.h
+#define __ENABLE_TRACE__ 0
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
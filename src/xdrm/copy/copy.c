@@ -0,0 +1,251 @@
+#include "copy.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+typedef void (*copy_func)(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows);
+
+void xDRM_Copy_Scalar(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows)
+{
+    // one memcpy when both sides are packed
+    if (dst_stride == row_bytes && src_stride == row_bytes)
+    {
+        memcpy(dst, src, (size_t)row_bytes * rows);
+        return;
+    }
+
+    for (uint32_t y = 0; y < rows; y++)
+        memcpy(dst + (size_t)y * dst_stride, src + (size_t)y * src_stride, row_bytes);
+}
+
+/**
+ * @brief Bytes to copy before dst reaches align, streaming stores need aligned destination.
+ */
+static size_t copy_head(const uint8_t *dst, size_t align, size_t bytes)
+{
+    size_t head = (align - ((uintptr_t)dst & (align - 1))) & (align - 1);
+
+    return head < bytes ? head : bytes;
+}
+
+#if defined(__aarch64__)
+static void copy_neon(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows)
+{
+    for (uint32_t y = 0; y < rows; y++)
+    {
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        const uint8_t *s = src + (size_t)y * src_stride;
+        size_t n = row_bytes;
+        size_t head = copy_head(d, 16, n);
+
+        memcpy(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+
+        // 64 bytes per loop, STNP writes a pair of Q registers without allocating cache lines
+        for (; n >= 64; n -= 64, d += 64, s += 64)
+        {
+            uint8x16_t v0 = vld1q_u8(s);
+            uint8x16_t v1 = vld1q_u8(s + 16);
+            uint8x16_t v2 = vld1q_u8(s + 32);
+            uint8x16_t v3 = vld1q_u8(s + 48);
+
+            __asm__ volatile(
+                "stnp %q[v0], %q[v1], [%[d]]\n\t"
+                "stnp %q[v2], %q[v3], [%[d], #32]\n\t"
+                :
+                : [v0] "w"(v0), [v1] "w"(v1), [v2] "w"(v2), [v3] "w"(v3), [d] "r"(d)
+                : "memory");
+        }
+
+        for (; n >= 16; n -= 16, d += 16, s += 16)
+            vst1q_u8(d, vld1q_u8(s));
+
+        memcpy(d, s, n);
+    }
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void copy_sse2(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows)
+{
+    for (uint32_t y = 0; y < rows; y++)
+    {
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        const uint8_t *s = src + (size_t)y * src_stride;
+        size_t n = row_bytes;
+        size_t head = copy_head(d, 16, n);
+
+        memcpy(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+
+        for (; n >= 64; n -= 64, d += 64, s += 64)
+        {
+            __m128i v0 = _mm_loadu_si128((const __m128i *)s);
+            __m128i v1 = _mm_loadu_si128((const __m128i *)(s + 16));
+            __m128i v2 = _mm_loadu_si128((const __m128i *)(s + 32));
+            __m128i v3 = _mm_loadu_si128((const __m128i *)(s + 48));
+
+            _mm_stream_si128((__m128i *)d, v0);
+            _mm_stream_si128((__m128i *)(d + 16), v1);
+            _mm_stream_si128((__m128i *)(d + 32), v2);
+            _mm_stream_si128((__m128i *)(d + 48), v3);
+        }
+
+        for (; n >= 16; n -= 16, d += 16, s += 16)
+            _mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+
+        memcpy(d, s, n);
+    }
+
+    // streaming stores are weakly ordered, drain them before the buffer is submitted
+    _mm_sfence();
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows)
+{
+    for (uint32_t y = 0; y < rows; y++)
+    {
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        const uint8_t *s = src + (size_t)y * src_stride;
+        size_t n = row_bytes;
+        size_t head = copy_head(d, 32, n);
+
+        memcpy(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+
+        for (; n >= 128; n -= 128, d += 128, s += 128)
+        {
+            __m256i v0 = _mm256_loadu_si256((const __m256i *)s);
+            __m256i v1 = _mm256_loadu_si256((const __m256i *)(s + 32));
+            __m256i v2 = _mm256_loadu_si256((const __m256i *)(s + 64));
+            __m256i v3 = _mm256_loadu_si256((const __m256i *)(s + 96));
+
+            _mm256_stream_si256((__m256i *)d, v0);
+            _mm256_stream_si256((__m256i *)(d + 32), v1);
+            _mm256_stream_si256((__m256i *)(d + 64), v2);
+            _mm256_stream_si256((__m256i *)(d + 96), v3);
+        }
+
+        for (; n >= 32; n -= 32, d += 32, s += 32)
+            _mm256_stream_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+
+        memcpy(d, s, n);
+    }
+
+    _mm_sfence();
+    _mm256_zeroupper();
+}
+#endif
+
+static const char *copy_kernel_names[XDRM_COPY_KERNEL_NUM] = {
+    [XDRM_COPY_AUTO] = "auto",
+    [XDRM_COPY_SCALAR] = "scalar",
+    [XDRM_COPY_NEON] = "neon",
+    [XDRM_COPY_SSE2] = "sse2",
+    [XDRM_COPY_AVX2] = "avx2",
+};
+
+static enum xdrm_copy_kernel copy_kernel = XDRM_COPY_AUTO;
+static copy_func copy_impl = NULL;
+
+static copy_func copy_lookup(enum xdrm_copy_kernel kernel)
+{
+    switch (kernel)
+    {
+        case XDRM_COPY_SCALAR:
+            return xDRM_Copy_Scalar;
+#if defined(__aarch64__)
+        // NEON is mandatory on ARMv8-A
+        case XDRM_COPY_NEON:
+            return copy_neon;
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+        case XDRM_COPY_SSE2:
+            return __builtin_cpu_supports("sse2") ? copy_sse2 : NULL;
+        case XDRM_COPY_AVX2:
+            return __builtin_cpu_supports("avx2") ? copy_avx2 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * @brief Best kernel of this CPU, checked from the widest down.
+ */
+static enum xdrm_copy_kernel copy_detect(void)
+{
+    for (int kernel = XDRM_COPY_KERNEL_NUM - 1; kernel > XDRM_COPY_SCALAR; kernel--)
+    {
+        if (copy_lookup((enum xdrm_copy_kernel)kernel))
+            return (enum xdrm_copy_kernel)kernel;
+    }
+
+    return XDRM_COPY_SCALAR;
+}
+
+int xDRM_Copy_Set_Kernel(enum xdrm_copy_kernel kernel)
+{
+    copy_func impl;
+
+    if (kernel >= XDRM_COPY_KERNEL_NUM)
+        return -EINVAL;
+
+    if (kernel == XDRM_COPY_AUTO)
+        kernel = copy_detect();
+
+    impl = copy_lookup(kernel);
+    if (!impl)
+        return -ENOTSUP;
+
+    // publish impl last, xDRM_Copy only reads impl
+    __atomic_store_n(&copy_kernel, kernel, __ATOMIC_RELAXED);
+    __atomic_store_n(&copy_impl, impl, __ATOMIC_RELEASE);
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Copy kernel: %s\n", copy_kernel_names[kernel]);
+#endif
+
+    return 0;
+}
+
+enum xdrm_copy_kernel xDRM_Copy_Get_Kernel(void)
+{
+    if (!__atomic_load_n(&copy_impl, __ATOMIC_ACQUIRE))
+        xDRM_Copy_Set_Kernel(XDRM_COPY_AUTO);
+
+    return __atomic_load_n(&copy_kernel, __ATOMIC_RELAXED);
+}
+
+const char *xDRM_Copy_Kernel_Name(enum xdrm_copy_kernel kernel)
+{
+    if (kernel >= XDRM_COPY_KERNEL_NUM)
+        return "unknown";
+
+    return copy_kernel_names[kernel];
+}
+
+void xDRM_Copy(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows)
+{
+    copy_func impl = __atomic_load_n(&copy_impl, __ATOMIC_ACQUIRE);
+
+    // first call picks the kernel
+    if (!impl)
+    {
+        xDRM_Copy_Set_Kernel(XDRM_COPY_AUTO);
+        impl = __atomic_load_n(&copy_impl, __ATOMIC_ACQUIRE);
+    }
+
+    impl(dst, dst_stride, src, src_stride, row_bytes, rows);
+}
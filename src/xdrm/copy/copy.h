@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum xdrm_copy_kernel
+{
+    XDRM_COPY_AUTO = 0,
+    XDRM_COPY_SCALAR,
+    XDRM_COPY_NEON,
+    XDRM_COPY_SSE2,
+    XDRM_COPY_AVX2,
+    XDRM_COPY_KERNEL_NUM,
+};
+
+/**
+ * @brief Reference copy, row by row with memcpy.
+ *
+ * @param dst destination, rows of dst_stride bytes
+ * @param dst_stride bytes per destination row, pitch of dumb buffer
+ * @param src source, rows of src_stride bytes
+ * @param src_stride bytes per source row
+ * @param row_bytes bytes to copy in each row
+ * @param rows number of rows
+ */
+void xDRM_Copy_Scalar(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows);
+
+/**
+ * @brief Copy rows into a write-combined mapping with the fastest kernel of this CPU.
+ * @note SIMD kernels use non-temporal stores, destination is not pulled into cache.
+ *
+ * @param dst destination, rows of dst_stride bytes
+ * @param dst_stride bytes per destination row, pitch of dumb buffer
+ * @param src source, rows of src_stride bytes
+ * @param src_stride bytes per source row
+ * @param row_bytes bytes to copy in each row
+ * @param rows number of rows
+ */
+void xDRM_Copy(uint8_t *dst, uint32_t dst_stride, const uint8_t *src, uint32_t src_stride, uint32_t row_bytes, uint32_t rows);
+
+/**
+ * @brief Force a kernel, for tests and benchmarks.
+ *
+ * @param kernel XDRM_COPY_AUTO picks the best supported one
+ * @return 0 on success, -ENOTSUP when CPU or build lacks the kernel.
+ */
+int xDRM_Copy_Set_Kernel(enum xdrm_copy_kernel kernel);
+
+/**
+ * @brief Kernel used by xDRM_Copy.
+ */
+enum xdrm_copy_kernel xDRM_Copy_Get_Kernel(void);
+
+/**
+ * @brief Name of kernel, for logs.
+ */
+const char *xDRM_Copy_Kernel_Name(enum xdrm_copy_kernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
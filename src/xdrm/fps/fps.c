@@ -8,6 +8,11 @@ void xDRM_Init_FPS_Stats(struct fps_stats *stats)
     stats->avg_fps = 0.0f;
     stats->total_frames = 0;
     stats->total_time = 0;
+    stats->commit_time = 0;
+    stats->commit_count = 0;
+    stats->wake_time = 0;
+    stats->wake_max = 0;
+    stats->wake_count = 0;
 }
 
 void xDRM_Update_FPS_Stats(struct fps_stats *stats)
@@ -30,16 +35,38 @@ void xDRM_Update_FPS_Stats(struct fps_stats *stats)
         stats->avg_fps = (float)stats->total_frames * 1000 / stats->total_time;
 
 #if __ENABLE_DEBUG_LOG__
-        printf("FPS: %.2f (Current) %.2f (Average) - Frames: %ld Time: %.2fs\n",
+        printf("FPS: %.2f (Current) %.2f (Average) - Frames: %ld Time: %.2fs Commit: %.1fus Wake: %.1fus (max %ldus)\n",
                stats->fps,
                stats->avg_fps,
                stats->total_frames,
-               stats->total_time / 1000.0f);
+               stats->total_time / 1000.0f,
+               stats->commit_count ? (float)stats->commit_time / stats->commit_count : 0.0f,
+               stats->wake_count ? (float)stats->wake_time / stats->wake_count : 0.0f,
+               stats->wake_max);
 #endif
 
         // reset conter
         stats->frame_count = 0;
+        stats->commit_time = 0;
+        stats->commit_count = 0;
+        stats->wake_time = 0;
+        stats->wake_max = 0;
+        stats->wake_count = 0;
         stats->last_time = stats->current_time;
     }
     // clang-format on
-}
\ No newline at end of file
+}
+
+void xDRM_Update_FPS_Commit_Time(struct fps_stats *stats, long commit_us)
+{
+    stats->commit_time += commit_us;
+    stats->commit_count++;
+}
+
+void xDRM_Update_FPS_Wake_Time(struct fps_stats *stats, long wake_us)
+{
+    stats->wake_time += wake_us;
+    stats->wake_count++;
+    if (wake_us > stats->wake_max)
+        stats->wake_max = wake_us;
+}
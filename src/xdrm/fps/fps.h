@@ -17,12 +17,23 @@ struct fps_stats
     float avg_fps;
     long total_frames;
     long total_time;
+    // time spent in atomic commit ioctl (microseconds)
+    long commit_time;
+    long commit_count;
+    // flip event handled after its vblank (microseconds), how long display thread took to wake
+    long wake_time;
+    long wake_max;
+    long wake_count;
 };
 
 void xDRM_Init_FPS_Stats(struct fps_stats *stats);
 
 void xDRM_Update_FPS_Stats(struct fps_stats *stats);
 
+void xDRM_Update_FPS_Commit_Time(struct fps_stats *stats, long commit_us);
+
+void xDRM_Update_FPS_Wake_Time(struct fps_stats *stats, long wake_us);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
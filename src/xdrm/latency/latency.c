@@ -0,0 +1,116 @@
+#include "latency.h"
+
+#define LATENCY_SUB (1u << XDRM_LATENCY_SUB_BITS)
+
+uint64_t xDRM_Latency_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t latency_bucket(uint64_t ns)
+{
+    uint32_t msb, index;
+
+    if (ns < LATENCY_SUB)
+        return (uint32_t)ns;
+
+    // leading bit picks the power of two, the next SUB_BITS bits pick the bucket inside it
+    msb = 63 - __builtin_clzll(ns);
+    index = ((msb - XDRM_LATENCY_SUB_BITS + 1) << XDRM_LATENCY_SUB_BITS) + (uint32_t)((ns >> (msb - XDRM_LATENCY_SUB_BITS)) & (LATENCY_SUB - 1));
+
+    return index < XDRM_LATENCY_BUCKETS ? index : XDRM_LATENCY_BUCKETS - 1;
+}
+
+// smallest ns falling into bucket index
+static uint64_t latency_bucket_low(uint32_t index)
+{
+    uint32_t shift;
+
+    if (index < LATENCY_SUB)
+        return index;
+
+    shift = (index >> XDRM_LATENCY_SUB_BITS) - 1;
+    return (uint64_t)(LATENCY_SUB + (index & (LATENCY_SUB - 1))) << shift;
+}
+
+void xDRM_Latency_Record(struct xdrm_latency_hist *hist, uint64_t ns)
+{
+    uint64_t max = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&hist->buckets[latency_bucket(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+
+    while (ns > max && !__atomic_compare_exchange_n(&hist->max_ns, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void latency_record_span(struct xdrm_latency_hist *hist, uint64_t from, uint64_t to)
+{
+    // a stage missed by its stamp, or clocks crossing on another CPU, is not a sample
+    if (from && to >= from)
+        xDRM_Latency_Record(hist, to - from);
+}
+
+void xDRM_Latency_Record_Frame(struct xdrm_latency_hist *hists, const struct xdrm_latency_stamp *stamp, uint64_t vblank_ns)
+{
+    latency_record_span(&hists[XDRM_LATENCY_ACQUIRE], stamp->push_ns, stamp->acquire_ns);
+    latency_record_span(&hists[XDRM_LATENCY_COPY], stamp->acquire_ns, stamp->submit_ns);
+    latency_record_span(&hists[XDRM_LATENCY_QUEUE], stamp->submit_ns, stamp->commit_ns);
+    latency_record_span(&hists[XDRM_LATENCY_SCANOUT], stamp->commit_ns, vblank_ns);
+    latency_record_span(&hists[XDRM_LATENCY_TOTAL], stamp->push_ns, vblank_ns);
+}
+
+void xDRM_Latency_Reset(struct xdrm_latency_hist *hist)
+{
+    for (int i = 0; i < XDRM_LATENCY_BUCKETS; i++)
+        __atomic_store_n(&hist->buckets[i], 0, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&hist->count, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->sum_ns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&hist->max_ns, 0, __ATOMIC_RELAXED);
+}
+
+void xDRM_Latency_Summarize(const struct xdrm_latency_hist *hist, struct xdrm_latency_summary *summary)
+{
+    uint32_t buckets[XDRM_LATENCY_BUCKETS];
+    uint64_t count = 0, seen = 0, p50, p99;
+
+    memset(summary, 0, sizeof(*summary));
+
+    // counts come from buckets, so percentiles agree with each other under concurrent records
+    for (int i = 0; i < XDRM_LATENCY_BUCKETS; i++)
+    {
+        buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+        count += buckets[i];
+    }
+    if (!count)
+        return;
+
+    summary->count = count;
+    summary->max_ns = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    summary->avg_ns = __atomic_load_n(&hist->sum_ns, __ATOMIC_RELAXED) / count;
+
+    // rank of percentile, rounded up
+    p50 = (count * 50 + 99) / 100;
+    p99 = (count * 99 + 99) / 100;
+    for (int i = 0; i < XDRM_LATENCY_BUCKETS; i++)
+    {
+        uint64_t high = i + 1 < XDRM_LATENCY_BUCKETS ? latency_bucket_low(i + 1) - 1 : summary->max_ns;
+
+        if (high > summary->max_ns)
+            high = summary->max_ns;
+
+        if (seen < p50 && seen + buckets[i] >= p50)
+            summary->p50_ns = high;
+        if (seen < p99 && seen + buckets[i] >= p99)
+        {
+            summary->p99_ns = high;
+            break;
+        }
+        seen += buckets[i];
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// log-linear buckets, 16 per power of two, about 6% resolution from 16ns up to a minute
+#define XDRM_LATENCY_SUB_BITS 4
+#define XDRM_LATENCY_BUCKETS ((36 - XDRM_LATENCY_SUB_BITS + 2) << XDRM_LATENCY_SUB_BITS)
+
+// stages of a displayed frame, every one ends where the one before starts except COMMIT
+enum xdrm_latency_stage
+{
+    // push called until a buffer is acquired, 0 for xDRM_AcquireBuffer
+    XDRM_LATENCY_ACQUIRE = 0,
+    // acquired until submitted, copy and compose, or rendering for xDRM_AcquireBuffer
+    XDRM_LATENCY_COPY,
+    // submitted until its flip is committed, waiting in queue for a vblank
+    XDRM_LATENCY_QUEUE,
+    // committed until flip completes, by kernel vblank timestamp
+    XDRM_LATENCY_SCANOUT,
+    // push called until flip completes
+    XDRM_LATENCY_TOTAL,
+    // atomic commit ioctl, per flip
+    XDRM_LATENCY_COMMIT,
+    XDRM_LATENCY_STAGE_NUM,
+};
+
+/**
+ * Counters only grow by relaxed atomics, producers and display record without lock.
+ * A snapshot taken while recording may miss a sample in count or sum, never more.
+ */
+struct xdrm_latency_hist
+{
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint32_t buckets[XDRM_LATENCY_BUCKETS];
+};
+
+// CLOCK_MONOTONIC ns a buffer passed each stage, owned by whoever owns the buffer
+struct xdrm_latency_stamp
+{
+    uint64_t push_ns;
+    uint64_t acquire_ns;
+    uint64_t submit_ns;
+    // 0 until committed, cleared again when recorded at flip
+    uint64_t commit_ns;
+};
+
+struct xdrm_latency_summary
+{
+    uint64_t count;
+    uint64_t avg_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+/**
+ * @brief CLOCK_MONOTONIC now, same clock as vblank timestamps.
+ */
+uint64_t xDRM_Latency_Now(void);
+
+/**
+ * @brief Add a sample, safe from any thread.
+ */
+void xDRM_Latency_Record(struct xdrm_latency_hist *hist, uint64_t ns);
+
+/**
+ * @brief Record stages of a buffer whose flip completed at vblank_ns.
+ * 
+ * @param hists XDRM_LATENCY_STAGE_NUM histograms, COMMIT is not touched
+ */
+void xDRM_Latency_Record_Frame(struct xdrm_latency_hist *hists, const struct xdrm_latency_stamp *stamp, uint64_t vblank_ns);
+
+void xDRM_Latency_Reset(struct xdrm_latency_hist *hist);
+
+/**
+ * @brief Percentiles of hist, a percentile is the upper bound of its bucket capped by max.
+ */
+void xDRM_Latency_Summarize(const struct xdrm_latency_hist *hist, struct xdrm_latency_summary *summary);
+
+#ifdef __cplusplus
+}
+#endif
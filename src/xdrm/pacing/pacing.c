@@ -0,0 +1,125 @@
+#include "pacing.h"
+
+static uint64_t pacer_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void xDRM_Init_Pacer(struct frame_pacer *pacer, uint64_t refresh_ns, uint32_t target_fps)
+{
+    pacer->refresh_ns = refresh_ns;
+    pacer->target_fps = target_fps;
+    pacer->last_vblank_ns = 0;
+    pacer->last_sequence = 0;
+    pacer->next_present_ns = 0;
+    pacer->next_wake_ns = 0;
+}
+
+uint64_t xDRM_Get_Pacer_Interval(struct frame_pacer *pacer)
+{
+    uint64_t refresh = __atomic_load_n(&pacer->refresh_ns, __ATOMIC_RELAXED);
+    uint32_t fps = __atomic_load_n(&pacer->target_fps, __ATOMIC_RELAXED);
+
+    if (fps == 0 || 1000000000ull / fps < refresh)
+        return refresh;
+
+    return 1000000000ull / fps;
+}
+
+bool xDRM_Update_Pacer(struct frame_pacer *pacer, unsigned int sequence, uint64_t timestamp_ns)
+{
+    uint64_t refresh = pacer->refresh_ns;
+    uint64_t interval, next;
+
+    // Step 1 : refine refresh period with back to back vblanks, ignore outliers
+    if (pacer->last_vblank_ns && sequence == pacer->last_sequence + 1 && timestamp_ns > pacer->last_vblank_ns)
+    {
+        uint64_t delta = timestamp_ns - pacer->last_vblank_ns;
+
+        if (delta * 8 > refresh * 7 && delta * 8 < refresh * 9)
+        {
+            refresh = (refresh * 15 + delta) / 16;
+            __atomic_store_n(&pacer->refresh_ns, refresh, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_store_n(&pacer->last_vblank_ns, timestamp_ns, __ATOMIC_RELAXED);
+    pacer->last_sequence = sequence;
+
+    // Step 2 : take a new frame on the vblank nearest to the deadline
+    if (pacer->next_present_ns && timestamp_ns + refresh / 2 < pacer->next_present_ns)
+        return false;
+
+    // Step 3 : schedule next deadline, restart from now when fell behind
+    interval = xDRM_Get_Pacer_Interval(pacer);
+    next = pacer->next_present_ns + interval;
+    if (!pacer->next_present_ns || next <= timestamp_ns)
+        next = timestamp_ns + interval;
+
+    __atomic_store_n(&pacer->next_present_ns, next, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+uint64_t xDRM_Wait_Pacer(struct frame_pacer *pacer)
+{
+    uint64_t slot = __atomic_load_n(&pacer->next_present_ns, __ATOMIC_ACQUIRE);
+    uint64_t vblank = __atomic_load_n(&pacer->last_vblank_ns, __ATOMIC_RELAXED);
+    uint64_t refresh = __atomic_load_n(&pacer->refresh_ns, __ATOMIC_RELAXED);
+    uint64_t interval = xDRM_Get_Pacer_Interval(pacer);
+    uint64_t now = pacer_now_ns();
+    uint64_t wake = now + interval;
+    struct timespec ts;
+
+    // Step 1 : no flip yet, wait one interval
+    if (!slot || !vblank)
+    {
+        slot = wake;
+    }
+    // Step 2 : the vblank nearest to slot takes the frame, wake half a refresh before it
+    else
+    {
+        for (;; slot += interval)
+        {
+            uint64_t take = vblank;
+
+            if (slot > vblank + refresh / 2)
+                take += (slot - refresh / 2 - vblank + refresh - 1) / refresh * refresh;
+
+            wake = take - refresh / 2;
+            if (wake > now)
+                break;
+        }
+    }
+
+    ts.tv_sec = wake / 1000000000ull;
+    ts.tv_nsec = wake % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    return slot;
+}
+
+uint64_t xDRM_Wait_Pacer_Interval(struct frame_pacer *pacer)
+{
+    uint64_t interval = xDRM_Get_Pacer_Interval(pacer);
+    uint64_t now = pacer_now_ns();
+    uint64_t wake = pacer->next_wake_ns;
+    struct timespec ts;
+
+    // restart from now after a stall, no burst to catch up
+    if (!wake || wake + interval <= now)
+        wake = now + interval;
+
+    ts.tv_sec = wake / 1000000000ull;
+    ts.tv_nsec = wake % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+
+    pacer->next_wake_ns = wake + interval;
+
+    return wake;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct frame_pacer
+{
+    // vblank period in ns, from display mode and refined by flip timestamps
+    uint64_t refresh_ns;
+    // 0 for panel refresh rate
+    uint32_t target_fps;
+
+    // CLOCK_MONOTONIC ns and sequence of last vblank
+    uint64_t last_vblank_ns;
+    unsigned int last_sequence;
+
+    // deadline of next new frame, present slots are spaced by interval from it
+    uint64_t next_present_ns;
+
+    // wake of producer by xDRM_Wait_Pacer_Interval, only touched by producer
+    uint64_t next_wake_ns;
+};
+
+void xDRM_Init_Pacer(struct frame_pacer *pacer, uint64_t refresh_ns, uint32_t target_fps);
+
+/**
+ * @brief Feed a vblank from flip event.
+ * 
+ * @param pacer frame_pacer pointer
+ * @param sequence vblank sequence from kernel
+ * @param timestamp_ns vblank timestamp from kernel, CLOCK_MONOTONIC
+ * @return whether a new frame should be shown on next vblank
+ */
+bool xDRM_Update_Pacer(struct frame_pacer *pacer, unsigned int sequence, uint64_t timestamp_ns);
+
+/**
+ * @brief Get ns between two new frames, never shorter than one vblank.
+ */
+uint64_t xDRM_Get_Pacer_Interval(struct frame_pacer *pacer);
+
+/**
+ * @brief Sleep calling thread until half a refresh before the vblank which takes next slot, for producer.
+ * 
+ * @return CLOCK_MONOTONIC ns of the slot
+ */
+uint64_t xDRM_Wait_Pacer(struct frame_pacer *pacer);
+
+/**
+ * @brief Sleep calling thread until one interval after its last wake, not aligned to vblank.
+ * @note For outputs which flip as soon as a frame is pushed, the vblank is not waited for.
+ * 
+ * @return CLOCK_MONOTONIC ns of the wake
+ */
+uint64_t xDRM_Wait_Pacer_Interval(struct frame_pacer *pacer);
+
+#ifdef __cplusplus
+}
+#endif
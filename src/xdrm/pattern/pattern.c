@@ -1,84 +1,348 @@
 #include "pattern.h"
 
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
 // clang-format off
-void xDRM_Pattern_Color(uint32_t *argb_data, int width, int height, int frame_count) 
+struct pattern_job
+{
+    uint8_t *dst;
+    uint32_t stride;
+    int width;
+    int height;
+    enum xdrm_pattern pattern;
+    int frame_count;
+};
+
+static struct
+{
+    // one fill at a time, owns scratch rows
+    pthread_mutex_t lock;
+    // hands a job to workers
+    pthread_mutex_t work_lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    pthread_t workers[XDRM_PATTERN_THREAD_MAX];
+    // cached row per thread, slot 0 is the caller
+    uint32_t *rows[XDRM_PATTERN_THREAD_MAX];
+    int row_size;
+    int started;
+    int threads;
+
+    struct pattern_job job;
+    int active;
+    int remaining;
+    uint64_t gen;
+} pattern_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_lock = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .started = 1,
+    .threads = 1,
+};
+
+static const uint32_t pattern_bar_colors[8] = {
+    0xFFFFFFFF, 0xFFFFFF00, 0xFF00FFFF, 0xFF00FF00, 0xFFFF00FF, 0xFFFF0000, 0xFF0000FF, 0xFF000000,
+};
+
+// repeat the first period pixels of row up to width
+static void pattern_repeat(uint32_t *row, int period, int width)
 {
-    int offset = frame_count * 4;
+    for (int n = period; n < width; n *= 2)
+        memcpy(row + n, row, (size_t)(n * 2 <= width ? n : width - n) * 4);
+}
+
+// stream one cached row to rows [y0, y1) of job
+static void pattern_emit(const struct pattern_job *job, const uint32_t *row, int y0, int y1)
+{
+    if (y1 > y0)
+        xDRM_Copy(job->dst + (size_t)y0 * job->stride, job->stride, (const uint8_t *)row, 0, job->width * 4, y1 - y0);
+}
 
-    for(int y = 0; y < height; y++) 
+static void pattern_color_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
+{
+    uint32_t offset = (uint32_t)job->frame_count * 4;
+    int period = job->width < 256 ? job->width : 256;
+
+    // channels wrap at 256, so a row is periodic in x
+    for (int y = y0; y < y1; y++)
     {
-        for(int x = 0; x < width; x++) 
-        {
-            uint8_t r = (x + offset) & 0xFF;
-            uint8_t g = (y + offset) & 0xFF;
-            uint8_t b = (x + y + offset) & 0xFF;
+        uint32_t g = ((y + offset) & 0xFF) << 8;
 
-            argb_data[y * width + x] = (0xFF << 24) | (r << 16) | (g << 8) | b;
-        }
+        for (uint32_t x = 0; x < (uint32_t)period; x++)
+            row[x] = 0xFF000000u | (((x + offset) & 0xFF) << 16) | g | ((x + y + offset) & 0xFF);
+
+        pattern_repeat(row, period, job->width);
+        pattern_emit(job, row, y, y + 1);
     }
 }
 
-void xDRM_Pattern_Bar(uint32_t *argb_data, int width, int height, int frame_count)
+static void pattern_bar_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
+{
+    uint32_t bar_width = job->width >= 8 ? job->width / 8 : 1;
+    uint32_t offset = (uint32_t)job->frame_count * 8;
+
+    // every row is the same
+    for (uint32_t x = 0; x < (uint32_t)job->width; x++)
+        row[x] = pattern_bar_colors[((x + offset) / bar_width) % 8];
+
+    pattern_emit(job, row, y0, y1);
+}
+
+static void pattern_checkerboard_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
 {
-    int bar_width = width / 8;
-    int offset = frame_count * 8;
+    const uint32_t square_size = 64;
+    uint32_t offset = (uint32_t)job->frame_count * 4;
+    uint32_t *odd = row + job->width;
+    int y = y0;
 
-    for(int y = 0; y < height; y++)
+    // two rows, bands of square_size rows alternate between them
+    for (uint32_t x = 0; x < (uint32_t)job->width; x++)
     {
-        for(int x = 0; x < width; x++)
-        {
-            int bar = ((x + offset) / bar_width) % 8;
-            uint32_t color;
-
-            switch(bar)
-            {
-                case 0: color = 0xFFFFFFFF; break;
-                case 1: color = 0xFFFFFF00; break;
-                case 2: color = 0xFF00FFFF; break;
-                case 3: color = 0xFF00FF00; break;
-                case 4: color = 0xFFFF00FF; break;
-                case 5: color = 0xFFFF0000; break;
-                case 6: color = 0xFF0000FF; break;
-                case 7: color = 0xFF000000; break;
-            }
-
-            argb_data[y * width + x] = color;
-        }
+        row[x] = (((x + offset) / square_size) & 1) ? 0xFFFFFFFF : 0xFF000000;
+        odd[x] = row[x] ^ 0x00FFFFFF;
+    }
+
+    while (y < y1)
+    {
+        uint32_t band = (y + offset) / square_size;
+        int end = (int)((band + 1) * square_size - offset);
+
+        if (end > y1)
+            end = y1;
+
+        pattern_emit(job, (band & 1) ? odd : row, y, end);
+        y = end;
     }
 }
 
-void xDRM_Pattern_Checkerboard(uint32_t *argb_data, int width, int height, int frame_count)
+static void pattern_barcode_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
 {
-    int square_size = 64;
-    int offset = frame_count * 4;
+    uint32_t code = (uint32_t)job->frame_count ^ ((uint32_t)job->frame_count >> 1);
+    int bar_width = job->width >= 34 ? job->width / 34 : 1;
 
-    for(int y = 0; y < height; y++)
+    // guard, 32 bits MSB first, guard, black after the last bar
+    for (int x = 0; x < job->width; x++)
     {
-        for(int x = 0; x < width; x++)
-        {
-            int px = (x + offset) / square_size;
-            int py = (y + offset) / square_size;
-            
-            uint32_t color = ((px + py) & 1) ? 0xFFFFFFFF : 0xFF000000;
-            argb_data[y * width + x] = color;
-        }
+        int bar = x / bar_width;
+        bool white;
+
+        if (bar == 0 || bar == 33)
+            white = true;
+        else if (bar < 33)
+            white = (code >> (32 - bar)) & 1;
+        else
+            white = false;
+
+        row[x] = white ? 0xFFFFFFFF : 0xFF000000;
     }
+
+    pattern_emit(job, row, y0, y1);
 }
 
-void xDRM_Pattern(uint32_t *argb_data, int width, int height, int framecount)
+static void pattern_flash_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
 {
+    uint32_t background = job->frame_count % XDRM_PATTERN_FLASH_PERIOD == 0 ? 0xFFFFFFFF : 0xFF000000;
+    uint32_t marker = (job->frame_count & 1) ? 0xFFFFFFFF : 0xFF000000;
+    int size = (job->width < job->height ? job->width : job->height) / 8;
+    uint32_t *top = row + job->width;
+
+    if (size < 1)
+        size = 1;
+
+    // marker square at top left, a dropped or repeated frame breaks its toggling
+    for (int x = 0; x < job->width; x++)
+    {
+        row[x] = background;
+        top[x] = x < size ? marker : background;
+    }
+
+    pattern_emit(job, top, y0, y1 < size ? y1 : size);
+    pattern_emit(job, row, y0 > size ? y0 : size, y1);
+}
+
+static void pattern_rows(const struct pattern_job *job, int y0, int y1, uint32_t *row)
+{
+    enum xdrm_pattern pattern = job->pattern;
+
     // change pattern per 60 frames
-    switch((framecount / 60) % 3)
+    if (pattern == XDRM_PATTERN_CYCLE)
+        pattern = (enum xdrm_pattern)((job->frame_count / 60) % 3);
+
+    switch(pattern)
     {
-        case 0:
-            xDRM_Pattern_Color(argb_data, width, height, framecount);
-            break;
-        case 1:
-            xDRM_Pattern_Bar(argb_data, width, height, framecount);
-            break;
-        case 2:
-            xDRM_Pattern_Checkerboard(argb_data, width, height, framecount);
+        case XDRM_PATTERN_COLOR:        pattern_color_rows(job, y0, y1, row); break;
+        case XDRM_PATTERN_BAR:          pattern_bar_rows(job, y0, y1, row); break;
+        case XDRM_PATTERN_CHECKERBOARD: pattern_checkerboard_rows(job, y0, y1, row); break;
+        case XDRM_PATTERN_BARCODE:      pattern_barcode_rows(job, y0, y1, row); break;
+        case XDRM_PATTERN_FLASH:        pattern_flash_rows(job, y0, y1, row); break;
+        default: break;
+    }
+}
+
+static void pattern_slice(const struct pattern_job *job, int slot, int threads, uint32_t *row)
+{
+    int y0 = (int)((int64_t)job->height * slot / threads);
+    int y1 = (int)((int64_t)job->height * (slot + 1) / threads);
+
+    pattern_rows(job, y0, y1, row);
+}
+
+static void *pattern_worker(void *arg)
+{
+    int slot = (int)(intptr_t)arg;
+    uint64_t seen;
+
+    pthread_mutex_lock(&pattern_pool.work_lock);
+    seen = pattern_pool.gen;
+
+    for (;;)
+    {
+        struct pattern_job job;
+        int active;
+
+        while (pattern_pool.gen == seen)
+            pthread_cond_wait(&pattern_pool.start, &pattern_pool.work_lock);
+        seen = pattern_pool.gen;
+
+        if (slot >= pattern_pool.active)
+            continue;
+
+        job = pattern_pool.job;
+        active = pattern_pool.active;
+        pthread_mutex_unlock(&pattern_pool.work_lock);
+
+        pattern_slice(&job, slot, active, pattern_pool.rows[slot]);
+
+        pthread_mutex_lock(&pattern_pool.work_lock);
+        if (--pattern_pool.remaining == 0)
+            pthread_cond_signal(&pattern_pool.done);
+    }
+
+    return NULL;
+}
+
+int xDRM_Pattern_Set_Threads(int threads)
+{
+    int ret = 0;
+
+    if (threads < 1 || threads > XDRM_PATTERN_THREAD_MAX)
+        return -EINVAL;
+
+    pthread_mutex_lock(&pattern_pool.lock);
+
+    // workers only wait on start, a started worker beyond threads stays idle
+    while (pattern_pool.started < threads)
+    {
+        int slot = pattern_pool.started;
+
+        ret = -pthread_create(&pattern_pool.workers[slot], NULL, pattern_worker, (void *)(intptr_t)slot);
+        if (ret)
             break;
+
+        pthread_detach(pattern_pool.workers[slot]);
+        pattern_pool.started++;
     }
+
+    pattern_pool.threads = pattern_pool.started < threads ? pattern_pool.started : threads;
+    pthread_mutex_unlock(&pattern_pool.lock);
+
+    return ret;
+}
+
+void xDRM_Pattern_Fill(uint8_t *dst, uint32_t stride, int width, int height, enum xdrm_pattern pattern, int frame_count)
+{
+    struct pattern_job job = {dst, stride, width, height, pattern, frame_count};
+    int threads, size;
+
+    if (!dst || width <= 0 || height <= 0 || stride < (uint32_t)width * 4 || pattern >= XDRM_PATTERN_NUM)
+        return;
+
+    pthread_mutex_lock(&pattern_pool.lock);
+
+    // Step 1 : scratch of two rows per thread, kept for next fill
+    threads = pattern_pool.threads < height ? pattern_pool.threads : height;
+    size = pattern_pool.row_size < width ? width : pattern_pool.row_size;
+    if (pattern_pool.row_size < width)
+    {
+        for (int i = 0; i < XDRM_PATTERN_THREAD_MAX; i++)
+        {
+            free(pattern_pool.rows[i]);
+            pattern_pool.rows[i] = NULL;
+        }
+        pattern_pool.row_size = 0;
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        if (!pattern_pool.rows[i])
+            pattern_pool.rows[i] = (uint32_t *)malloc((size_t)size * 2 * 4);
+        if (!pattern_pool.rows[i])
+        {
+            fprintf(stderr, "Pattern: no memory for %d rows\n", threads);
+            pthread_mutex_unlock(&pattern_pool.lock);
+            return;
+        }
+    }
+    pattern_pool.row_size = size;
+
+    // Step 2 : caller takes slice 0, workers the rest
+    if (threads <= 1)
+    {
+        pattern_rows(&job, 0, height, pattern_pool.rows[0]);
+    }
+    else
+    {
+        pthread_mutex_lock(&pattern_pool.work_lock);
+        pattern_pool.job = job;
+        pattern_pool.active = threads;
+        pattern_pool.remaining = threads - 1;
+        pattern_pool.gen++;
+        pthread_cond_broadcast(&pattern_pool.start);
+        pthread_mutex_unlock(&pattern_pool.work_lock);
+
+        pattern_slice(&job, 0, threads, pattern_pool.rows[0]);
+
+        pthread_mutex_lock(&pattern_pool.work_lock);
+        while (pattern_pool.remaining)
+            pthread_cond_wait(&pattern_pool.done, &pattern_pool.work_lock);
+        pthread_mutex_unlock(&pattern_pool.work_lock);
+    }
+
+    pthread_mutex_unlock(&pattern_pool.lock);
+}
+
+void xDRM_Pattern_Color(uint32_t *argb_data, int width, int height, int frame_count)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_COLOR, frame_count);
+}
+
+void xDRM_Pattern_Bar(uint32_t *argb_data, int width, int height, int frame_count)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_BAR, frame_count);
+}
+
+void xDRM_Pattern_Checkerboard(uint32_t *argb_data, int width, int height, int frame_count)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_CHECKERBOARD, frame_count);
+}
+
+void xDRM_Pattern_Barcode(uint32_t *argb_data, int width, int height, int frame_count)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_BARCODE, frame_count);
+}
+
+void xDRM_Pattern_Flash(uint32_t *argb_data, int width, int height, int frame_count)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_FLASH, frame_count);
+}
+
+void xDRM_Pattern(uint32_t *argb_data, int width, int height, int framecount)
+{
+    xDRM_Pattern_Fill((uint8_t *)argb_data, width * 4, width, height, XDRM_PATTERN_CYCLE, framecount);
 }
-// clang-format on
\ No newline at end of file
+// clang-format on
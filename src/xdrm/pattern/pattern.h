@@ -3,19 +3,66 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "../conf/debug.h"
+#include "../copy/copy.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// rows are split across at most this many threads, caller included
+#define XDRM_PATTERN_THREAD_MAX 8
+
+// full frame flash once per period, see XDRM_PATTERN_FLASH
+#define XDRM_PATTERN_FLASH_PERIOD 60
+
+enum xdrm_pattern
+{
+    XDRM_PATTERN_COLOR = 0,
+    XDRM_PATTERN_BAR,
+    XDRM_PATTERN_CHECKERBOARD,
+    // frame_count as 32bit Gray code, MSB left, one bar per bit between two white guard bars
+    XDRM_PATTERN_BARCODE,
+    // black, white for one frame per XDRM_PATTERN_FLASH_PERIOD, corner marker toggles every frame
+    XDRM_PATTERN_FLASH,
+    // COLOR, BAR and CHECKERBOARD in turn, 60 frames each
+    XDRM_PATTERN_CYCLE,
+    XDRM_PATTERN_NUM,
+};
+
+/**
+ * @brief Fill an ARGB8888 image with a test pattern.
+ * @note Rows are built once into a cached row and written by xDRM_Copy with streaming stores,
+ *       so dst can be a mapped dumb buffer. Rows are split across xDRM_Pattern_Set_Threads threads.
+ *
+ * @param dst destination, height rows of stride bytes
+ * @param stride bytes per row, at least width * 4
+ * @param width image width (by pixel)
+ * @param height image height (by pixel)
+ * @param pattern enum xdrm_pattern
+ * @param frame_count moves the pattern, value of the barcode
+ */
+void xDRM_Pattern_Fill(uint8_t *dst, uint32_t stride, int width, int height, enum xdrm_pattern pattern, int frame_count);
+
+/**
+ * @brief Number of threads xDRM_Pattern_Fill uses, workers are started on first need and kept.
+ *
+ * @param threads 1 ~ XDRM_PATTERN_THREAD_MAX, 1 fills on the calling thread only
+ * @return 0 on success, -EINVAL on invalid param, others when a worker cannot start.
+ */
+int xDRM_Pattern_Set_Threads(int threads);
+
 void xDRM_Pattern_Color(uint32_t *argb_data, int width, int height, int frame_count);
 
 void xDRM_Pattern_Bar(uint32_t *argb_data, int width, int height, int frame_count);
 
 void xDRM_Pattern_Checkerboard(uint32_t *argb_data, int width, int height, int frame_count);
 
+void xDRM_Pattern_Barcode(uint32_t *argb_data, int width, int height, int frame_count);
+
+void xDRM_Pattern_Flash(uint32_t *argb_data, int width, int height, int frame_count);
+
 void xDRM_Pattern(uint32_t *argb_data, int width, int height, int framecount);
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,80 @@
+#include "rt.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+static int rt_set_affinity(uint64_t cpus)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < XDRM_RT_CPU_MAX; cpu++)
+    {
+        if (cpus & (1ull << cpu))
+            CPU_SET(cpu, &set);
+    }
+
+    return -pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static int rt_set_priority(int priority)
+{
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+
+    return -pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+int xDRM_RT_Apply(const struct xdrm_rt_config *config)
+{
+    int ret = 0, err;
+
+    if (!config || config->priority < 0 || config->priority > sched_get_priority_max(SCHED_FIFO))
+        return -EINVAL;
+
+    // Step 1 : pin before raising priority, a FIFO thread never waits on a busy little core
+    if (config->cpus)
+    {
+        err = rt_set_affinity(config->cpus);
+        if (err)
+            fprintf(stderr, "RT affinity 0x%llx failed: %s\n", (unsigned long long)config->cpus, strerror(-err));
+        ret = ret ? ret : err;
+    }
+
+    // Step 2 : priority
+    if (config->priority)
+    {
+        err = rt_set_priority(config->priority);
+        if (err)
+            fprintf(stderr, "RT SCHED_FIFO %d failed: %s\n", config->priority, strerror(-err));
+        ret = ret ? ret : err;
+    }
+
+    // Step 3 : memory, MCL_CURRENT faults every mapped page in now
+    if (config->lock_memory)
+    {
+        err = mlockall(MCL_CURRENT | MCL_FUTURE) ? -errno : 0;
+        if (err)
+            fprintf(stderr, "RT mlockall failed: %s\n", strerror(-err));
+        ret = ret ? ret : err;
+    }
+
+#if __ENABLE_DEBUG_LOG__
+    if (!ret)
+        printf("RT thread: priority %d, cpus 0x%llx%s\n", config->priority,
+               (unsigned long long)config->cpus, config->lock_memory ? ", memory locked" : "");
+#endif
+
+    return ret;
+}
+
+int xDRM_RT_Lock(const void *addr, size_t size)
+{
+    if (!addr || !size)
+        return -EINVAL;
+
+    return mlock(addr, size) ? -errno : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CPUs a mask can name, bit n is CPU n
+#define XDRM_RT_CPU_MAX 64
+
+struct xdrm_rt_config
+{
+    // SCHED_FIFO priority 1 ~ 99, 0 keeps the thread on the normal scheduler
+    int priority;
+    // CPUs the thread may run on, 0 keeps its affinity
+    uint64_t cpus;
+    // lock every page of the process, current and future, so no page fault lands on the flip path
+    bool lock_memory;
+};
+
+/**
+ * @brief Apply config to the calling thread.
+ * @note Threads created afterwards inherit priority and affinity, e.g. workers of xDRM_Pattern_Set_Threads.
+ *       Each part is tried even when one before failed, needs CAP_SYS_NICE and CAP_IPC_LOCK or matching rlimits.
+ *
+ * @return 0 on success, -EINVAL on invalid param, otherwise -errno of the first part which failed.
+ */
+int xDRM_RT_Apply(const struct xdrm_rt_config *config);
+
+/**
+ * @brief Lock and fault in size bytes from addr, for memory allocated before a failed xDRM_RT_Apply lock.
+ *
+ * @return 0 on success, -errno on failure.
+ */
+int xDRM_RT_Lock(const void *addr, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
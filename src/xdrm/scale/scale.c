@@ -0,0 +1,179 @@
+#include "scale.h"
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static void scale_row_scalar(uint8_t *dst, const uint8_t *src, const uint32_t *xmap, uint32_t width, uint32_t cpp)
+{
+    switch (cpp)
+    {
+        case 1:
+            for (uint32_t x = 0; x < width; x++)
+                dst[x] = src[xmap[x]];
+            break;
+        case 2:
+            for (uint32_t x = 0; x < width; x++)
+                memcpy(dst + x * 2, src + xmap[x], 2);
+            break;
+        case 4:
+            for (uint32_t x = 0; x < width; x++)
+                memcpy(dst + x * 4, src + xmap[x], 4);
+            break;
+        default:
+            for (uint32_t x = 0; x < width; x++)
+                memcpy(dst + x * cpp, src + xmap[x], cpp);
+            break;
+    }
+}
+
+#if defined(__aarch64__)
+/**
+ * @brief Exact 2x of 32bit pixels, VST2 writes every pixel twice.
+ */
+static void scale_row_neon_2x(uint8_t *dst, const uint8_t *src, uint32_t width)
+{
+    const uint32_t *s = (const uint32_t *)src;
+    uint32_t *d = (uint32_t *)dst;
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8)
+    {
+        uint32x4_t v = vld1q_u32(s + x / 2);
+        uint32x4x2_t pair = {{v, v}};
+
+        vst2q_u32(d + x, pair);
+    }
+
+    for (; x < width; x++)
+        d[x] = s[x / 2];
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void scale_row_avx2(uint8_t *dst, const uint8_t *src, const uint32_t *xmap, uint32_t width)
+{
+    uint32_t x = 0;
+
+    // 8 pixels per gather, xmap holds byte offsets
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i index = _mm256_loadu_si256((const __m256i *)(xmap + x));
+        __m256i v = _mm256_i32gather_epi32((const int *)src, index, 1);
+
+        _mm256_storeu_si256((__m256i *)(dst + x * 4), v);
+    }
+
+    for (; x < width; x++)
+        memcpy(dst + x * 4, src + xmap[x], 4);
+
+    _mm256_zeroupper();
+}
+#endif
+
+static void scale_row(uint8_t *dst, const uint8_t *src, const uint32_t *xmap, uint32_t dst_width, uint32_t src_width, uint32_t cpp)
+{
+#if defined(__aarch64__)
+    if (cpp == 4 && dst_width == src_width * 2)
+    {
+        scale_row_neon_2x(dst, src, dst_width);
+        return;
+    }
+#elif defined(__x86_64__) || defined(__i386__)
+    if (cpp == 4 && __builtin_cpu_supports("avx2"))
+    {
+        scale_row_avx2(dst, src, xmap, dst_width);
+        return;
+    }
+#endif
+
+    (void)src_width;
+    scale_row_scalar(dst, src, xmap, dst_width, cpp);
+}
+
+int xDRM_Scale_Scratch_Alloc(struct xdrm_scale_scratch *scratch, uint32_t max_width)
+{
+    if (!scratch || !max_width)
+        return -EINVAL;
+
+    memset(scratch, 0, sizeof(*scratch));
+    scratch->xmap = (uint32_t *)malloc(max_width * sizeof(uint32_t));
+    scratch->row = (uint8_t *)malloc(max_width * 4);
+    if (!scratch->xmap || !scratch->row)
+    {
+        xDRM_Scale_Scratch_Free(scratch);
+        return -ENOMEM;
+    }
+
+    scratch->max_width = max_width;
+
+    return 0;
+}
+
+void xDRM_Scale_Scratch_Free(struct xdrm_scale_scratch *scratch)
+{
+    if (!scratch)
+        return;
+
+    free(scratch->xmap);
+    free(scratch->row);
+    memset(scratch, 0, sizeof(*scratch));
+}
+
+int xDRM_Scale(uint8_t *dst, uint32_t dst_stride, uint32_t dst_width, uint32_t dst_height,
+               const uint8_t *src, uint32_t src_stride, uint32_t src_width, uint32_t src_height, uint32_t cpp,
+               struct xdrm_scale_scratch *scratch)
+{
+    struct xdrm_scale_scratch local, *use = scratch;
+    uint32_t y = 0;
+    int ret;
+
+    if (!dst || !src || !dst_width || !dst_height || !src_width || !src_height || !cpp || cpp > 4)
+        return -EINVAL;
+
+    // Step 1 : scratch of caller, or one for this call only
+    if (!scratch)
+    {
+        ret = xDRM_Scale_Scratch_Alloc(&local, dst_width);
+        if (ret)
+            return ret;
+        use = &local;
+    }
+    else if (dst_width > scratch->max_width)
+    {
+        return -ERANGE;
+    }
+
+    // Step 2 : source byte offset of every destination unit, sampled at unit centre, kept while sizes stay
+    if (use->dst_width != dst_width || use->src_width != src_width || use->cpp != cpp)
+    {
+        for (uint32_t x = 0; x < dst_width; x++)
+            use->xmap[x] = (uint32_t)(((2ull * x + 1) * src_width) / (2ull * dst_width)) * cpp;
+
+        use->dst_width = dst_width;
+        use->src_width = src_width;
+        use->cpp = cpp;
+    }
+
+    // Step 3 : scale each source row once, then stream it to every destination row it covers
+    while (y < dst_height)
+    {
+        uint32_t sy = (uint32_t)(((2ull * y + 1) * src_height) / (2ull * dst_height));
+        uint32_t rows = 1;
+
+        while (y + rows < dst_height && ((2ull * (y + rows) + 1) * src_height) / (2ull * dst_height) == sy)
+            rows++;
+
+        scale_row(use->row, src + (size_t)sy * src_stride, use->xmap, dst_width, src_width, cpp);
+        xDRM_Copy(dst + (size_t)y * dst_stride, dst_stride, use->row, 0, dst_width * cpp, rows);
+        y += rows;
+    }
+
+    if (!scratch)
+        xDRM_Scale_Scratch_Free(&local);
+
+    return 0;
+}
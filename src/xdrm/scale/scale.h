@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include "../copy/copy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Row scratch of xDRM_Scale, allocated once so scaling on the display thread does no heap allocation.
+ * The column map is kept for the last sizes scaled, one scratch per plane keeps it from being rebuilt.
+ */
+struct xdrm_scale_scratch
+{
+    // source byte offset of each destination unit
+    uint32_t *xmap;
+    // one scaled row, 4 bytes per unit
+    uint8_t *row;
+    // destination units the buffers hold
+    uint32_t max_width;
+    // sizes xmap was built for, 0 when not built
+    uint32_t dst_width;
+    uint32_t src_width;
+    uint32_t cpp;
+};
+
+/**
+ * @brief Allocate scratch for destination rows up to max_width units of up to 4 bytes.
+ *
+ * @return 0 on success, -EINVAL on invalid param, -ENOMEM.
+ */
+int xDRM_Scale_Scratch_Alloc(struct xdrm_scale_scratch *scratch, uint32_t max_width);
+
+void xDRM_Scale_Scratch_Free(struct xdrm_scale_scratch *scratch);
+
+/**
+ * @brief Nearest neighbour scale of one plane, CPU fallback when the display plane cannot scale.
+ * @note Each source row is scaled once into a cached row, repeated rows are written by xDRM_Copy
+ *       with streaming stores, so the write-combined destination is never read.
+ *
+ * @param dst destination, dst_height rows of dst_stride bytes
+ * @param dst_stride bytes per destination row
+ * @param dst_width destination width in units of cpp bytes
+ * @param dst_height destination rows
+ * @param src source, src_height rows of src_stride bytes
+ * @param src_stride bytes per source row
+ * @param src_width source width in units of cpp bytes
+ * @param src_height source rows
+ * @param cpp bytes per unit, a pixel or a YUYV macropixel, 1 ~ 4
+ * @param scratch from xDRM_Scale_Scratch_Alloc, NULL to allocate one for this call
+ * @return 0 on success, -EINVAL on invalid param, -ENOMEM, -ERANGE when dst_width exceeds scratch.
+ */
+int xDRM_Scale(uint8_t *dst, uint32_t dst_stride, uint32_t dst_width, uint32_t dst_height,
+               const uint8_t *src, uint32_t src_stride, uint32_t src_width, uint32_t src_height, uint32_t cpp,
+               struct xdrm_scale_scratch *scratch);
+
+#ifdef __cplusplus
+}
+#endif
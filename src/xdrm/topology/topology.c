@@ -0,0 +1,401 @@
+#include "topology.h"
+
+// kernel connector names by DRM_MODE_CONNECTOR_* value
+static const char *topology_connector_names[] = {
+    "Unknown", "VGA", "DVI-I", "DVI-D", "DVI-A", "Composite", "SVIDEO", "LVDS", "Component",
+    "DIN", "DP", "HDMI-A", "HDMI-B", "TV", "eDP", "Virtual", "DSI", "DPI", "Writeback", "SPI", "USB",
+};
+
+/**
+ * @brief Property info of id, fetched on first request and shared afterwards.
+ */
+static drmModePropertyRes *topology_get_property(int fd, struct xdrm_topology *topology, uint32_t id)
+{
+    drmModePropertyRes **grown;
+    drmModePropertyRes *property;
+
+    for (uint32_t i = 0; i < topology->property_count; i++)
+    {
+        if (topology->properties[i]->prop_id == id)
+            return topology->properties[i];
+    }
+
+    property = xdrm_backend->get_property(fd, id);
+    if (!property)
+        return NULL;
+
+    if (topology->property_count == topology->property_size)
+    {
+        grown = (drmModePropertyRes **)realloc(topology->properties,
+                                               (topology->property_size + 64) * sizeof(*topology->properties));
+        if (!grown)
+        {
+            xdrm_backend->free_property(property);
+            return NULL;
+        }
+        topology->properties = grown;
+        topology->property_size += 64;
+    }
+
+    topology->properties[topology->property_count++] = property;
+    return property;
+}
+
+static int topology_get_props(int fd, struct xdrm_topology *topology, struct xdrm_topology_props *props, uint32_t id, uint32_t type)
+{
+    props->values = xdrm_backend->get_object_properties(fd, id, type);
+    if (!props->values)
+    {
+        fprintf(stderr, "Cannot get properties of object %u\n", id);
+        return -errno ? -errno : -EINVAL;
+    }
+
+    props->info = (drmModePropertyRes **)calloc(props->values->count_props ? props->values->count_props : 1, sizeof(*props->info));
+    if (!props->info)
+        return -ENOMEM;
+
+    for (uint32_t i = 0; i < props->values->count_props; i++)
+        props->info[i] = topology_get_property(fd, topology, props->values->props[i]);
+
+    return 0;
+}
+
+static void topology_free_props(struct xdrm_topology_props *props)
+{
+    free(props->info);
+    if (props->values)
+        xdrm_backend->free_object_properties(props->values);
+    props->info = NULL;
+    props->values = NULL;
+}
+
+/**
+ * @brief Type of plane from its immutable type enum, overlay when it has none.
+ */
+static enum xdrm_plane_type topology_plane_type(const struct xdrm_topology_props *props)
+{
+    const drmModePropertyRes *info;
+    uint64_t value;
+
+    for (uint32_t i = 0; props->values && i < props->values->count_props; i++)
+    {
+        info = props->info[i];
+        if (!info || strcmp(info->name, "type"))
+            continue;
+
+        value = props->values->prop_values[i];
+        for (int e = 0; e < info->count_enums; e++)
+        {
+            if (info->enums[e].value != value)
+                continue;
+            if (!strcmp(info->enums[e].name, "Primary"))
+                return XDRM_PLANE_PRIMARY;
+            if (!strcmp(info->enums[e].name, "Cursor"))
+                return XDRM_PLANE_CURSOR;
+            return XDRM_PLANE_OVERLAY;
+        }
+
+        // enum without names, values are the uapi ones
+        if (value == DRM_PLANE_TYPE_PRIMARY)
+            return XDRM_PLANE_PRIMARY;
+        if (value == DRM_PLANE_TYPE_CURSOR)
+            return XDRM_PLANE_CURSOR;
+    }
+
+    return XDRM_PLANE_OVERLAY;
+}
+
+/**
+ * @brief Fill name, reachable CRTCs and current CRTC of a connector from encoders taken before.
+ */
+static void topology_link_connector(struct xdrm_topology *topology, struct xdrm_topology_connector *connector)
+{
+    drmModeConnectorPtr conn = connector->connector;
+    uint32_t type = conn->connector_type;
+
+    snprintf(connector->name, sizeof(connector->name), "%s-%u",
+             type < sizeof(topology_connector_names) / sizeof(topology_connector_names[0]) ? topology_connector_names[type] : "Unknown",
+             conn->connector_type_id);
+
+    for (uint32_t e = 0; e < topology->encoder_count; e++)
+    {
+        drmModeEncoderPtr encoder = topology->encoders[e];
+
+        for (int i = 0; i < conn->count_encoders; i++)
+        {
+            if (conn->encoders[i] == encoder->encoder_id)
+                connector->possible_crtcs |= encoder->possible_crtcs;
+        }
+
+        if (conn->encoder_id == encoder->encoder_id)
+            connector->crtc_id = encoder->crtc_id;
+    }
+}
+
+struct xdrm_topology *xDRM_Topology_Create(int fd)
+{
+    struct xdrm_topology *topology;
+    drmModeResPtr resources;
+    drmModePlaneResPtr plane_resources = NULL;
+    int ret = 0;
+
+    topology = (struct xdrm_topology *)calloc(1, sizeof(*topology));
+    if (!topology)
+        return NULL;
+
+    resources = xdrm_backend->get_resources(fd);
+    if (!resources)
+    {
+        fprintf(stderr, "Cannot get DRM resources\n");
+        free(topology);
+        return NULL;
+    }
+
+    // Step 1 : CRTCs, their order gives the bits of possible_crtcs
+    for (int i = 0; i < resources->count_crtcs && i < XDRM_TOPOLOGY_OBJECT_MAX && !ret; i++)
+    {
+        topology->crtcs[i].id = resources->crtcs[i];
+        ret = topology_get_props(fd, topology, &topology->crtcs[i].props, resources->crtcs[i], DRM_MODE_OBJECT_CRTC);
+        topology->crtc_count++;
+    }
+
+    // Step 2 : encoders, before connectors which are linked through them
+    for (int i = 0; i < resources->count_encoders && topology->encoder_count < XDRM_TOPOLOGY_OBJECT_MAX && !ret; i++)
+    {
+        drmModeEncoderPtr encoder = xdrm_backend->get_encoder(fd, resources->encoders[i]);
+
+        if (encoder)
+            topology->encoders[topology->encoder_count++] = encoder;
+    }
+
+    // Step 3 : connectors
+    for (int i = 0; i < resources->count_connectors && topology->connector_count < XDRM_TOPOLOGY_OBJECT_MAX && !ret; i++)
+    {
+        struct xdrm_topology_connector *connector = &topology->connectors[topology->connector_count];
+
+        connector->connector = xdrm_backend->get_connector(fd, resources->connectors[i]);
+        if (!connector->connector)
+            continue;
+        topology->connector_count++;
+
+        topology_link_connector(topology, connector);
+        ret = topology_get_props(fd, topology, &connector->props, connector->connector->connector_id, DRM_MODE_OBJECT_CONNECTOR);
+    }
+
+    xdrm_backend->free_resources(resources);
+
+    // Step 4 : planes
+    if (!ret)
+    {
+        plane_resources = xdrm_backend->get_plane_resources(fd);
+        if (!plane_resources)
+        {
+            fprintf(stderr, "Cannot get plane resources\n");
+            ret = -EINVAL;
+        }
+    }
+
+    for (uint32_t i = 0; plane_resources && i < plane_resources->count_planes && topology->plane_count < XDRM_TOPOLOGY_OBJECT_MAX && !ret; i++)
+    {
+        struct xdrm_topology_plane *plane = &topology->planes[topology->plane_count];
+
+        plane->plane = xdrm_backend->get_plane(fd, plane_resources->planes[i]);
+        if (!plane->plane)
+            continue;
+        topology->plane_count++;
+
+        ret = topology_get_props(fd, topology, &plane->props, plane->plane->plane_id, DRM_MODE_OBJECT_PLANE);
+        plane->type = topology_plane_type(&plane->props);
+    }
+
+    if (plane_resources)
+        xdrm_backend->free_plane_resources(plane_resources);
+
+    if (ret)
+    {
+        xDRM_Topology_Free(topology);
+        errno = -ret;
+        return NULL;
+    }
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Topology: %u connectors, %u encoders, %u CRTCs, %u planes, %u properties\n", topology->connector_count,
+           topology->encoder_count, topology->crtc_count, topology->plane_count, topology->property_count);
+#endif
+
+    return topology;
+}
+
+void xDRM_Topology_Free(struct xdrm_topology *topology)
+{
+    if (!topology)
+        return;
+
+    for (uint32_t i = 0; i < topology->crtc_count; i++)
+        topology_free_props(&topology->crtcs[i].props);
+
+    for (uint32_t i = 0; i < topology->encoder_count; i++)
+        xdrm_backend->free_encoder(topology->encoders[i]);
+
+    for (uint32_t i = 0; i < topology->connector_count; i++)
+    {
+        topology_free_props(&topology->connectors[i].props);
+        xdrm_backend->free_connector(topology->connectors[i].connector);
+    }
+
+    for (uint32_t i = 0; i < topology->plane_count; i++)
+    {
+        topology_free_props(&topology->planes[i].props);
+        xdrm_backend->free_plane(topology->planes[i].plane);
+    }
+
+    for (uint32_t i = 0; i < topology->property_count; i++)
+        xdrm_backend->free_property(topology->properties[i]);
+
+    free(topology->properties);
+    free(topology);
+}
+
+const struct xdrm_topology_connector *xDRM_Topology_Get_Connector(const struct xdrm_topology *topology, uint32_t id)
+{
+    for (uint32_t i = 0; i < topology->connector_count; i++)
+    {
+        if (topology->connectors[i].connector->connector_id == id)
+            return &topology->connectors[i];
+    }
+
+    return NULL;
+}
+
+const struct xdrm_topology_connector *xDRM_Topology_Find_Connector(const struct xdrm_topology *topology, const char *name)
+{
+    for (uint32_t i = 0; name && i < topology->connector_count; i++)
+    {
+        if (!strcmp(topology->connectors[i].name, name))
+            return &topology->connectors[i];
+    }
+
+    return NULL;
+}
+
+const struct xdrm_topology_plane *xDRM_Topology_Get_Plane(const struct xdrm_topology *topology, uint32_t id)
+{
+    for (uint32_t i = 0; i < topology->plane_count; i++)
+    {
+        if (topology->planes[i].plane->plane_id == id)
+            return &topology->planes[i];
+    }
+
+    return NULL;
+}
+
+int xDRM_Topology_Crtc_Index(const struct xdrm_topology *topology, uint32_t crtc_id)
+{
+    for (uint32_t i = 0; i < topology->crtc_count; i++)
+    {
+        if (topology->crtcs[i].id == crtc_id)
+            return (int)i;
+    }
+
+    return -1;
+}
+
+const struct xdrm_topology_props *xDRM_Topology_Get_Crtc_Props(const struct xdrm_topology *topology, uint32_t crtc_id)
+{
+    int index = xDRM_Topology_Crtc_Index(topology, crtc_id);
+
+    return index < 0 ? NULL : &topology->crtcs[index].props;
+}
+
+bool xDRM_Topology_Plane_Has_Format(const struct xdrm_topology *topology, uint32_t plane_id, uint32_t format)
+{
+    const struct xdrm_topology_plane *plane = xDRM_Topology_Get_Plane(topology, plane_id);
+
+    for (uint32_t i = 0; plane && i < plane->plane->count_formats; i++)
+    {
+        if (plane->plane->formats[i] == format)
+            return true;
+    }
+
+    return false;
+}
+
+uint32_t xDRM_Topology_Pick_Crtc(const struct xdrm_topology *topology, const struct xdrm_topology_connector *connector, uint32_t used_crtcs)
+{
+    int index;
+
+    // keep the CRTC which already drives it, modeset is cheapest and boot splash stays put
+    index = xDRM_Topology_Crtc_Index(topology, connector->crtc_id);
+    if (index >= 0 && !(used_crtcs & (1u << index)))
+        return connector->crtc_id;
+
+    for (uint32_t i = 0; i < topology->crtc_count; i++)
+    {
+        if ((connector->possible_crtcs & (1u << i)) && !(used_crtcs & (1u << i)))
+            return topology->crtcs[i].id;
+    }
+
+    return 0;
+}
+
+uint32_t xDRM_Topology_Pick_Plane(const struct xdrm_topology *topology, uint32_t crtc_id, uint32_t format, enum xdrm_plane_type type,
+                                  const uint32_t *used, uint32_t count)
+{
+    int index = xDRM_Topology_Crtc_Index(topology, crtc_id);
+    uint32_t fallback = 0;
+    bool taken;
+
+    if (index < 0)
+        return 0;
+
+    for (uint32_t i = 0; i < topology->plane_count; i++)
+    {
+        const struct xdrm_topology_plane *plane = &topology->planes[i];
+
+        if (!(plane->plane->possible_crtcs & (1u << index)) || plane->type == XDRM_PLANE_CURSOR)
+            continue;
+        if (format && !xDRM_Topology_Plane_Has_Format(topology, plane->plane->plane_id, format))
+            continue;
+
+        taken = false;
+        for (uint32_t u = 0; u < count && !taken; u++)
+            taken = (used[u] == plane->plane->plane_id);
+        if (taken)
+            continue;
+
+        if (plane->type == type)
+            return plane->plane->plane_id;
+        if (!fallback)
+            fallback = plane->plane->plane_id;
+    }
+
+    return fallback;
+}
+
+void xDRM_Topology_Print(const struct xdrm_topology *topology)
+{
+    static const char *type_names[] = {"overlay", "primary", "cursor"};
+
+    for (uint32_t c = 0; c < topology->connector_count; c++)
+    {
+        const struct xdrm_topology_connector *connector = &topology->connectors[c];
+
+        printf("%s: id %u, %s, %d modes, CRTC %u\n", connector->name, connector->connector->connector_id,
+               connector->connector->connection == DRM_MODE_CONNECTED ? "connected" : "disconnected",
+               connector->connector->count_modes, connector->crtc_id);
+
+        for (uint32_t i = 0; i < topology->crtc_count; i++)
+        {
+            if (!(connector->possible_crtcs & (1u << i)))
+                continue;
+
+            printf("    CRTC %u, planes:", topology->crtcs[i].id);
+            for (uint32_t p = 0; p < topology->plane_count; p++)
+            {
+                if (topology->planes[p].plane->possible_crtcs & (1u << i))
+                    printf(" %u (%s)", topology->planes[p].plane->plane_id, type_names[topology->planes[p].type]);
+            }
+            printf("\n");
+        }
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include "../backend/backend.h"
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// objects of each kind kept, more than any SoC display controller has
+#define XDRM_TOPOLOGY_OBJECT_MAX 32
+
+// plane type property, names as the kernel enum
+enum xdrm_plane_type
+{
+    XDRM_PLANE_OVERLAY = 0,
+    XDRM_PLANE_PRIMARY,
+    XDRM_PLANE_CURSOR,
+};
+
+struct xdrm_topology_props
+{
+    drmModeObjectPropertiesPtr values;
+    // per property of values, shared by every object which has it, owned by topology
+    drmModePropertyRes **info;
+};
+
+struct xdrm_topology_connector
+{
+    drmModeConnectorPtr connector;
+    // "DSI-1", "HDMI-A-1", as the kernel names it
+    char name[32];
+    // CRTCs any of its encoders can drive, bit n is crtcs[n]
+    uint32_t possible_crtcs;
+    // CRTC driving it at snapshot, 0 when off
+    uint32_t crtc_id;
+    struct xdrm_topology_props props;
+};
+
+struct xdrm_topology_crtc
+{
+    uint32_t id;
+    struct xdrm_topology_props props;
+};
+
+struct xdrm_topology_plane
+{
+    drmModePlanePtr plane;
+    enum xdrm_plane_type type;
+    struct xdrm_topology_props props;
+};
+
+/**
+ * Display objects of one fd with their properties, taken once by xDRM_Topology_Create and read only afterwards.
+ * Each property id is fetched once however many objects share it.
+ */
+struct xdrm_topology
+{
+    uint32_t connector_count;
+    uint32_t encoder_count;
+    uint32_t crtc_count;
+    uint32_t plane_count;
+    struct xdrm_topology_connector connectors[XDRM_TOPOLOGY_OBJECT_MAX];
+    drmModeEncoderPtr encoders[XDRM_TOPOLOGY_OBJECT_MAX];
+    // index is the bit of possible_crtcs
+    struct xdrm_topology_crtc crtcs[XDRM_TOPOLOGY_OBJECT_MAX];
+    struct xdrm_topology_plane planes[XDRM_TOPOLOGY_OBJECT_MAX];
+
+    drmModePropertyRes **properties;
+    uint32_t property_count;
+    uint32_t property_size;
+};
+
+/**
+ * @brief Snapshot of connectors, encoders, CRTCs, planes and their properties through xdrm_backend.
+ * @note Needs DRM_CLIENT_CAP_UNIVERSAL_PLANES and DRM_CLIENT_CAP_ATOMIC set, otherwise planes and properties are missing.
+ *
+ * @return topology, NULL with errno set on failure.
+ */
+struct xdrm_topology *xDRM_Topology_Create(int fd);
+
+void xDRM_Topology_Free(struct xdrm_topology *topology);
+
+const struct xdrm_topology_connector *xDRM_Topology_Get_Connector(const struct xdrm_topology *topology, uint32_t id);
+
+/**
+ * @brief Connector by kernel name like "DSI-1", NULL when there is none.
+ */
+const struct xdrm_topology_connector *xDRM_Topology_Find_Connector(const struct xdrm_topology *topology, const char *name);
+
+const struct xdrm_topology_plane *xDRM_Topology_Get_Plane(const struct xdrm_topology *topology, uint32_t id);
+
+/**
+ * @brief Index of CRTC, its bit in possible_crtcs, -1 when unknown.
+ */
+int xDRM_Topology_Crtc_Index(const struct xdrm_topology *topology, uint32_t crtc_id);
+
+const struct xdrm_topology_props *xDRM_Topology_Get_Crtc_Props(const struct xdrm_topology *topology, uint32_t crtc_id);
+
+bool xDRM_Topology_Plane_Has_Format(const struct xdrm_topology *topology, uint32_t plane_id, uint32_t format);
+
+/**
+ * @brief CRTC for connector, the one driving it if free, otherwise the first free one it can reach.
+ *
+ * @param used_crtcs CRTCs taken, bit n is crtcs[n]
+ * @return CRTC id, 0 when none is free.
+ */
+uint32_t xDRM_Topology_Pick_Crtc(const struct xdrm_topology *topology, const struct xdrm_topology_connector *connector, uint32_t used_crtcs);
+
+/**
+ * @brief Plane for CRTC showing format, of type if there is one free, otherwise any free plane but a cursor.
+ *
+ * @param format 0 for any format
+ * @param used planes taken, count entries
+ * @return plane id, 0 when none fits.
+ */
+uint32_t xDRM_Topology_Pick_Plane(const struct xdrm_topology *topology, uint32_t crtc_id, uint32_t format, enum xdrm_plane_type type,
+                                  const uint32_t *used, uint32_t count);
+
+/**
+ * @brief Print connectors, with CRTCs and planes they can use, to pick names and ids from.
+ */
+void xDRM_Topology_Print(const struct xdrm_topology *topology);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,246 @@
+#include "trace.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *trace_names[XDRM_TRACE_TYPE_NUM] = {
+    "push", "copy", "commit", "flip", "drop", "busy", "missed",
+};
+
+const char *xDRM_Trace_Name(enum xdrm_trace_type type)
+{
+    return (unsigned)type < XDRM_TRACE_TYPE_NUM ? trace_names[type] : "unknown";
+}
+
+#if __ENABLE_TRACE__
+
+// a slot is complete when index holds its position in ring plus one, written last
+struct trace_slot
+{
+    uint64_t index;
+    struct xdrm_trace_event event;
+};
+
+uint32_t xdrm_trace_sinks = 0;
+
+static struct
+{
+    struct trace_slot *ring;
+    uint64_t mask;
+    uint64_t head;
+    int marker_fd;
+} trace = {NULL, 0, 0, -1};
+
+static int trace_open_marker(void)
+{
+    static const char *paths[] = {
+        "/sys/kernel/tracing/trace_marker",
+        "/sys/kernel/debug/tracing/trace_marker",
+    };
+    int fd = -1;
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]) && fd < 0; i++)
+        fd = open(paths[i], O_WRONLY | O_CLOEXEC);
+
+    return fd < 0 ? -errno : fd;
+}
+
+int xDRM_Trace_Start(uint32_t sinks, uint32_t capacity)
+{
+    uint64_t size = 1;
+    int fd;
+
+    if (!sinks || (sinks & ~(XDRM_TRACE_SINK_RING | XDRM_TRACE_SINK_MARKER)))
+        return -EINVAL;
+
+    xDRM_Trace_Stop();
+
+    // Step 1 : trace_marker, tracefs mounted and writable
+    if (sinks & XDRM_TRACE_SINK_MARKER)
+    {
+        if (trace.marker_fd < 0)
+        {
+            fd = trace_open_marker();
+            if (fd < 0)
+                return fd;
+            trace.marker_fd = fd;
+        }
+    }
+
+    // Step 2 : ring, reallocated only when size changes
+    if (sinks & XDRM_TRACE_SINK_RING)
+    {
+        while (size < (capacity ? capacity : XDRM_TRACE_RING_DEFAULT))
+            size <<= 1;
+
+        if (!trace.ring || trace.mask + 1 != size)
+        {
+            free(trace.ring);
+            trace.ring = (struct trace_slot *)calloc(size, sizeof(struct trace_slot));
+            if (!trace.ring)
+            {
+                trace.mask = 0;
+                return -ENOMEM;
+            }
+            trace.mask = size - 1;
+        }
+        else
+        {
+            memset(trace.ring, 0, size * sizeof(struct trace_slot));
+        }
+        trace.head = 0;
+    }
+
+    __atomic_store_n(&xdrm_trace_sinks, sinks, __ATOMIC_RELEASE);
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Trace started:%s%s\n", (sinks & XDRM_TRACE_SINK_RING) ? " ring" : "", (sinks & XDRM_TRACE_SINK_MARKER) ? " trace_marker" : "");
+#endif
+
+    return 0;
+}
+
+void xDRM_Trace_Stop(void)
+{
+    __atomic_store_n(&xdrm_trace_sinks, 0, __ATOMIC_RELEASE);
+}
+
+static void trace_write_marker(const struct xdrm_trace_event *event)
+{
+    char line[256];
+    int len;
+
+    // atrace instant, Perfetto shows it on the writing thread
+    len = snprintf(line, sizeof(line), "I|%d|xdrm %s plane=%u crtc=%u buf=%d frame=%llu vblank=%u value=%lld ts_ns=%llu dur_ns=%llu",
+                   (int)getpid(), xDRM_Trace_Name((enum xdrm_trace_type)event->type), event->plane, event->crtc, event->buf,
+                   (unsigned long long)event->frame, event->vblank, (long long)event->value,
+                   (unsigned long long)event->ts_ns, (unsigned long long)event->dur_ns);
+
+    // one write is one trace entry, a lost event is not worth an error
+    if (len > 0 && write(trace.marker_fd, line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1) < 0)
+        return;
+}
+
+void xDRM_Trace_Record(const struct xdrm_trace_event *event)
+{
+    uint32_t sinks = __atomic_load_n(&xdrm_trace_sinks, __ATOMIC_ACQUIRE);
+    struct trace_slot *slot;
+    uint64_t index;
+
+    if (sinks & XDRM_TRACE_SINK_RING)
+    {
+        // claim a slot, invalidate it while writing, oldest events are overwritten
+        index = __atomic_fetch_add(&trace.head, 1, __ATOMIC_RELAXED);
+        slot = &trace.ring[index & trace.mask];
+        __atomic_store_n(&slot->index, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->event = *event;
+        __atomic_store_n(&slot->index, index + 1, __ATOMIC_RELEASE);
+    }
+
+    if (sinks & XDRM_TRACE_SINK_MARKER)
+        trace_write_marker(event);
+}
+
+/**
+ * @brief Copy slot of position index, false when it was not written yet, is being written or was overwritten.
+ */
+static bool trace_read_slot(uint64_t index, struct xdrm_trace_event *event)
+{
+    struct trace_slot *slot = &trace.ring[index & trace.mask];
+
+    if (__atomic_load_n(&slot->index, __ATOMIC_ACQUIRE) != index + 1)
+        return false;
+
+    *event = slot->event;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&slot->index, __ATOMIC_RELAXED) == index + 1;
+}
+
+int xDRM_Trace_Dump(const char *path)
+{
+    uint32_t tracks[64];
+    struct xdrm_trace_event event;
+    uint64_t head, first;
+    int count = 0, track_count = 0, ret = 0;
+    bool known;
+    FILE *file;
+
+    if (!path)
+        return -EINVAL;
+
+    head = __atomic_load_n(&trace.head, __ATOMIC_ACQUIRE);
+    if (!trace.ring || !head)
+        return -ENODATA;
+    first = head > trace.mask + 1 ? head - trace.mask - 1 : 0;
+
+    file = fopen(path, "w");
+    if (!file)
+        return -errno;
+
+    // one track per plane, named once, timestamps in us
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint64_t i = first; i < head; i++)
+    {
+        if (!trace_read_slot(i, &event))
+            continue;
+
+        known = false;
+        for (int t = 0; t < track_count && !known; t++)
+            known = (tracks[t] == event.plane);
+        if (!known && track_count < (int)(sizeof(tracks) / sizeof(tracks[0])))
+        {
+            tracks[track_count++] = event.plane;
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"plane %u crtc %u\"}}",
+                    count ? ",\n" : "", (int)getpid(), event.plane, event.plane, event.crtc);
+            count++;
+        }
+
+        fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"xdrm\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,",
+                xDRM_Trace_Name((enum xdrm_trace_type)event.type), (int)getpid(), event.plane, event.ts_ns / 1e3);
+        if (event.dur_ns)
+            fprintf(file, "\"ph\":\"X\",\"dur\":%.3f,", event.dur_ns / 1e3);
+        else
+            fprintf(file, "\"ph\":\"i\",\"s\":\"t\",");
+        fprintf(file, "\"args\":{\"crtc\":%u,\"buf\":%d,\"frame\":%llu,\"vblank\":%u,\"value\":%lld}}",
+                event.crtc, event.buf, (unsigned long long)event.frame, event.vblank, (long long)event.value);
+        count++;
+    }
+    fprintf(file, "\n]}\n");
+
+    if (ferror(file))
+        ret = -EIO;
+    if (fclose(file) && !ret)
+        ret = -errno;
+
+    return ret ? ret : count - track_count;
+}
+
+#else
+
+int xDRM_Trace_Start(uint32_t sinks, uint32_t capacity)
+{
+    (void)sinks;
+    (void)capacity;
+
+    return -ENOTSUP;
+}
+
+void xDRM_Trace_Stop(void)
+{
+}
+
+void xDRM_Trace_Record(const struct xdrm_trace_event *event)
+{
+    (void)event;
+}
+
+int xDRM_Trace_Dump(const char *path)
+{
+    (void)path;
+
+    return -ENOTSUP;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "../conf/debug.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// events of a frame from push to screen, one track per plane
+enum xdrm_trace_type
+{
+    // frame queued for display, frame is its submit sequence
+    XDRM_TRACE_PUSH = 0,
+    // span from buffer acquired until submitted, copy and compose
+    XDRM_TRACE_COPY,
+    // span of atomic commit ioctl, value is its return
+    XDRM_TRACE_COMMIT,
+    // flip completed, stamped with kernel vblank timestamp, buf is now on screen
+    XDRM_TRACE_FLIP,
+    // queued frame handed back unseen, a newer one took its place
+    XDRM_TRACE_DROP,
+    // push refused with -EBUSY, buf is -1
+    XDRM_TRACE_BUSY,
+    // flip event after a gap in vblank sequence, value is vblanks missed
+    XDRM_TRACE_MISSED,
+    XDRM_TRACE_TYPE_NUM,
+};
+
+// where events go, any combination
+#define XDRM_TRACE_SINK_RING (1u << 0)
+#define XDRM_TRACE_SINK_MARKER (1u << 1)
+
+#define XDRM_TRACE_RING_DEFAULT 16384
+
+struct xdrm_trace_event
+{
+    // CLOCK_MONOTONIC ns, start of span
+    uint64_t ts_ns;
+    // 0 for instant events
+    uint64_t dur_ns;
+    uint64_t frame;
+    int64_t value;
+    uint32_t type;
+    uint32_t crtc;
+    uint32_t plane;
+    // last vblank sequence seen on crtc
+    uint32_t vblank;
+    int32_t buf;
+};
+
+#if __ENABLE_TRACE__
+// sinks in use, 0 while stopped, tested before an event is built
+extern uint32_t xdrm_trace_sinks;
+
+static inline bool xDRM_Trace_Enabled(void)
+{
+    return __atomic_load_n(&xdrm_trace_sinks, __ATOMIC_RELAXED) != 0;
+}
+#else
+static inline bool xDRM_Trace_Enabled(void)
+{
+    return false;
+}
+#endif
+
+/**
+ * @brief Start tracing into sinks.
+ * @note Compiled in by __ENABLE_TRACE__, otherwise every call is a no-op and the hot path holds no trace code.
+ *       Not to be called while another thread records, stop first.
+ *
+ * @param sinks XDRM_TRACE_SINK_* mask
+ * @param capacity events kept by ring, rounded up to a power of two, 0 for XDRM_TRACE_RING_DEFAULT
+ * @return 0 on success, -EINVAL on invalid param, -ENOTSUP when compiled out, -errno when trace_marker cannot be opened.
+ */
+int xDRM_Trace_Start(uint32_t sinks, uint32_t capacity);
+
+/**
+ * @brief Stop recording, ring is kept for xDRM_Trace_Dump.
+ */
+void xDRM_Trace_Stop(void);
+
+/**
+ * @brief Add an event, safe from any thread, lock free.
+ * @note trace_marker stamps its own time at write, ts_ns and dur_ns go into the line as args.
+ */
+void xDRM_Trace_Record(const struct xdrm_trace_event *event);
+
+/**
+ * @brief Write events of ring, oldest first, as Chrome JSON trace which Perfetto UI and chrome://tracing open.
+ *
+ * @param path file to write
+ * @return events written, -ENOTSUP when compiled out, -ENODATA when ring is empty, -errno on write error.
+ */
+int xDRM_Trace_Dump(const char *path);
+
+const char *xDRM_Trace_Name(enum xdrm_trace_type type);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,81 +4,173 @@
 /* ================================================== Section 1 : Basic ================================================== */
 /* ======================================================================================================================= */
 
-static uint32_t get_property_id(int fd, drmModeObjectProperties *props, const char *name)
+/**
+ * @brief Frame period of display mode in ns, from pixel clock and totals.
+ */
+static uint64_t modeset_refresh_ns(const drmModeModeInfo *mode)
 {
-    drmModePropertyPtr property;
-    uint32_t i, prop_id = 0;
+    if (mode->clock && mode->htotal && mode->vtotal)
+        return (uint64_t)mode->htotal * mode->vtotal * 1000000ull / mode->clock;
 
-    for (i = 0; i < props->count_props; i++)
-    {
-        property = drmModeGetProperty(fd, props->props[i]);
-        if (!property)
-            continue;
+    if (mode->vrefresh)
+        return 1000000000ull / mode->vrefresh;
 
-        if (!strcmp(property->name, name))
-            prop_id = property->prop_id;
+    // fallback 60Hz
+    return 16666667ull;
+}
 
-        drmModeFreeProperty(property);
-        if (prop_id)
-            break;
+struct modeset_format_info
+{
+    uint32_t format;
+    uint32_t planes;
+    // bytes per pixel of each plane
+    uint32_t cpp[2];
+    // chroma subsampling
+    uint32_t hsub;
+    uint32_t vsub;
+};
+
+static const struct modeset_format_info modeset_formats[] = {
+    {DRM_FORMAT_ARGB8888, 1, {4, 0}, 1, 1},
+    {DRM_FORMAT_XRGB8888, 1, {4, 0}, 1, 1},
+    {DRM_FORMAT_RGB565, 1, {2, 0}, 1, 1},
+    {DRM_FORMAT_YUYV, 1, {2, 0}, 2, 1},
+    {DRM_FORMAT_NV12, 2, {1, 2}, 2, 2},
+    {DRM_FORMAT_NV16, 2, {1, 2}, 2, 1},
+};
+
+static const struct modeset_format_info *modeset_get_format_info(uint32_t format)
+{
+    for (size_t i = 0; i < sizeof(modeset_formats) / sizeof(modeset_formats[0]); i++)
+    {
+        if (modeset_formats[i].format == format)
+            return &modeset_formats[i];
     }
 
-    return prop_id;
+    return NULL;
+}
+
+/**
+ * @brief Bytes of one row and number of rows of plane n, for width x height frame.
+ */
+static void modeset_plane_size(const struct modeset_format_info *info, int n, uint32_t width, uint32_t height, uint32_t *row, uint32_t *rows)
+{
+    uint32_t hsub = n ? info->hsub : 1;
+    uint32_t vsub = n ? info->vsub : 1;
+
+    *row = width / hsub * info->cpp[n];
+    *rows = height / vsub;
+}
+
+static void modeset_get_object_properties(struct drm_object *obj, const struct xdrm_topology_props *props)
+{
+    obj->props = props ? props->values : NULL;
+    obj->props_info = props ? props->info : NULL;
+}
+
+static void modeset_put_object_properties(struct drm_object *obj)
+{
+    obj->props = NULL;
+    obj->props_info = NULL;
 }
 
-static int set_drm_object_property(drmModeAtomicReq *req, struct drm_object *obj, const char *name, uint64_t value)
+static const char *modeset_plane_prop_names[MODESET_PLANE_PROP_NUM] = {
+    [MODESET_PLANE_FB_ID] = "FB_ID",
+    [MODESET_PLANE_CRTC_ID] = "CRTC_ID",
+    [MODESET_PLANE_SRC_X] = "SRC_X",
+    [MODESET_PLANE_SRC_Y] = "SRC_Y",
+    [MODESET_PLANE_SRC_W] = "SRC_W",
+    [MODESET_PLANE_SRC_H] = "SRC_H",
+    [MODESET_PLANE_CRTC_X] = "CRTC_X",
+    [MODESET_PLANE_CRTC_Y] = "CRTC_Y",
+    [MODESET_PLANE_CRTC_W] = "CRTC_W",
+    [MODESET_PLANE_CRTC_H] = "CRTC_H",
+    [MODESET_PLANE_ZPOS] = "zpos",
+    [MODESET_PLANE_FB_DAMAGE_CLIPS] = "FB_DAMAGE_CLIPS",
+    [MODESET_PLANE_ALPHA] = "alpha",
+};
+
+/**
+ * @brief Resolve plane property ids once, so flips never look up names.
+ * 
+ * @return 0 on success, -EINVAL when a mandatory property is missing.
+ */
+static int modeset_get_plane_props(struct modeset_dev *dev)
 {
-    uint32_t prop_id = 0;
-    int i;
+    memset(dev->plane_props, 0, sizeof(dev->plane_props));
+
+    if (!dev->plane.props)
+        return -EINVAL;
 
-    for (i = 0; i < obj->props->count_props; i++)
+    for (int i = 0; i < dev->plane.props->count_props; i++)
     {
-        if (!strcmp(obj->props_info[i]->name, name))
+        if (!dev->plane.props_info[i])
+            continue;
+
+        for (int p = 0; p < MODESET_PLANE_PROP_NUM; p++)
         {
-            prop_id = obj->props_info[i]->prop_id;
-            break;
+            if (!strcmp(dev->plane.props_info[i]->name, modeset_plane_prop_names[p]))
+            {
+                dev->plane_props[p] = dev->plane.props_info[i]->prop_id;
+                break;
+            }
         }
     }
 
-    if (prop_id == 0)
+    // zpos and later ones are optional
+    for (int p = 0; p < MODESET_PLANE_ZPOS; p++)
     {
-        fprintf(stderr, "Could not find property %s\n", name);
-        return -EINVAL;
+        if (!dev->plane_props[p])
+        {
+            fprintf(stderr, "Could not find property %s\n", modeset_plane_prop_names[p]);
+            return -EINVAL;
+        }
     }
 
-    return drmModeAtomicAddProperty(req, obj->id, prop_id, value);
+#if __ENABLE_DEBUG_LOG__
+    if (!dev->plane_props[MODESET_PLANE_ZPOS])
+        fprintf(stderr, "Note: zpos property not supported\n");
+#endif
+
+    return 0;
 }
 
-static void modeset_get_object_properties(int fd, struct drm_object *obj, uint32_t type)
+static int modeset_set_plane_prop(drmModeAtomicReq *req, struct modeset_dev *dev, enum modeset_plane_prop prop, uint64_t value)
 {
-    obj->props = drmModeObjectGetProperties(fd, obj->id, type);
-    if (!obj->props)
-    {
-        fprintf(stderr, "Cannot get object properties\n");
-        return;
-    }
+    return xdrm_backend->atomic_add_property(req, dev->plane.id, dev->plane_props[prop], value);
+}
 
-    obj->props_info = (drmModePropertyRes **)calloc(obj->props->count_props, sizeof(*obj->props_info));
-    for (int i = 0; i < obj->props->count_props; i++)
-    {
-        obj->props_info[i] = drmModeGetProperty(fd, obj->props->props[i]);
-    }
+/**
+ * @brief Dumb buffers and import slots, display side walks both.
+ */
+static int modeset_buf_slots(struct modeset_dev *dev)
+{
+    return dev->buf_count + MODESET_IMPORT_MAX;
 }
 
 static int modeset_create_fb(int fd, struct modeset_buf *buf)
 {
+    const struct modeset_format_info *info = modeset_get_format_info(buf->format);
     struct drm_mode_create_dumb creq;
-    struct drm_mode_map_dumb mreq;
+    uint32_t row, rows;
     int ret;
 
-    // create ARGB buffer
+    if (!info)
+        return -EINVAL;
+
+    // create buffer, YUV planes are stacked in one 8bpp dumb buffer with a common pitch
     memset(&creq, 0, sizeof(creq));
     creq.width = buf->width;
     creq.height = buf->height;
-    creq.bpp = 32;
+    creq.bpp = info->cpp[0] * 8;
     creq.flags = 0;
+    for (int n = 1; n < info->planes; n++)
+    {
+        modeset_plane_size(info, n, buf->width, buf->height, &row, &rows);
+        creq.height += rows * row / buf->width;
+    }
 
-    ret = drmIoctl(fd, DRM_IOCTL_MODE_CREATE_DUMB, &creq);
+    ret = xdrm_backend->create_dumb(fd, &creq);
     if (ret < 0)
     {
         fprintf(stderr, "cannot create dumb buffer (%d): %m\n", errno);
@@ -90,13 +182,24 @@ static int modeset_create_fb(int fd, struct modeset_buf *buf)
     buf->handle = creq.handle;
 
     // crate framebuffer
-    uint32_t handles[4] = {buf->handle};
-    uint32_t pitches[4] = {buf->stride};
-    uint32_t offsets[4] = {0};
+    uint32_t handles[4] = {0};
+    uint32_t offset = 0;
+    memset(buf->pitches, 0, sizeof(buf->pitches));
+    memset(buf->offsets, 0, sizeof(buf->offsets));
+    buf->planes = info->planes;
+    for (int n = 0; n < info->planes; n++)
+    {
+        handles[n] = buf->handle;
+        buf->pitches[n] = creq.pitch;
+        buf->offsets[n] = offset;
+
+        modeset_plane_size(info, n, buf->width, buf->height, &row, &rows);
+        offset += creq.pitch * rows;
+    }
 
     // clang-format off
-    ret = drmModeAddFB2(fd, buf->width, buf->height,
-                        DRM_FORMAT_ARGB8888, handles, pitches, offsets,
+    ret = xdrm_backend->add_fb2(fd, buf->width, buf->height,
+                        buf->format, handles, buf->pitches, buf->offsets,
                         &buf->fb, DRM_MODE_FB_MODIFIERS);
     // clang-format on    
     if (ret)
@@ -107,18 +210,7 @@ static int modeset_create_fb(int fd, struct modeset_buf *buf)
     }
 
     // memory map
-    memset(&mreq, 0, sizeof(mreq));
-    mreq.handle = buf->handle;
-    ret = drmIoctl(fd, DRM_IOCTL_MODE_MAP_DUMB, &mreq);
-    if (ret) {
-        fprintf(stderr, "cannot map dumb buffer (%d): %m\n", errno);
-        ret = -errno;
-        goto err_fb;
-    }
-
-    buf->map = (uint8_t *)mmap(0, buf->size,
-                    PROT_READ | PROT_WRITE, MAP_SHARED,
-                    fd, mreq.offset);
+    buf->map = (uint8_t *)xdrm_backend->map_dumb(fd, buf->handle, buf->size);
     if (buf->map == MAP_FAILED) {
         fprintf(stderr, "cannot mmap dumb buffer (%d): %m\n", errno);
         ret = -errno;
@@ -128,119 +220,153 @@ static int modeset_create_fb(int fd, struct modeset_buf *buf)
     return 0;
 
 err_fb:
-    drmModeRmFB(fd, buf->fb);
+    xdrm_backend->rm_fb(fd, buf->fb);
 err_destroy:
-    struct drm_mode_destroy_dumb dreq;
-    memset(&dreq, 0, sizeof(dreq));
-    dreq.handle = buf->handle;
-    drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+    xdrm_backend->destroy_dumb(fd, buf->handle);
     return ret;
 }
 
 static void modeset_destroy_fb(int fd, struct modeset_buf *buf)
 {
-    struct drm_mode_destroy_dumb dreq;
-
     // unmap
-    munmap(buf->map, buf->size);
+    xdrm_backend->unmap_dumb(buf->map, buf->size);
 
     // remove fb
-    drmModeRmFB(fd, buf->fb);
+    xdrm_backend->rm_fb(fd, buf->fb);
 
     // destroy buffer
-    memset(&dreq, 0, sizeof(dreq));
-    dreq.handle = buf->handle;
-    drmIoctl(fd, DRM_IOCTL_MODE_DESTROY_DUMB, &dreq);
+    xdrm_backend->destroy_dumb(fd, buf->handle);
 }
 
-static int check_plane_capabilities(int fd, struct modeset_dev *dev)
+/**
+ * @brief Wrap a dma-buf as framebuffer by PRIME import, chroma planes follow plane 0 in the same dma-buf.
+ * @note Semi-planar chroma rows hold as many bytes as luma rows, so every plane shares stride.
+ */
+static int modeset_import_fb(int fd, struct modeset_buf *buf, int dmabuf_fd, uint32_t stride, uint32_t offset)
 {
-    drmModePlane *plane = drmModeGetPlane(fd, dev->plane.id);
-    if (!plane)
-    {
-        fprintf(stderr, "Cannot get plane %u\n", dev->plane.id);
+    const struct modeset_format_info *info = modeset_get_format_info(buf->format);
+    uint32_t handles[4] = {0};
+    uint32_t row, rows;
+    int ret;
+
+    if (!info)
         return -EINVAL;
+
+    ret = xdrm_backend->prime_fd_to_handle(fd, dmabuf_fd, &buf->handle);
+    if (ret)
+    {
+        fprintf(stderr, "cannot import dma-buf %d (%d): %m\n", dmabuf_fd, errno);
+        return -errno;
     }
 
-#if __ENABLE_DEBUG_LOG__
-    printf("Plane info: id=%u, possible_crtcs=0x%x, formats_count=%u\n",
-           plane->plane_id, plane->possible_crtcs, plane->count_formats);
-#endif
+    memset(buf->pitches, 0, sizeof(buf->pitches));
+    memset(buf->offsets, 0, sizeof(buf->offsets));
+    buf->planes = info->planes;
+    for (int n = 0; n < info->planes; n++)
+    {
+        handles[n] = buf->handle;
+        buf->pitches[n] = n ? stride / info->hsub * info->cpp[n] / info->cpp[0] : stride;
+        buf->offsets[n] = offset;
+
+        modeset_plane_size(info, n, buf->width, buf->height, &row, &rows);
+        offset += buf->pitches[n] * rows;
+    }
+
+    buf->stride = stride;
+    buf->size = offset;
+    buf->map = NULL;
 
-    // get resource
-    drmModeRes *resources = drmModeGetResources(fd);
-    if (!resources)
+    // clang-format off
+    ret = xdrm_backend->add_fb2(fd, buf->width, buf->height,
+                        buf->format, handles, buf->pitches, buf->offsets,
+                        &buf->fb, 0);
+    // clang-format on
+    if (ret)
     {
-        fprintf(stderr, "Cannot get DRM resources\n");
-        drmModeFreePlane(plane);
-        return -EINVAL;
+        fprintf(stderr, "cannot create framebuffer for dma-buf %d (%d): %m\n", dmabuf_fd, errno);
+        ret = -errno;
+
+        xdrm_backend->gem_close(fd, buf->handle);
+        return ret;
     }
 
-    // checks whether the plane supports the specified CRTC
-    uint32_t crtc_bit = 0;
-    bool crtc_found = false;
+    return 0;
+}
+
+static void modeset_release_import(int fd, struct modeset_dev *dev, struct modeset_buf *buf)
+{
+    // remove fb
+    xdrm_backend->rm_fb(fd, buf->fb);
+    buf->fb = 0;
 
-    // traverse all encoders to find possible_crtcs related to CRTC
-    for (int i = 0; i < resources->count_encoders; i++)
+    // PRIME hands out one handle per dma-buf, keep it while another slot still uses it
+    for (int i = dev->buf_count; i < modeset_buf_slots(dev); i++)
     {
-        drmModeEncoder *encoder = drmModeGetEncoder(fd, resources->encoders[i]);
-        if (!encoder)
-            continue;
+        if (&dev->bufs[i] != buf && dev->bufs[i].fb && dev->bufs[i].handle == buf->handle)
+            return;
+    }
 
-        drmModeCrtc *crtc = drmModeGetCrtc(fd, dev->crtc.id);
-        if (crtc)
-        {
-            // if this encoder is currently connected to our CRTC
-            if (encoder->crtc_id == dev->crtc.id)
-            {
-                crtc_bit = encoder->possible_crtcs;
-                crtc_found = true;
-                drmModeFreeCrtc(crtc);
-                drmModeFreeEncoder(encoder);
-                break;
-            }
-            drmModeFreeCrtc(crtc);
-        }
-        drmModeFreeEncoder(encoder);
+    xdrm_backend->gem_close(fd, buf->handle);
+}
+
+static int check_plane_capabilities(const struct xdrm_topology *topology, struct modeset_dev *dev)
+{
+    const struct xdrm_topology_connector *connector = xDRM_Topology_Get_Connector(topology, dev->connector.id);
+    const struct xdrm_topology_plane *entry = xDRM_Topology_Get_Plane(topology, dev->plane.id);
+    int crtc_index = xDRM_Topology_Crtc_Index(topology, dev->crtc.id);
+    drmModePlane *plane;
+
+    if (!entry)
+    {
+        fprintf(stderr, "Cannot get plane %u\n", dev->plane.id);
+        return -EINVAL;
     }
+    plane = entry->plane;
 
-    drmModeFreeResources(resources);
+#if __ENABLE_DEBUG_LOG__
+    printf("Plane info: id=%u, possible_crtcs=0x%x, formats_count=%u\n",
+           plane->plane_id, plane->possible_crtcs, plane->count_formats);
+#endif
 
-    if (!crtc_found)
+    // checks whether connector, through one of its encoders, and plane can both use the CRTC
+    if (crtc_index < 0 || !connector || !(connector->possible_crtcs & (1u << crtc_index)))
     {
         fprintf(stderr, "Could not find encoder for CRTC %u\n", dev->crtc.id);
-        drmModeFreePlane(plane);
         return -EINVAL;
     }
 
-    if (!(plane->possible_crtcs & crtc_bit))
+    if (!(plane->possible_crtcs & (1u << crtc_index)))
     {
         fprintf(stderr, "Plane %u cannot be used with CRTC %u\n",
                 plane->plane_id, dev->crtc.id);
-        drmModeFreePlane(plane);
         return -EINVAL;
     }
 
-    // checkout format
+    // checkout format, 0 takes the first of modeset_formats which plane supports
     bool format_supported = false;
-    for (uint32_t i = 0; i < plane->count_formats; i++)
+    for (size_t f = 0; f < sizeof(modeset_formats) / sizeof(modeset_formats[0]) && !format_supported; f++)
     {
-        if (plane->formats[i] == DRM_FORMAT_ARGB8888)
+        if (dev->format && dev->format != modeset_formats[f].format)
+            continue;
+
+        for (uint32_t i = 0; i < plane->count_formats; i++)
         {
-            format_supported = true;
-            break;
+            if (plane->formats[i] == modeset_formats[f].format)
+            {
+                dev->format = modeset_formats[f].format;
+                format_supported = true;
+                break;
+            }
         }
     }
 
     if (!format_supported)
     {
-        fprintf(stderr, "Plane %u does not support ARGB8888 format\n",
-                plane->plane_id);
-        drmModeFreePlane(plane);
+        fprintf(stderr, "Plane %u does not support format %.4s\n",
+                plane->plane_id, dev->format ? (const char *)&dev->format : "any");
         return -EINVAL;
     }
 
-    drmModeFreePlane(plane);
     return 0;
 }
 
@@ -248,482 +374,2729 @@ static int check_plane_capabilities(int fd, struct modeset_dev *dev)
 /* ================================================== Section 2 : Atomic ================================================== */
 /* ======================================================================================================================== */
 
-static int modeset_atomic_prepare_commit(int fd, struct modeset_dev *dev, drmModeAtomicReq *req, 
-    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset)
+static int modeset_atomic_prepare_commit(int fd, struct modeset_dev *dev, drmModeAtomicReq *req, struct modeset_buf *buf,
+    const struct modeset_layout *layout)
 {
-    struct modeset_buf *buf = &dev->bufs[dev->front_buf ^ 1];
+    struct modeset_rect src = layout->src;
     int ret;
 
+    // CPU scaled frame sits 1:1 at top left of a scaled buffer
+    if (layout->cpu_scale)
+    {
+        src.x = 0;
+        src.y = 0;
+        src.width = layout->crtc.width;
+        src.height = layout->crtc.height;
+    }
+
     // only set necessary plane properties
-    ret = set_drm_object_property(req, &dev->plane, "FB_ID", buf->fb);
+    ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_FB_ID, buf->fb);
     if (ret < 0) return ret;
 
-    ret = set_drm_object_property(req, &dev->plane, "CRTC_ID", dev->crtc.id);
+    ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_ID, dev->crtc.id);
     if (ret < 0) return ret;
 
     // set source property
-    ret = set_drm_object_property(req, &dev->plane, "SRC_X", 0);
-    ret |= set_drm_object_property(req, &dev->plane, "SRC_Y", 0);
-    ret |= set_drm_object_property(req, &dev->plane, "SRC_W", source_width << 16);
-    ret |= set_drm_object_property(req, &dev->plane, "SRC_H", source_height << 16);
+    ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_SRC_X, (uint64_t)src.x << 16);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_SRC_Y, (uint64_t)src.y << 16);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_SRC_W, (uint64_t)src.width << 16);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_SRC_H, (uint64_t)src.height << 16);
     if (ret < 0) return ret;
 
-    // set display property
-    ret = set_drm_object_property(req, &dev->plane, "CRTC_X", x_offset);
-    ret |= set_drm_object_property(req, &dev->plane, "CRTC_Y", y_offset);
-    ret |= set_drm_object_property(req, &dev->plane, "CRTC_W", source_width);
-    ret |= set_drm_object_property(req, &dev->plane, "CRTC_H", source_height);
+    // set display property, plane scales when src and crtc differ
+    ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_X, (int)layout->crtc.x);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_Y, (int)layout->crtc.y);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_W, layout->crtc.width);
+    ret |= modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_H, layout->crtc.height);
+    if (ret < 0) return ret;
 
-    // zpos
-    ret = set_drm_object_property(req, &dev->plane, "zpos", 0);
-    if (ret < 0) {
-        fprintf(stderr, "Note: zpos property not supported\n");
-    }
+    // zpos and alpha, overlay layers stack above the video plane
+    if (dev->plane_props[MODESET_PLANE_ZPOS])
+        modeset_set_plane_prop(req, dev, MODESET_PLANE_ZPOS, layout->zpos);
+    if (dev->plane_props[MODESET_PLANE_ALPHA])
+        modeset_set_plane_prop(req, dev, MODESET_PLANE_ALPHA, layout->alpha);
 
     return 0;
 }
 
-static int modeset_atomic_commit(int fd, struct modeset_dev *dev, uint32_t flags,
-    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset)
+/**
+ * @brief Take geometry published by xDRM_Set_Scale, skipped while it is being written.
+ * @note Only called from the display side.
+ */
+static void modeset_take_layout(struct modeset_dev *dev)
 {
-    drmModeAtomicReq *req;
-    int ret;
+    uint32_t seq = __atomic_load_n(&dev->layout_seq, __ATOMIC_ACQUIRE);
+    struct modeset_layout layout;
 
-    req = drmModeAtomicAlloc();
-    if (!req)
+    if (seq == dev->layout_applied || (seq & 1))
+        return;
+
+    layout = dev->layout_pending;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&dev->layout_seq, __ATOMIC_RELAXED) != seq)
+        return;
+
+    dev->layout = layout;
+    dev->layout_applied = seq;
+    dev->scaled_seq[0] = UINT64_MAX;
+    dev->scaled_seq[1] = UINT64_MAX;
+    dev->plane_dirty = true;
+}
+
+/**
+ * @brief CPU fallback, scale frame of buf into the scaled buffer which is off screen.
+ * @note Every CRTC showing it completed last flip, so only scaled_front is on screen.
+ * 
+ * @return scaled buffer to show.
+ */
+static struct modeset_buf *modeset_scale_frame(struct modeset_dev *dev, struct modeset_buf *buf)
+{
+    const struct modeset_format_info *info = modeset_get_format_info(buf->format);
+    const struct modeset_layout *layout = &dev->layout;
+    uint64_t seq = __atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE);
+    struct modeset_buf *back;
+    int next = dev->scaled_front ^ 1;
+    int ret = 0;
+
+    // already scaled, shown again or retried after EBUSY
+    if (dev->scaled_seq[dev->scaled_front] == seq)
+        next = dev->scaled_front;
+    // imported dma-buf has no mapping, keep last frame
+    else if (dev->scaled_seq[next] != seq && (!buf->map || !info || buf->format != dev->scaled[next].format))
+        next = dev->scaled_front;
+    else if (dev->scaled_seq[next] != seq)
     {
-        fprintf(stderr, "Failed to allocate atomic request\n");
-        return -ENOMEM;
+        back = &dev->scaled[next];
+        for (int n = 0; n < info->planes && !ret; n++)
+        {
+            // packed YUYV scales by macropixel, chroma planes by subsampled sample
+            uint32_t hsub = (n || info->planes == 1) ? info->hsub : 1;
+            uint32_t vsub = n ? info->vsub : 1;
+            uint32_t unit = n ? info->cpp[n] : info->cpp[0] * hsub;
+
+            ret = xDRM_Scale(back->map + back->offsets[n], back->pitches[n], layout->crtc.width / hsub, layout->crtc.height / vsub,
+                             buf->map + buf->offsets[n] + (layout->src.y / vsub) * buf->pitches[n] + (layout->src.x / hsub) * unit,
+                             buf->pitches[n], layout->src.width / hsub, layout->src.height / vsub, unit, &dev->scale_scratch[n]);
+        }
+
+        dev->scaled_seq[next] = ret ? UINT64_MAX : seq;
+        if (ret)
+            next = dev->scaled_front;
     }
 
-    ret = modeset_atomic_prepare_commit(fd, dev, req, source_width, source_height, x_offset, y_offset);
-    if (ret < 0)
+    dev->scaled_next = next;
+    return &dev->scaled[next];
+}
+
+/**
+ * @brief Add plane state of next flip into req.
+ * @note Steady state flip only changes FB_ID, full state is sent while plane_dirty.
+ */
+static int modeset_atomic_prepare_flip(int fd, struct modeset_dev *dev, drmModeAtomicReq *req, struct modeset_buf *buf, uint32_t damage_blob)
+{
+    int ret;
+
+    modeset_take_layout(dev);
+
+    // clips are in source coordinates, a CPU scaled frame is damaged as a whole
+    if (dev->layout.cpu_scale)
     {
-        fprintf(stderr, "Failed to prepare atomic commit for plane %u\n", dev->plane.id);
-        drmModeAtomicFree(req);
-        return ret;
+        buf = modeset_scale_frame(dev, buf);
+        damage_blob = 0;
     }
 
-    // @note without the NONBLOCK flag and use synchronous commit
-    flags &= ~DRM_MODE_ATOMIC_NONBLOCK;
+    if (dev->plane_dirty)
+        ret = modeset_atomic_prepare_commit(fd, dev, req, buf, &dev->layout);
+    else
+        ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_FB_ID, buf->fb);
+
+    // without damage clips kernel treats the whole plane as damaged
+    if (ret >= 0 && damage_blob && dev->plane_props[MODESET_PLANE_FB_DAMAGE_CLIPS])
+        ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_FB_DAMAGE_CLIPS, damage_blob);
 
-    ret = drmModeAtomicCommit(fd, req, flags, dev);
     if (ret < 0)
-    {
-        fprintf(stderr, "Failed to commit atomic request for plane %u: %s\n",
-                dev->plane.id, strerror(errno));
-    }
+        fprintf(stderr, "Failed to prepare atomic commit for plane %u\n", dev->plane.id);
 
-    drmModeAtomicFree(req);
     return ret;
 }
 
-int modeset_atomic_page_flip(int fd, struct modeset_dev *dev,
-    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset)
+static int modeset_atomic_commit(int fd, drmModeAtomicReq *req, uint32_t flags, void *data)
 {
-    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT;
-    return modeset_atomic_commit(fd, dev, flags, source_width, source_height, x_offset, y_offset);
-}
+    int ret;
 
-/* ====================================================================================================================== */
-/* ================================================== Section 3 : Wrap ================================================== */
-/* ====================================================================================================================== */
+    // @note with NONBLOCK, EBUSY means previous flip is still pending and caller should retry
+    ret = xdrm_backend->atomic_commit(fd, req, flags, data);
+    if (ret < 0 && ret != -EBUSY)
+        fprintf(stderr, "Failed to commit atomic request: %s\n", strerror(-ret));
+
+    return ret;
+}
 
-static int modeset_setup_dev(int fd, struct modeset_dev *dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
-    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset)
+/**
+ * @brief Ask kernel whether plane of dev can show buf with layout, nothing is changed.
+ */
+static int modeset_test_layout(struct modeset_dev *dev, struct modeset_buf *buf, const struct modeset_layout *layout)
 {
+    drmModeAtomicReq *req = xdrm_backend->atomic_alloc();
     int ret;
-    
-    dev->connector.id = conn_id;
-    dev->crtc.id = crtc_id;
-    dev->plane.id = plane_id;
 
-    // Step 1 : checkout plane
-    ret = check_plane_capabilities(fd, dev);
-    if (ret < 0) {
-        fprintf(stderr, "Plane capability check failed\n");
-        return ret;
-    }
+    if (!req)
+        return -ENOMEM;
 
-    // Step 2 : get connector information
-    drmModeConnector *conn = drmModeGetConnector(fd, dev->connector.id);
-    if (!conn)
-    {
-        fprintf(stderr, "cannot get connector %u: %m\n", dev->connector.id);
-        return -errno;
-    }
+    ret = modeset_atomic_prepare_commit(dev->fd, dev, req, buf, layout);
+    if (ret >= 0)
+        ret = xdrm_backend->atomic_commit(dev->fd, req, DRM_MODE_ATOMIC_TEST_ONLY, NULL);
 
-    // Step 3 : get the current display mode
-    if (conn->count_modes <= 0)
-    {
-        fprintf(stderr, "no valid mode for connector %u\n", dev->connector.id);
-        ret = -EFAULT;
-        goto err_free;
-    }
-    
-    memcpy(&dev->mode, &conn->modes[0], sizeof(dev->mode));
+    xdrm_backend->atomic_free(req);
+    return ret;
+}
 
-    // Step 4 : set buffer display size, @note source!
-    dev->bufs[0].width = source_width;
-    dev->bufs[0].height = source_height;
-    dev->bufs[1].width = source_width;
-    dev->bufs[1].height = source_height;
+/* ======================================================================================================================== */
+/* ================================================== Section 3 : Mailbox ================================================= */
+/* ======================================================================================================================== */
 
-    dev->src_width = source_width;
-    dev->src_height = source_height;
-    dev->x_offset = x_offset;
-    dev->y_offset = y_offset;
+/*
+ * Buffer ownership is a lock-free queue, every transition is a CAS on modeset_buf::state:
+ *
+ *   producer : FREE -> ACQUIRED -> QUEUED
+ *   display  : QUEUED -> PENDING -> SCANOUT -> FREE
+ *
+ * Submits are stamped with seq and the display takes the oldest QUEUED buffer on each flip.
+ * At most queue_depth frames wait, older ones are handed back as FREE, so depth 1 is a
+ * mailbox where the newest completed frame wins, and the producer never waits.
+ */
+
+static bool modeset_buf_cas(struct modeset_buf *buf, enum modeset_buf_state from, enum modeset_buf_state to)
+{
+    return __atomic_compare_exchange_n(&buf->state, &from, to, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
 
-    // Step 5 : set property blob
-    ret = drmModeCreatePropertyBlob(fd, &dev->mode, sizeof(dev->mode),
-                                   &dev->mode_blob_id);
-    if (ret) {
-        fprintf(stderr, "cannot create mode blob: %m\n");
-        goto err_free;
-    }
+static enum modeset_buf_state modeset_buf_state(struct modeset_buf *buf)
+{
+    return __atomic_load_n(&buf->state, __ATOMIC_ACQUIRE);
+}
 
-    // Step 6 : get properties
-    modeset_get_object_properties(fd, &dev->connector, DRM_MODE_OBJECT_CONNECTOR);
-    modeset_get_object_properties(fd, &dev->crtc, DRM_MODE_OBJECT_CRTC);
-    modeset_get_object_properties(fd, &dev->plane, DRM_MODE_OBJECT_PLANE);
+static void modeset_count(uint64_t *counter, uint64_t n)
+{
+    __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
 
-    // Step 7 : create frame buffer
-    ret = modeset_create_fb(fd, &dev->bufs[0]);
-    if (ret)
-        goto err_blob;
+/**
+ * @brief Buffer was handed to producer, start stamps of a new frame, push defaults to now.
+ */
+static void modeset_stamp_acquire(struct modeset_buf *buf)
+{
+    buf->stamp.push_ns = buf->stamp.acquire_ns = xDRM_Latency_Now();
+    buf->stamp.submit_ns = 0;
+    buf->stamp.commit_ns = 0;
+}
 
-    ret = modeset_create_fb(fd, &dev->bufs[1]);
-    if (ret)
-        goto err_fb0;
+/**
+ * @brief Flip of dev completed at vblank_ns, record the frame it brought on screen once.
+ * @note Only called from the display side, front_buf is not handed out before next flip.
+ */
+static void modeset_record_latency(struct modeset_dev *dev, uint64_t vblank_ns)
+{
+    struct modeset_buf *buf = &dev->bufs[dev->front_buf];
 
+    if (!buf->stamp.commit_ns)
+        return;
 
-    // Step 8 : User buffer and mutex
-    dev->data_buffer = (uint32_t*)malloc(source_width * source_height * sizeof(uint32_t));
-    if (!dev->data_buffer) {
-        return -ENOMEM;
-    }
+    xDRM_Latency_Record_Frame(dev->latency, &buf->stamp, vblank_ns);
+    buf->stamp.commit_ns = 0;
+}
 
-    pthread_mutex_init(&dev->buffer_mutex, NULL);
-    dev->buffer_updated = false;
+/**
+ * @brief Output which owns the buffers shown by dev, a mirror has none of its own.
+ */
+static struct modeset_dev *modeset_source(struct modeset_dev *dev)
+{
+    return dev->mirror_of ? dev->mirror_of : dev;
+}
 
-    drmModeFreeConnector(conn);
-    return 0;
+/**
+ * @brief Wake draw loop when the output which flips dev sits idle, after a new frame or layout was published.
+ * @note Pairs with modeset_flip_wanted, either the display side sees the frame or the producer sees idle.
+ */
+static void modeset_wake(struct modeset_dev *dev)
+{
+    struct modeset_dev *output = dev->layer_of ? dev->layer_of : modeset_source(dev);
+    uint64_t one = 1;
 
-err_fb0:
-    modeset_destroy_fb(fd, &dev->bufs[0]);
-err_blob:
-    drmModeDestroyPropertyBlob(fd, dev->mode_blob_id);
-err_free:
-    drmModeFreeConnector(conn);
-    return ret;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&output->idle, __ATOMIC_RELAXED) || !__atomic_exchange_n(&output->idle, false, __ATOMIC_SEQ_CST))
+        return;
+
+    if (write(output->wake_fd, &one, sizeof(one)) < 0)
+        fprintf(stderr, "Failed to wake draw loop: %s\n", strerror(errno));
 }
 
-static int modeset_atomic_modeset(int fd, struct modeset_dev *dev)
+#if __ENABLE_TRACE__
+/**
+ * @brief Record a trace event of dev, a span when start_ns is set, end_ns is now when 0.
+ */
+static void modeset_trace(enum xdrm_trace_type type, struct modeset_dev *dev, int buf, uint64_t start_ns, uint64_t end_ns, int64_t value)
 {
-    int ret;
-    uint32_t flags;
+    struct xdrm_trace_event event;
 
-    drmModeAtomicReq *req = drmModeAtomicAlloc();
-    if (!req) {
-        return -ENOMEM;
-    }
+    if (!xDRM_Trace_Enabled())
+        return;
 
-    ret = modeset_atomic_prepare_commit(fd, dev, req, dev->src_width, dev->src_height, dev->x_offset, dev->y_offset);
-    if (ret < 0) {
-        drmModeAtomicFree(req);
-        return ret;
-    }
+    if (!end_ns)
+        end_ns = xDRM_Latency_Now();
 
-    // use the least privilege flag
-    flags = DRM_MODE_ATOMIC_NONBLOCK;
-    ret = drmModeAtomicCommit(fd, req, flags, dev);
-    if (ret < 0) {
-        printf("Atomic modeset failed: %s\n", strerror(errno));
-    }
+    event.ts_ns = start_ns ? start_ns : end_ns;
+    event.dur_ns = end_ns - event.ts_ns;
+    event.frame = buf >= 0 ? __atomic_load_n(&modeset_source(dev)->bufs[buf].seq, __ATOMIC_RELAXED) : 0;
+    event.value = value;
+    event.type = type;
+    event.crtc = dev->crtc.id;
+    event.plane = dev->plane.id;
+    event.vblank = __atomic_load_n(&dev->stats_sequence, __ATOMIC_RELAXED);
+    event.buf = buf;
 
-    drmModeAtomicFree(req);
-    return ret;
+    xDRM_Trace_Record(&event);
 }
 
-static int modeset_atomic_init(int fd)
+#define MODESET_TRACE(type, dev, buf, start_ns, end_ns, value) modeset_trace(type, dev, buf, start_ns, end_ns, value)
+#else
+#define MODESET_TRACE(type, dev, buf, start_ns, end_ns, value) do { } while (0)
+#endif
+
+/**
+ * @brief Find the oldest queued buffer.
+ * 
+ * @param count [out] number of queued buffers
+ * @return index of buffer, -1 when nothing is queued.
+ */
+static int modeset_oldest_queued(struct modeset_dev *dev, uint32_t *count)
 {
-    uint64_t cap;
-    int ret;
+    int oldest = -1;
+    uint64_t seq = 0;
 
-    ret = drmGetCap(fd, DRM_CAP_CRTC_IN_VBLANK_EVENT, &cap);
-    if (ret || !cap)
+    *count = 0;
+    for (int i = 0; i < modeset_buf_slots(dev); i++)
     {
-        fprintf(stderr, "Device does not support atomic modesetting\n");
-        return -ENOTSUP;
-    }
+        struct modeset_buf *buf = &dev->bufs[i];
 
-    ret = drmSetClientCap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
-    if (ret)
-    {
-        fprintf(stderr, "Failed to set universal planes cap\n");
-        return ret;
-    }
+        if (modeset_buf_state(buf) != MODESET_BUF_QUEUED)
+            continue;
 
-    ret = drmSetClientCap(fd, DRM_CLIENT_CAP_ATOMIC, 1);
-    if (ret)
-    {
-        fprintf(stderr, "Failed to set atomic cap\n");
-        return ret;
+        uint64_t buf_seq = __atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE);
+        if (oldest < 0 || buf_seq < seq)
+        {
+            oldest = i;
+            seq = buf_seq;
+        }
+        (*count)++;
     }
 
-    return 0;
+    return oldest;
 }
 
-void page_flip_handler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, unsigned int crtc_id, void *data)
+static void modeset_rect_union(struct modeset_rect *dst, const struct modeset_rect *src)
 {
-    struct modeset_dev *dev = (struct modeset_dev *)data;
+    uint32_t x2, y2;
 
-    dev->pflip_pending = false;
+    if (!src->width || !src->height)
+        return;
 
-#if __ENABLE_PATTERN__
-    if (!dev->cleanup)
+    if (!dst->width || !dst->height)
     {
-        // get current buffer
-        struct modeset_buf *buf = &dev->bufs[dev->front_buf ^ 1];
+        *dst = *src;
+        return;
+    }
 
-        // push data
-        xDRM_Pattern((uint32_t*)buf->map, dev->src_width, dev->src_height, frame_count_test_pattern++);
+    x2 = dst->x + dst->width > src->x + src->width ? dst->x + dst->width : src->x + src->width;
+    y2 = dst->y + dst->height > src->y + src->height ? dst->y + dst->height : src->y + src->height;
+    dst->x = dst->x < src->x ? dst->x : src->x;
+    dst->y = dst->y < src->y ? dst->y : src->y;
+    dst->width = x2 - dst->x;
+    dst->height = y2 - dst->y;
+}
 
-        // commit
-        int ret = modeset_atomic_page_flip(fd, dev, dev->src_width, dev->src_height, dev->x_offset, dev->y_offset);
-        if (ret >= 0)
-        {
-            dev->front_buf ^= 1;
-            dev->pflip_pending = true;
+/**
+ * @brief Hand the oldest queued buffers back to producer until queue_depth frames are left.
+ */
+static void modeset_trim_queue(struct modeset_dev *dev)
+{
+    uint32_t count;
+    int oldest;
 
-            // @attention, control 60fps.
-            usleep(16666);
-        }
-    }
-#else
-    if (!dev->cleanup)
+    while ((oldest = modeset_oldest_queued(dev, &count)) >= 0 && count > __atomic_load_n(&dev->queue_depth, __ATOMIC_RELAXED))
     {
-        struct modeset_buf *buf = &dev->bufs[dev->front_buf ^ 1];
-
-        pthread_mutex_lock(&dev->buffer_mutex);
-        if (dev->buffer_updated)
+        if (modeset_buf_cas(&dev->bufs[oldest], MODESET_BUF_QUEUED, MODESET_BUF_FREE))
         {
-            memcpy(buf->map, dev->data_buffer, 
-                dev->src_width * dev->src_height * sizeof(uint32_t));
-            dev->buffer_updated = false;
+            modeset_count(&dev->stats.overwritten, 1);
+            MODESET_TRACE(XDRM_TRACE_DROP, dev, oldest, 0, 0, 0);
         }
-        pthread_mutex_unlock(&dev->buffer_mutex);
+    }
+}
 
-        // commit
-        int ret = modeset_atomic_page_flip(fd, dev, dev->src_width, 
-                                        dev->src_height, dev->x_offset, dev->y_offset);
-        if (ret >= 0)
+/**
+ * @brief Pick the buffer to show on next vblank, in submit order.
+ * @note Only called from the display side.
+ * 
+ * @return index of queued buffer, or front_buf when nothing is queued.
+ */
+static int modeset_take_queued(struct modeset_dev *dev)
+{
+    uint32_t count;
+    int next;
+
+    modeset_trim_queue(dev);
+
+    // a producer may trim the queue meanwhile, look again when CAS fails
+    while ((next = modeset_oldest_queued(dev, &count)) >= 0)
+    {
+        if (modeset_buf_cas(&dev->bufs[next], MODESET_BUF_QUEUED, MODESET_BUF_PENDING))
+            return next;
+    }
+
+    return dev->front_buf;
+}
+
+/**
+ * @brief Flip of front_buf has completed, so every other scanout buffer is off screen.
+ * @note Only called from the display side.
+ */
+static void modeset_retire_buffers(struct modeset_dev *dev)
+{
+    for (int i = 0; i < modeset_buf_slots(dev); i++)
+    {
+        if (i == dev->front_buf)
+            __atomic_store_n(&dev->bufs[i].state, MODESET_BUF_SCANOUT, __ATOMIC_RELEASE);
+        else
+            modeset_buf_cas(&dev->bufs[i], MODESET_BUF_SCANOUT, MODESET_BUF_FREE);
+    }
+}
+
+/**
+ * @brief Keep the taken buffer for next try when commit fail, otherwise it becomes front_buf.
+ */
+static void modeset_finish_flip(struct modeset_dev *dev, int next, int ret)
+{
+    if (next != dev->front_buf)
+    {
+        if (ret < 0)
+            __atomic_store_n(&dev->bufs[next].state, MODESET_BUF_QUEUED, __ATOMIC_RELEASE);
+        else
         {
-            dev->front_buf ^= 1;
-            dev->pflip_pending = true;
-            usleep(16666);
+            dev->bufs[next].stamp.commit_ns = xDRM_Latency_Now();
+            dev->front_buf = next;
         }
     }
-#endif
+
+    if (ret >= 0)
+    {
+        dev->plane_dirty = false;
+        dev->scaled_front = dev->scaled_next;
+    }
 }
 
-static void modeset_cleanup(int fd, struct modeset_dev *dev)
+/**
+ * @brief Create FB_DAMAGE_CLIPS blob for flip from front_buf to next.
+ * @note Damage only holds against the frame submitted right before next, otherwise whole plane is updated.
+ */
+static void modeset_create_damage(int fd, struct modeset_dev *dev, int next)
 {
-    drmEventContext ev = {
-        .version = DRM_EVENT_CONTEXT_VERSION,
-        .page_flip_handler2 = page_flip_handler,
-    };
+    struct modeset_buf *buf = &dev->bufs[next];
+    struct drm_mode_rect clip;
 
-    dev->cleanup = true;
+    dev->damage_blob = 0;
 
-    while (dev->pflip_pending)
+    if (next == dev->front_buf || !buf->damage.width || !buf->damage.height)
+        return;
+
+    if (__atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE) != dev->bufs[dev->front_buf].seq + 1)
+        return;
+
+    clip.x1 = buf->damage.x;
+    clip.y1 = buf->damage.y;
+    clip.x2 = buf->damage.x + buf->damage.width;
+    clip.y2 = buf->damage.y + buf->damage.height;
+
+    if (xdrm_backend->create_property_blob(fd, &clip, sizeof(clip), &dev->damage_blob))
+        dev->damage_blob = 0;
+}
+
+/**
+ * @brief Kernel holds its own reference once committed, drop ours after commit.
+ */
+static void modeset_destroy_damage(int fd, struct modeset_dev *dev)
+{
+    if (dev->damage_blob)
     {
-        drmHandleEvent(fd, &ev);
+        xdrm_backend->destroy_property_blob(fd, dev->damage_blob);
+        dev->damage_blob = 0;
     }
+}
 
-    // Clean plane
-    drmModeAtomicReq *req = drmModeAtomicAlloc();
-    if (req)
+/**
+ * @brief Take the oldest submitted buffer, or show the current one again, and add it into req.
+ * 
+ * @return buffer index, or negative errno when prepare fail.
+ */
+static int modeset_prepare_page_flip(int fd, struct modeset_dev *dev, drmModeAtomicReq *req, bool present)
+{
+    int next, ret;
+
+    next = present ? modeset_take_queued(dev) : dev->front_buf;
+
+    if (dev->plane_props[MODESET_PLANE_FB_DAMAGE_CLIPS])
+        modeset_create_damage(fd, dev, next);
+
+    ret = modeset_atomic_prepare_flip(fd, dev, req, &dev->bufs[next], dev->damage_blob);
+    if (ret < 0)
     {
-        // Only clean plane, do nothing for CRTC
-        set_drm_object_property(req, &dev->plane, "FB_ID", 0);
-        set_drm_object_property(req, &dev->plane, "CRTC_ID", 0);
-        drmModeAtomicCommit(fd, req, DRM_MODE_ATOMIC_NONBLOCK, NULL);
-        drmModeAtomicFree(req);
+        modeset_destroy_damage(fd, dev);
+        modeset_finish_flip(dev, next, ret);
+        return ret;
     }
 
-    // fb
-    modeset_destroy_fb(fd, &dev->bufs[0]);
-    modeset_destroy_fb(fd, &dev->bufs[1]);
-    drmModeDestroyPropertyBlob(fd, dev->mode_blob_id);
-
-    // properties
-    for (int i = 0; i < dev->connector.props->count_props; i++)
-        drmModeFreeProperty(dev->connector.props_info[i]);
-    for (int i = 0; i < dev->crtc.props->count_props; i++)
-        drmModeFreeProperty(dev->crtc.props_info[i]);
-    for (int i = 0; i < dev->plane.props->count_props; i++)
-        drmModeFreeProperty(dev->plane.props_info[i]);
+    return next;
+}
 
-    free(dev->connector.props_info);
-    free(dev->crtc.props_info);
-    free(dev->plane.props_info);
+/**
+ * @brief An output is ready to flip when it is due and every CRTC showing its buffers completed last flip.
+ */
+static bool modeset_output_ready(struct modeset_dev *list, struct modeset_dev *dev)
+{
+    if (dev->mirror_of || dev->layer_of || !dev->pflip_due || dev->pflip_pending || dev->cleanup)
+        return false;
+
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if ((iter->mirror_of == dev || iter->layer_of == dev) && iter->pflip_pending)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief A frame or layout waits for dev, its mirrors or its layers.
+ */
+static bool modeset_has_new_frame(struct modeset_dev *list, struct modeset_dev *dev)
+{
+    uint32_t count;
 
-    drmModeFreeObjectProperties(dev->connector.props);
-    drmModeFreeObjectProperties(dev->crtc.props);
-    drmModeFreeObjectProperties(dev->plane.props);
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if (iter != dev && iter->mirror_of != dev && iter->layer_of != dev)
+            continue;
 
-    // mutex and user buffer
-    if (dev->data_buffer) {
-        free(dev->data_buffer);
-        dev->data_buffer = NULL;
+        if (__atomic_load_n(&iter->layout_seq, __ATOMIC_ACQUIRE) != iter->layout_applied)
+            return true;
+        if (!iter->mirror_of && modeset_oldest_queued(iter, &count) >= 0)
+            return true;
     }
-    pthread_mutex_destroy(&dev->buffer_mutex);
+
+    return false;
 }
 
-/* ====================================================================================================================== */
-/* ================================================== Section 4 : APIs ================================================== */
-/* ====================================================================================================================== */
+/**
+ * @brief Whether to queue a flip of dev after its last one completed, a present on push output with nothing new goes idle.
+ */
+static bool modeset_flip_wanted(struct modeset_dev *list, struct modeset_dev *dev)
+{
+    if (!__atomic_load_n(&dev->present_on_push, __ATOMIC_RELAXED) && !__atomic_load_n(&dev->async_flip, __ATOMIC_RELAXED))
+        return true;
 
-int xDRM_Init(struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
-    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset)
+    // idle before looking, a frame submitted after the look finds idle set and wakes the loop
+    __atomic_store_n(&dev->idle, true, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!modeset_has_new_frame(list, dev))
+        return false;
+
+    __atomic_store_n(&dev->idle, false, __ATOMIC_RELAXED);
+    return true;
+}
+
+/**
+ * @brief Draw loop was woken, queue flips of idle outputs which have something new again.
+ */
+static void modeset_wake_outputs(struct modeset_dev *list)
 {
-    int fd, ret;
-    
-    // Step 1 : Open Device
-    fd = open("/dev/dri/card0", O_RDWR | O_CLOEXEC);
-    if (fd < 0)
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
     {
-        fprintf(stderr, "Failed to open card: %s\n", strerror(errno));
-        return -1;
+        if (iter->mirror_of || iter->layer_of || iter->cleanup || iter->pflip_pending || iter->pflip_due)
+            continue;
+
+        iter->pflip_due = modeset_flip_wanted(list, iter);
+        iter->pflip_due_present = true;
     }
+}
 
-    // Step 2 : Init Atomic
-    ret = modeset_atomic_init(fd);
-    if (ret)
+/**
+ * @brief Add new frame of a layer into req, a layer with nothing new stays out of req.
+ * @note A layer which fails to prepare is skipped, it never holds back the video plane.
+ */
+static void modeset_prepare_layer(int fd, struct modeset_dev *layer, drmModeAtomicReq *req)
+{
+    int cursor = xdrm_backend->atomic_get_cursor(req);
+    int next, ret;
+
+    layer->layer_buf = -1;
+
+    // last flip of its output completed, so older buffers are off screen
+    modeset_retire_buffers(layer);
+    modeset_take_layout(layer);
+
+    next = modeset_take_queued(layer);
+    if (next == layer->front_buf && !layer->plane_dirty)
+        return;
+
+    if (layer->plane_props[MODESET_PLANE_FB_DAMAGE_CLIPS])
+        modeset_create_damage(fd, layer, next);
+
+    ret = modeset_atomic_prepare_flip(fd, layer, req, &layer->bufs[next], layer->damage_blob);
+    if (ret < 0)
     {
-        close(fd);
-        return -1;
+        modeset_destroy_damage(fd, layer);
+        modeset_finish_flip(layer, next, ret);
+        xdrm_backend->atomic_set_cursor(req, cursor);
+        return;
     }
 
-    // Step 3 : Malloc Memory
-    *dev = (struct modeset_dev *)malloc(sizeof(struct modeset_dev));
-    if (!*dev)
+    layer->layer_buf = next;
+}
+
+/**
+ * @brief Record result of commit on layers of dev which were in the request.
+ */
+static void modeset_finish_layers(int fd, struct modeset_dev *list, struct modeset_dev *dev, int ret)
+{
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
     {
-        close(fd);
-        return -1;
+        if (iter->layer_of != dev || iter->layer_buf < 0)
+            continue;
+
+        modeset_destroy_damage(fd, iter);
+        modeset_finish_flip(iter, iter->layer_buf, ret);
+        if (ret >= 0)
+            iter->pflip_pending = true;
+        iter->layer_buf = -1;
     }
-    memset(*dev, 0, sizeof(struct modeset_dev));
+}
 
-    // Step 4 : Setup Device
-    ret = modeset_setup_dev(fd, *dev, conn_id, crtc_id, plane_id, 
-                           source_width, source_height, x_offset, y_offset);
-    if (ret)
+/**
+ * @brief Add next flip of dev and of its mirrors into req, mirrors scan out the same buffer.
+ * @note Layers of dev go into the same request, so OSD and video change on the same vblank.
+ * 
+ * @return buffer index, or negative errno when prepare fail.
+ */
+static int modeset_prepare_output(int fd, struct modeset_dev *list, struct modeset_dev *dev, drmModeAtomicReq *req)
+{
+    int cursor = xdrm_backend->atomic_get_cursor(req);
+    int next, ret;
+
+    // last flip completed on every CRTC, so older buffers are off screen
+    modeset_retire_buffers(dev);
+
+    next = modeset_prepare_page_flip(fd, dev, req, dev->pflip_due_present);
+    if (next < 0)
     {
-        free(*dev);
-        close(fd);
-        return -1;
+        xdrm_backend->atomic_set_cursor(req, cursor);
+        return next;
     }
 
-    // Step 5 : Stepup Atomic
-    ret = modeset_atomic_modeset(fd, *dev);
-    if (ret)
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
     {
-        modeset_cleanup(fd, *dev);
-        free(*dev);
-        close(fd);
-        return -1;
-    }
+        if (iter->mirror_of != dev || iter->cleanup)
+            continue;
 
-    // Step 6 : Initialize data buffer
-    memset((*dev)->data_buffer, 0xFF000000, source_width * source_height * sizeof(uint32_t));
+        ret = modeset_atomic_prepare_flip(fd, iter, req, &dev->bufs[next], dev->damage_blob);
+        if (ret < 0)
+        {
+            modeset_destroy_damage(fd, dev);
+            modeset_finish_flip(dev, next, ret);
+            xdrm_backend->atomic_set_cursor(req, cursor);
+            return ret;
+        }
+    }
 
-    (*dev)->buffer_updated = true;
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if (iter->layer_of == dev && !iter->cleanup)
+            modeset_prepare_layer(fd, iter, req);
+    }
 
-    return fd;
+    return next;
 }
 
-void xDRM_Exit(int fd, struct modeset_dev *dev)
+/**
+ * @brief Record result of commit on dev, on its mirrors and on its layers.
+ */
+static void modeset_finish_output(int fd, struct modeset_dev *list, struct modeset_dev *dev, int next, int ret)
 {
-    modeset_cleanup(fd, dev);
-    free(dev);
-    close(fd);
+    // a flip without new frame either ran out of frames or was held back by pacer
+    if (ret >= 0)
+        modeset_count(next != dev->front_buf ? &dev->stats.presented :
+                      dev->pflip_due_present ? &dev->stats.repeated : &dev->stats.held, 1);
+
+    modeset_destroy_damage(fd, dev);
+    modeset_finish_flip(dev, next, ret);
+    modeset_finish_layers(fd, list, dev, ret);
+
+    dev->pflip_due = (ret == -EBUSY);
+    if (ret < 0)
+        return;
+
+    dev->pflip_pending = true;
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if (iter->mirror_of == dev && !iter->cleanup)
+        {
+            iter->pflip_pending = true;
+            iter->plane_dirty = false;
+            iter->scaled_front = iter->scaled_next;
+        }
+    }
 }
 
-void xDRM_Draw(int fd, struct modeset_dev *dev)
+/**
+ * @brief Flip next frame of an async output at once with DRM_MODE_PAGE_FLIP_ASYNC, scanout may tear.
+ * @note Kernel takes nothing but FB_ID in an async flip, so mirrors and layers are refused on it,
+ *       a change of plane state goes through a synced flip first, as does the first flip of xDRM_Draw.
+ * 
+ * @return whether dev was handled, false leaves it to the synced request.
+ */
+static bool modeset_async_flip(int fd, struct modeset_dev *list, struct modeset_dev *dev)
 {
-    struct pollfd fds[1];
-    int ret;
-    struct fps_stats fps_stats;
-    
-    // Init context
-    drmEventContext ev = {};
-    memset(&ev, 0, sizeof(ev));
-    ev.version = DRM_EVENT_CONTEXT_VERSION;
-    ev.page_flip_handler2 = page_flip_handler;
-    ev.vblank_handler = NULL;
-    
-    // Init FPS
-    xDRM_Init_FPS_Stats(&fps_stats);
-    
-    // Set DRM file descriptor
-    fds[0].fd = fd;
-    fds[0].events = POLLIN;
-    fds[0].revents = 0;
-    
-    // execute first atomic page flip
-re_flip:
-    ret = modeset_atomic_page_flip(fd, dev, dev->src_width, dev->src_height, dev->x_offset, dev->y_offset);
-    if (ret)
+    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_PAGE_FLIP_ASYNC;
+    drmModeAtomicReq *req = dev->flip_req;
+    struct timespec start, end;
+    uint32_t count;
+    int next, ret;
+
+    if (!__atomic_load_n(&dev->async_flip, __ATOMIC_ACQUIRE))
+        return false;
+
+    // last flip completed, so older buffers are off screen
+    modeset_retire_buffers(dev);
+    modeset_take_layout(dev);
+    if (dev->plane_dirty || dev->layout.cpu_scale || modeset_oldest_queued(dev, &count) < 0)
+        return false;
+
+    next = modeset_take_queued(dev);
+
+    // Step 1 : commit, legacy flip when driver has no atomic async flip
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (dev->async_legacy)
+        ret = xdrm_backend->page_flip(fd, dev->crtc.id, dev->bufs[next].fb, flags, list);
+    else
     {
-        fprintf(stderr, "Initial page flip failed: %s\n", strerror(errno));
-        goto re_flip;
+        xdrm_backend->atomic_set_cursor(req, 0);
+        ret = modeset_set_plane_prop(req, dev, MODESET_PLANE_FB_ID, dev->bufs[next].fb);
+        if (ret >= 0)
+            ret = modeset_atomic_commit(fd, req, flags | DRM_MODE_ATOMIC_NONBLOCK, list);
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    MODESET_TRACE(XDRM_TRACE_COMMIT, dev, next, (uint64_t)start.tv_sec * 1000000000ull + start.tv_nsec,
+                  (uint64_t)end.tv_sec * 1000000000ull + end.tv_nsec, ret);
 
-    dev->front_buf ^= 1;
-    dev->pflip_pending = true;
+    // Step 2 : result, the frame stays queued on failure
+    modeset_finish_output(fd, list, dev, next, ret);
 
-    // main loop
-    while (1)
+    // driver refuses async flip of this plane or framebuffer, go on vsynced
+    if (ret < 0 && ret != -EBUSY)
     {
-        fds[0].revents = 0;
+        fprintf(stderr, "Async flip on CRTC %u failed, back to vsync: %s\n", dev->crtc.id, strerror(-ret));
+        __atomic_store_n(&dev->async_flip, false, __ATOMIC_RELAXED);
+        dev->pflip_due = true;
+        dev->pflip_due_present = true;
+    }
 
-        ret = poll(fds, 1, -1);
-        if (ret < 0)
+    xDRM_Update_FPS_Commit_Time(&dev->fps_stats,
+        (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000);
+    xDRM_Latency_Record(&dev->latency[XDRM_LATENCY_COMMIT],
+        (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec);
+
+    return true;
+}
+
+/**
+ * @brief Queue flips of every output in list whose flip is due, without blocking.
+ * @note Outputs due on the same event dispatch go into one atomic request, so they flip together.
+ *       Completion comes back as one page flip event per CRTC, with list as user data.
+ */
+static void modeset_queue_flips(int fd, struct modeset_dev *list)
+{
+    uint32_t flags = DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK;
+    struct modeset_dev *due[MODESET_OUTPUT_MAX];
+    int next[MODESET_OUTPUT_MAX];
+    drmModeAtomicReq *req = NULL;
+    struct timespec start, end;
+    int count = 0, ret = 0;
+
+    // Step 1 : collect due outputs into one request
+    for (struct modeset_dev *dev = list; dev && count < MODESET_OUTPUT_MAX; dev = __atomic_load_n(&dev->next, __ATOMIC_ACQUIRE))
+    {
+        if (!modeset_output_ready(list, dev))
+            continue;
+
+        // an async output flips alone, out of the joint request
+        if (modeset_async_flip(fd, list, dev))
+            continue;
+
+        // rewind cached request of the first output, steady state flip only changes FB_ID
+        if (!req)
         {
-            if (errno == EINTR)
-                continue;
-            printf("poll failed: %s\n", strerror(errno));
-            break;
+            req = dev->flip_req;
+            xdrm_backend->atomic_set_cursor(req, 0);
         }
 
-        if (fds[0].revents & POLLIN)
+        next[count] = modeset_prepare_output(fd, list, dev, req);
+        if (next[count] < 0)
+            continue;
+        due[count++] = dev;
+    }
+
+    if (!count)
+        return;
+
+    // Step 2 : commit
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ret = modeset_atomic_commit(fd, req, flags, list);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (int i = 0; i < count; i++)
+        MODESET_TRACE(XDRM_TRACE_COMMIT, due[i], next[i], (uint64_t)start.tv_sec * 1000000000ull + start.tv_nsec,
+                      (uint64_t)end.tv_sec * 1000000000ull + end.tv_nsec, ret);
+
+    // Step 3 : a busy CRTC should not hold the others, so retry joint flip one by one
+    if (ret == -EBUSY && count > 1)
+    {
+        for (int i = 0; i < count; i++)
         {
-            ret = drmHandleEvent(fd, &ev);
-            if (ret != 0)
+            modeset_destroy_damage(fd, due[i]);
+            modeset_finish_flip(due[i], next[i], ret);
+            modeset_finish_layers(fd, list, due[i], ret);
+
+            req = due[i]->flip_req;
+            xdrm_backend->atomic_set_cursor(req, 0);
+            next[i] = modeset_prepare_output(fd, list, due[i], req);
+            if (next[i] < 0)
             {
-                printf("drmHandleEvent failed: %s\n", strerror(errno));
-                break;
+                due[i]->pflip_due = false;
+                continue;
             }
 
-            // Update FPS datas
-            xDRM_Update_FPS_Stats(&fps_stats);
+            ret = modeset_atomic_commit(fd, req, flags, list);
+            MODESET_TRACE(XDRM_TRACE_COMMIT, due[i], next[i], 0, 0, ret);
+            modeset_finish_output(fd, list, due[i], next[i], ret);
         }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+            modeset_finish_output(fd, list, due[i], next[i], ret);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        xDRM_Update_FPS_Commit_Time(&due[i]->fps_stats,
+            (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000);
+        xDRM_Latency_Record(&due[i]->latency[XDRM_LATENCY_COMMIT],
+            (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec);
     }
 }
 
-int xDRM_Push(struct modeset_dev *dev, uint32_t *data, size_t size)
+/* ====================================================================================================================== */
+/* ================================================== Section 4 : Wrap ================================================== */
+/* ====================================================================================================================== */
+
+static int modeset_setup_dev(int fd, struct xdrm_topology *topology, struct modeset_dev *dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
 {
-    if (!dev || !data || size != dev->src_width * dev->src_height * sizeof(uint32_t)) {
+    const struct modeset_format_info *info;
+    const struct xdrm_topology_connector *connector;
+    int i, ret;
+    
+    dev->fd = fd;
+    dev->topology = topology;
+    dev->connector.id = conn_id;
+    dev->crtc.id = crtc_id;
+    dev->plane.id = plane_id;
+    dev->format = format;
+
+    // Step 1 : checkout plane and negotiate format
+    ret = check_plane_capabilities(topology, dev);
+    if (ret < 0) {
+        fprintf(stderr, "Plane capability check failed\n");
+        return ret;
+    }
+
+    info = modeset_get_format_info(dev->format);
+    if (source_width % info->hsub || source_height % info->vsub)
+    {
+        fprintf(stderr, "Size %ux%u does not fit subsampling of format %.4s\n",
+                source_width, source_height, (const char *)&dev->format);
         return -EINVAL;
     }
 
-    pthread_mutex_lock(&dev->buffer_mutex);
-    
-    memcpy(dev->data_buffer, data, size);
-    dev->buffer_updated = true;
-    
-    pthread_mutex_unlock(&dev->buffer_mutex);
+    // Step 2 : get connector information, checked by step 1
+    connector = xDRM_Topology_Get_Connector(topology, dev->connector.id);
+
+    // Step 3 : get the current display mode
+    if (connector->connector->count_modes <= 0)
+    {
+        fprintf(stderr, "no valid mode for connector %u\n", dev->connector.id);
+        return -EFAULT;
+    }
     
+    memcpy(&dev->mode, &connector->connector->modes[0], sizeof(dev->mode));
+    xDRM_Init_Pacer(&dev->pacer, modeset_refresh_ns(&dev->mode), 0);
+
+    // Step 4 : set buffer display size, @note source!
+    dev->buf_count = buf_count;
+    dev->queue_depth = 1;
+    for (i = 0; i < dev->buf_count; i++)
+    {
+        dev->bufs[i].width = source_width;
+        dev->bufs[i].height = source_height;
+        dev->bufs[i].format = dev->format;
+        dev->bufs[i].dmabuf_fd = -1;
+        dev->bufs[i].state = MODESET_BUF_FREE;
+    }
+
+    // import slots stay empty until xDRM_ImportDmabuf
+    for (; i < modeset_buf_slots(dev); i++)
+    {
+        dev->bufs[i].dmabuf_fd = -1;
+        dev->bufs[i].state = MODESET_BUF_UNUSED;
+    }
+
+    // bufs[0] is shown by modeset, others are free for producer
+    dev->front_buf = 0;
+    dev->bufs[0].state = MODESET_BUF_SCANOUT;
+
+    dev->src_width = source_width;
+    dev->src_height = source_height;
+    dev->x_offset = x_offset;
+    dev->y_offset = y_offset;
+
+    // 1:1 at offset until xDRM_Set_Scale
+    dev->layout.src.width = source_width;
+    dev->layout.src.height = source_height;
+    dev->layout.crtc.x = (uint32_t)x_offset;
+    dev->layout.crtc.y = (uint32_t)y_offset;
+    dev->layout.crtc.width = source_width;
+    dev->layout.crtc.height = source_height;
+    dev->layout.alpha = 0xFFFF;
+    dev->layout_pending = dev->layout;
+    dev->layer_buf = -1;
+
+    // Step 5 : set property blob
+    ret = xdrm_backend->create_property_blob(fd, &dev->mode, sizeof(dev->mode),
+                                   &dev->mode_blob_id);
+    if (ret) {
+        fprintf(stderr, "cannot create mode blob: %m\n");
+        return ret;
+    }
+
+    // Step 6 : get properties, from snapshot
+    modeset_get_object_properties(&dev->connector, &connector->props);
+    modeset_get_object_properties(&dev->crtc, xDRM_Topology_Get_Crtc_Props(topology, dev->crtc.id));
+    modeset_get_object_properties(&dev->plane, &xDRM_Topology_Get_Plane(topology, dev->plane.id)->props);
+
+    ret = modeset_get_plane_props(dev);
+    if (ret)
+        goto err_props;
+
+    // Step 7 : allocate request reused by flips
+    dev->flip_req = xdrm_backend->atomic_alloc();
+    if (!dev->flip_req)
+    {
+        fprintf(stderr, "Failed to allocate atomic request\n");
+        ret = -ENOMEM;
+        goto err_props;
+    }
+    dev->plane_dirty = true;
+
+    // Step 8 : create frame buffer
+    for (i = 0; i < dev->buf_count; i++)
+    {
+        ret = modeset_create_fb(fd, &dev->bufs[i]);
+        if (ret)
+            goto err_fb;
+    }
+
     return 0;
-}
\ No newline at end of file
+
+err_fb:
+    while (i--)
+        modeset_destroy_fb(fd, &dev->bufs[i]);
+    xdrm_backend->atomic_free(dev->flip_req);
+err_props:
+    modeset_put_object_properties(&dev->connector);
+    modeset_put_object_properties(&dev->crtc);
+    modeset_put_object_properties(&dev->plane);
+    xdrm_backend->destroy_property_blob(fd, dev->mode_blob_id);
+    return ret;
+}
+
+static int modeset_atomic_modeset(int fd, struct modeset_dev *dev)
+{
+    int ret;
+    uint32_t flags;
+
+    drmModeAtomicReq *req = xdrm_backend->atomic_alloc();
+    if (!req) {
+        return -ENOMEM;
+    }
+
+    struct modeset_dev *source = modeset_source(dev);
+
+    ret = modeset_atomic_prepare_commit(fd, dev, req, &source->bufs[source->front_buf], &dev->layout);
+    if (ret < 0) {
+        xdrm_backend->atomic_free(req);
+        return ret;
+    }
+
+    // use the least privilege flag
+    flags = DRM_MODE_ATOMIC_NONBLOCK;
+    ret = xdrm_backend->atomic_commit(fd, req, flags, dev);
+    if (ret < 0) {
+        printf("Atomic modeset failed: %s\n", strerror(errno));
+    }
+    else {
+        dev->plane_dirty = false;
+    }
+
+    xdrm_backend->atomic_free(req);
+    return ret;
+}
+
+static int modeset_atomic_init(int fd)
+{
+    uint64_t cap;
+    int ret;
+
+    ret = xdrm_backend->get_cap(fd, DRM_CAP_CRTC_IN_VBLANK_EVENT, &cap);
+    if (ret || !cap)
+    {
+        fprintf(stderr, "Device does not support atomic modesetting\n");
+        return -ENOTSUP;
+    }
+
+    ret = xdrm_backend->set_client_cap(fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1);
+    if (ret)
+    {
+        fprintf(stderr, "Failed to set universal planes cap\n");
+        return ret;
+    }
+
+    ret = xdrm_backend->set_client_cap(fd, DRM_CLIENT_CAP_ATOMIC, 1);
+    if (ret)
+    {
+        fprintf(stderr, "Failed to set atomic cap\n");
+        return ret;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Count vblanks of dev by kernel sequence, print stats when logging is on and the interval passed.
+ */
+static void modeset_count_vblanks(struct modeset_dev *dev, unsigned int sequence, uint64_t vblank_ns)
+{
+    struct modeset_stats now;
+    uint32_t log_ms;
+
+    // a flip is queued for every vblank, a gap in sequence is vblanks the display side missed
+    if (dev->stats_sequence)
+    {
+        modeset_count(&dev->stats.vblanks, sequence - dev->stats_sequence);
+        if (sequence - dev->stats_sequence > 1 && !__atomic_load_n(&modeset_source(dev)->present_on_push, __ATOMIC_RELAXED) &&
+            !__atomic_load_n(&modeset_source(dev)->async_flip, __ATOMIC_RELAXED))
+        {
+            modeset_count(&dev->stats.missed_vblanks, sequence - dev->stats_sequence - 1);
+            MODESET_TRACE(XDRM_TRACE_MISSED, dev, -1, 0, vblank_ns, sequence - dev->stats_sequence - 1);
+        }
+    }
+    __atomic_store_n(&dev->stats_sequence, sequence, __ATOMIC_RELAXED);
+
+    log_ms = __atomic_load_n(&dev->stats_log_ms, __ATOMIC_RELAXED);
+    if (!log_ms || vblank_ns - dev->stats_log_ns < (uint64_t)log_ms * 1000000ull)
+        return;
+
+    // first interval only takes a baseline
+    xDRM_GetStats(dev, &now);
+    if (dev->stats_log_ns)
+    {
+        printf("Stats CRTC %u: vblanks %llu missed %llu presented %llu repeated %llu held %llu overwritten %llu busy %llu\n",
+               dev->crtc.id,
+               (unsigned long long)(now.vblanks - dev->stats_logged.vblanks),
+               (unsigned long long)(now.missed_vblanks - dev->stats_logged.missed_vblanks),
+               (unsigned long long)(now.presented - dev->stats_logged.presented),
+               (unsigned long long)(now.repeated - dev->stats_logged.repeated),
+               (unsigned long long)(now.held - dev->stats_logged.held),
+               (unsigned long long)(now.overwritten - dev->stats_logged.overwritten),
+               (unsigned long long)(now.busy - dev->stats_logged.busy));
+    }
+    dev->stats_logged = now;
+    dev->stats_log_ns = vblank_ns;
+}
+
+#if __ENABLE_PATTERN__
+static int frame_count_test_pattern = 0;
+#endif
+
+void page_flip_handler(int fd, unsigned int frame, unsigned int sec, unsigned int usec, unsigned int crtc_id, void *data)
+{
+    struct modeset_dev *list = (struct modeset_dev *)data;
+    struct modeset_dev *dev = list;
+    uint64_t vblank_ns = (uint64_t)sec * 1000000000ull + (uint64_t)usec * 1000ull;
+    uint64_t now_ns = xDRM_Latency_Now();
+    bool async;
+
+    // one event per CRTC, find output in list, layers share its CRTC
+    while (dev && (dev->crtc.id != crtc_id || dev->layer_of))
+        dev = __atomic_load_n(&dev->next, __ATOMIC_ACQUIRE);
+    if (!dev)
+        return;
+
+    dev->pflip_pending = false;
+    modeset_count_vblanks(dev, frame, vblank_ns);
+    MODESET_TRACE(XDRM_TRACE_FLIP, dev, modeset_source(dev)->front_buf, 0, vblank_ns, 0);
+
+    // an async flip latches mid scanout, its event carries the last vblank, so the frame is on glass by now
+    async = __atomic_load_n(&modeset_source(dev)->async_flip, __ATOMIC_RELAXED);
+    if (!dev->mirror_of)
+        modeset_record_latency(dev, async ? now_ns : vblank_ns);
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if (iter->layer_of != dev)
+            continue;
+
+        iter->pflip_pending = false;
+        MODESET_TRACE(XDRM_TRACE_FLIP, iter, iter->front_buf, 0, vblank_ns, 0);
+        modeset_record_latency(iter, vblank_ns);
+    }
+
+    if (now_ns > vblank_ns)
+        xDRM_Update_FPS_Wake_Time(&dev->fps_stats, (long)((now_ns - vblank_ns) / 1000));
+    xDRM_Update_FPS_Stats(&dev->fps_stats);
+
+    // a mirror flips along with its source, which is paced by its own event
+    if (!dev->cleanup && !dev->mirror_of)
+    {
+        // pace by vblank timestamp, no sleep on event thread, async flips are no vblanks
+        bool present = async || xDRM_Update_Pacer(&dev->pacer, frame, vblank_ns);
+
+#if __ENABLE_PATTERN__
+        // render pattern straight into a free buffer
+        uint8_t *map;
+        uint32_t stride;
+        bool argb = dev->format == DRM_FORMAT_ARGB8888 || dev->format == DRM_FORMAT_XRGB8888;
+        int index = present && argb ? xDRM_AcquireBuffer(dev, &map, &stride) : -1;
+        if (index >= 0)
+        {
+            xDRM_Pattern_Fill(map, stride, dev->src_width, dev->src_height, XDRM_PATTERN_CYCLE, frame_count_test_pattern++);
+            xDRM_SubmitBuffer(dev, index);
+        }
+#endif
+
+        // queued after dispatch, show the current buffer again when no new frame is due
+        dev->pflip_due = modeset_flip_wanted(list, dev);
+        dev->pflip_due_present = present || dev->present_on_push;
+    }
+}
+
+static void modeset_cleanup(int fd, struct modeset_dev *dev)
+{
+    drmEventContext ev = {
+        .version = DRM_EVENT_CONTEXT_VERSION,
+        .page_flip_handler2 = page_flip_handler,
+    };
+
+    dev->cleanup = true;
+
+    while (dev->pflip_pending)
+    {
+        xdrm_backend->handle_event(fd, &ev);
+    }
+
+    // Clean plane
+    drmModeAtomicReq *req = xdrm_backend->atomic_alloc();
+    if (req)
+    {
+        // Only clean plane, do nothing for CRTC
+        modeset_set_plane_prop(req, dev, MODESET_PLANE_FB_ID, 0);
+        modeset_set_plane_prop(req, dev, MODESET_PLANE_CRTC_ID, 0);
+        xdrm_backend->atomic_commit(fd, req, DRM_MODE_ATOMIC_NONBLOCK, NULL);
+        xdrm_backend->atomic_free(req);
+    }
+
+    // fb
+    for (int i = 0; i < dev->buf_count; i++)
+        modeset_destroy_fb(fd, &dev->bufs[i]);
+    for (int i = dev->buf_count; i < modeset_buf_slots(dev); i++)
+    {
+        if (dev->bufs[i].fb)
+            modeset_release_import(fd, dev, &dev->bufs[i]);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (dev->scaled[i].fb)
+            modeset_destroy_fb(fd, &dev->scaled[i]);
+        xDRM_Scale_Scratch_Free(&dev->scale_scratch[i]);
+    }
+    xdrm_backend->destroy_property_blob(fd, dev->mode_blob_id);
+    xdrm_backend->atomic_free(dev->flip_req);
+
+    // soft layers
+    for (uint32_t i = 0; i < dev->soft_layer_count; i++)
+    {
+        free(dev->soft_layers[i].pixels);
+        free(dev->soft_layers[i].tiles);
+    }
+    free(dev->soft_row);
+
+    // properties, topology is freed with the list
+    modeset_put_object_properties(&dev->connector);
+    modeset_put_object_properties(&dev->crtc);
+    modeset_put_object_properties(&dev->plane);
+}
+
+/**
+ * @brief Setup one output on an opened fd and modeset it.
+ * 
+ * @return 0 on success, negative errno on fail.
+ */
+static int modeset_add_output(int fd, struct xdrm_topology *topology, struct modeset_dev **dev, struct modeset_dev *mirror_of, struct modeset_dev *layer_of, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    int ret;
+
+    // a mirror scans out buffers of its source and allocates none
+    if (mirror_of)
+    {
+        buf_count = 0;
+        format = mirror_of->format;
+    }
+    else if (buf_count == 0)
+        buf_count = MODESET_BUF_DEFAULT;
+
+    if (!mirror_of && (buf_count < 2 || buf_count > MODESET_BUF_MAX))
+    {
+        fprintf(stderr, "Invalid buffer count %u, should be 2 ~ %d\n", buf_count, MODESET_BUF_MAX);
+        return -EINVAL;
+    }
+
+    // Step 1 : Malloc Memory
+    *dev = (struct modeset_dev *)malloc(sizeof(struct modeset_dev));
+    if (!*dev)
+        return -ENOMEM;
+    memset(*dev, 0, sizeof(struct modeset_dev));
+    (*dev)->mirror_of = mirror_of;
+    (*dev)->layer_of = layer_of;
+    (*dev)->wake_fd = -1;
+
+    // Step 2 : Setup Device
+    ret = modeset_setup_dev(fd, topology, *dev, conn_id, crtc_id, plane_id, 
+                           source_width, source_height, x_offset, y_offset, buf_count, format);
+    if (ret)
+    {
+        free(*dev);
+        *dev = NULL;
+        return ret;
+    }
+
+    // a layer is enabled by the first flip of its output
+    if (layer_of)
+        return 0;
+
+    // Step 3 : Stepup Atomic
+    ret = modeset_atomic_modeset(fd, *dev);
+    if (ret)
+    {
+        modeset_cleanup(fd, *dev);
+        free(*dev);
+        *dev = NULL;
+        return ret;
+    }
+
+    // first flip is queued by draw loop
+    (*dev)->pflip_due = !mirror_of;
+    (*dev)->pflip_due_present = true;
+
+    return 0;
+}
+
+/**
+ * @brief Find connector by name, or check conn_id when name is NULL, then fill CRTC and plane left 0
+ *        with free ones, those of outputs and layers in list are taken.
+ *
+ * @return 0 on success, -ENODEV on unknown connector, -EBUSY when no free CRTC or plane fits.
+ */
+static int modeset_resolve_output(const struct xdrm_topology *topology, struct modeset_dev *list, const char *name, uint32_t *conn_id,
+    uint32_t *crtc_id, uint32_t *plane_id, uint32_t format, enum xdrm_plane_type type)
+{
+    const struct xdrm_topology_connector *connector;
+    uint32_t used_planes[XDRM_TOPOLOGY_OBJECT_MAX];
+    uint32_t used_crtcs = 0, count = 0;
+    int index;
+
+    // Step 1 : connector
+    connector = name ? xDRM_Topology_Find_Connector(topology, name) : xDRM_Topology_Get_Connector(topology, *conn_id);
+    if (!connector)
+    {
+        if (name)
+            fprintf(stderr, "Unknown connector %s\n", name);
+        else
+            fprintf(stderr, "Unknown connector %u\n", *conn_id);
+        return -ENODEV;
+    }
+    *conn_id = connector->connector->connector_id;
+
+    for (struct modeset_dev *iter = list; iter; iter = iter->next)
+    {
+        index = xDRM_Topology_Crtc_Index(topology, iter->crtc.id);
+        if (index >= 0)
+            used_crtcs |= 1u << index;
+        if (count < XDRM_TOPOLOGY_OBJECT_MAX)
+            used_planes[count++] = iter->plane.id;
+    }
+
+    // Step 2 : CRTC, a layer comes with the one of its output
+    if (!*crtc_id)
+        *crtc_id = xDRM_Topology_Pick_Crtc(topology, connector, used_crtcs);
+
+    // Step 3 : plane
+    if (*crtc_id && !*plane_id)
+        *plane_id = xDRM_Topology_Pick_Plane(topology, *crtc_id, format, type, used_planes, count);
+
+    if (!*crtc_id || !*plane_id)
+    {
+        fprintf(stderr, "No free %s for connector %s\n", *crtc_id ? "plane" : "CRTC", connector->name);
+        return -EBUSY;
+    }
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Output %s: connector %u, CRTC %u, plane %u\n", connector->name, *conn_id, *crtc_id, *plane_id);
+#endif
+
+    return 0;
+}
+
+/* ====================================================================================================================== */
+/* ================================================== Section 5 : APIs ================================================== */
+/* ====================================================================================================================== */
+
+/**
+ * @brief Open device and setup first output, by connector name or by conn_id when name is NULL.
+ */
+static int modeset_init(struct modeset_dev **dev, const char *name, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    struct xdrm_topology *topology;
+    int fd, ret;
+
+    // Step 1 : Open Device, card0 or headless
+    fd = xDRM_Get_Backend()->open();
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open %s device: %s\n", xdrm_backend->name, strerror(errno));
+        return -1;
+    }
+
+    // Step 2 : Init Atomic
+    ret = modeset_atomic_init(fd);
+    if (ret)
+    {
+        xdrm_backend->close(fd);
+        return -1;
+    }
+
+    // Step 3 : snapshot topology once, every output on fd is set up from it
+    topology = xDRM_Topology_Create(fd);
+    if (!topology)
+    {
+        fprintf(stderr, "Failed to read display topology: %s\n", strerror(errno));
+        xdrm_backend->close(fd);
+        return -1;
+    }
+
+    // Step 4 : Setup first output
+    ret = modeset_resolve_output(topology, NULL, name, &conn_id, &crtc_id, &plane_id, format, XDRM_PLANE_PRIMARY);
+    if (!ret)
+        ret = modeset_add_output(fd, topology, dev, NULL, NULL, conn_id, crtc_id, plane_id, 
+                                 source_width, source_height, x_offset, y_offset, buf_count, format);
+    if (ret)
+    {
+        xDRM_Topology_Free(topology);
+        xdrm_backend->close(fd);
+        return -1;
+    }
+
+    // Step 5 : wakeup of draw loop, present on push and stop need it
+    (*dev)->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if ((*dev)->wake_fd < 0)
+        fprintf(stderr, "Failed to create eventfd: %s\n", strerror(errno));
+
+    return fd;
+}
+
+int xDRM_Init(struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    return modeset_init(dev, NULL, conn_id, crtc_id, plane_id, 
+                        source_width, source_height, x_offset, y_offset, buf_count, format);
+}
+
+int xDRM_Init_Connector(struct modeset_dev **dev, const char *connector, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    if (!connector)
+        return -1;
+
+    return modeset_init(dev, connector, 0, 0, 0, 
+                        source_width, source_height, x_offset, y_offset, buf_count, format);
+}
+
+/**
+ * @brief Setup an output on fd of list and link it at the tail of list.
+ */
+static int modeset_link_output(int fd, struct modeset_dev *list, struct modeset_dev **dev, struct modeset_dev *mirror_of, const char *name, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    struct modeset_dev *tail = list;
+    int count = 1, ret;
+
+    if (fd < 0 || !list || !dev)
+        return -EINVAL;
+
+    ret = modeset_resolve_output(list->topology, list, name, &conn_id, &crtc_id, &plane_id,
+                                 mirror_of ? mirror_of->format : format, XDRM_PLANE_PRIMARY);
+    if (ret)
+        return ret;
+
+    for (; tail->next; tail = tail->next)
+    {
+        if (tail->crtc.id == crtc_id || tail->plane.id == plane_id)
+            return -EBUSY;
+        count++;
+    }
+
+    if (tail->crtc.id == crtc_id || tail->plane.id == plane_id)
+        return -EBUSY;
+
+    if (count >= MODESET_OUTPUT_MAX)
+    {
+        fprintf(stderr, "Too many outputs, at most %d\n", MODESET_OUTPUT_MAX);
+        return -ENOSPC;
+    }
+
+    ret = modeset_add_output(fd, list->topology, dev, mirror_of, NULL, conn_id, crtc_id, plane_id, 
+                             source_width, source_height, x_offset, y_offset, buf_count, format);
+    if (ret)
+        return ret;
+    (*dev)->wake_fd = list->wake_fd;
+
+    // @note publish after setup, so the draw loop never sees a half built output
+    __atomic_store_n(&tail->next, *dev, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+int xDRM_Add_Output(int fd, struct modeset_dev *list, struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    return modeset_link_output(fd, list, dev, NULL, NULL, conn_id, crtc_id, plane_id, 
+                               source_width, source_height, x_offset, y_offset, buf_count, format);
+}
+
+int xDRM_Add_Output_Connector(int fd, struct modeset_dev *list, struct modeset_dev **dev, const char *connector, 
+    uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format)
+{
+    if (!connector)
+        return -EINVAL;
+
+    return modeset_link_output(fd, list, dev, NULL, connector, 0, 0, 0, 
+                               source_width, source_height, x_offset, y_offset, buf_count, format);
+}
+
+/**
+ * @brief Link a mirror of source, by connector name or by conn_id when name is NULL.
+ */
+static int modeset_link_mirror(int fd, struct modeset_dev *list, struct modeset_dev *source, struct modeset_dev **dev, 
+    const char *name, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, int x_offset, int y_offset)
+{
+    bool found = false;
+
+    if (!source)
+        return -EINVAL;
+
+    // source must be an output with buffers in the same list
+    for (struct modeset_dev *iter = list; iter; iter = iter->next)
+        found |= (iter == source);
+
+    if (!found || source->mirror_of)
+        return -EINVAL;
+
+    // an async flip carries one plane only
+    if (__atomic_load_n(&source->async_flip, __ATOMIC_RELAXED))
+        return -EBUSY;
+
+    return modeset_link_output(fd, list, dev, source, name, conn_id, crtc_id, plane_id, 
+                               source->src_width, source->src_height, x_offset, y_offset, 0, 0);
+}
+
+int xDRM_Add_Mirror(int fd, struct modeset_dev *list, struct modeset_dev *source, struct modeset_dev **dev, 
+    uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, int x_offset, int y_offset)
+{
+    return modeset_link_mirror(fd, list, source, dev, NULL, conn_id, crtc_id, plane_id, x_offset, y_offset);
+}
+
+int xDRM_Add_Mirror_Connector(int fd, struct modeset_dev *list, struct modeset_dev *source, struct modeset_dev **dev, 
+    const char *connector, int x_offset, int y_offset)
+{
+    if (!connector)
+        return -EINVAL;
+
+    return modeset_link_mirror(fd, list, source, dev, connector, 0, 0, 0, x_offset, y_offset);
+}
+
+int xDRM_Add_Layer(int fd, struct modeset_dev *list, struct modeset_dev *output, struct modeset_dev **layer, uint32_t plane_id,
+    uint32_t width, uint32_t height, int x_offset, int y_offset, uint32_t zpos, uint32_t buf_count, uint32_t format)
+{
+    struct modeset_dev *tail = NULL;
+    bool found = false;
+    int count = 0, ret;
+
+    if (fd < 0 || !list || !output || !layer || output->mirror_of || output->layer_of)
+        return -EINVAL;
+
+    // an async flip carries one plane only
+    if (__atomic_load_n(&output->async_flip, __ATOMIC_RELAXED))
+        return -EBUSY;
+
+    // Step 1 : output must be in list, plane must be free, 0 picks an overlay
+    if (!plane_id)
+    {
+        uint32_t conn_id = output->connector.id, crtc_id = output->crtc.id;
+
+        ret = modeset_resolve_output(list->topology, list, NULL, &conn_id, &crtc_id, &plane_id, format, XDRM_PLANE_OVERLAY);
+        if (ret)
+            return ret;
+    }
+
+    for (struct modeset_dev *iter = list; iter; iter = iter->next)
+    {
+        found |= (iter == output);
+        if (iter->plane.id == plane_id)
+            return -EBUSY;
+        if (iter->layer_of == output)
+            count++;
+        tail = iter;
+    }
+
+    if (!found)
+        return -EINVAL;
+
+    if (count >= MODESET_LAYER_MAX)
+    {
+        fprintf(stderr, "Too many layers on CRTC %u, at most %d\n", output->crtc.id, MODESET_LAYER_MAX);
+        return -ENOSPC;
+    }
+
+    // Step 2 : setup plane on CRTC of output
+    ret = modeset_add_output(fd, list->topology, layer, NULL, output, output->connector.id, output->crtc.id, plane_id,
+                             width, height, x_offset, y_offset, buf_count, format);
+    if (ret)
+        return ret;
+
+    (*layer)->layout.zpos = zpos;
+    (*layer)->layout_pending = (*layer)->layout;
+    (*layer)->wake_fd = list->wake_fd;
+
+    // Step 3 : kernel checks stacking and position against the whole CRTC
+    ret = modeset_test_layout(*layer, &(*layer)->bufs[0], &(*layer)->layout);
+    if (ret < 0)
+    {
+        fprintf(stderr, "Plane %u rejects layer %ux%u+%d+%d at zpos %u: %s\n",
+                plane_id, width, height, x_offset, y_offset, zpos, strerror(-ret));
+        (*layer)->cleanup = true;
+        modeset_cleanup(fd, *layer);
+        free(*layer);
+        *layer = NULL;
+        return ret;
+    }
+
+    // @note publish after setup, so the draw loop never sees a half built layer
+    __atomic_store_n(&tail->next, *layer, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void xDRM_Exit(int fd, struct modeset_dev *dev)
+{
+    struct modeset_dev *next;
+    struct xdrm_topology *topology = dev ? dev->topology : NULL;
+    int wake_fd = dev ? dev->wake_fd : -1;
+
+    // stop every output first, pending events of the whole list carry its head
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+        iter->cleanup = true;
+
+    // layers and mirrors leave their output before it is destroyed
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+        if (iter->layer_of)
+            modeset_cleanup(fd, iter);
+
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+        if (iter->mirror_of)
+            modeset_cleanup(fd, iter);
+
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+        if (!iter->mirror_of && !iter->layer_of)
+            modeset_cleanup(fd, iter);
+
+    for (; dev; dev = next)
+    {
+        next = dev->next;
+        free(dev);
+    }
+
+    if (wake_fd >= 0)
+        close(wake_fd);
+    xDRM_Topology_Free(topology);
+    xdrm_backend->close(fd);
+}
+
+/**
+ * @brief Apply realtime config of list to the display thread.
+ */
+static void modeset_apply_rt(struct modeset_dev *list)
+{
+    struct xdrm_rt_config thread = list->rt;
+
+    thread.lock_memory = false;
+    if (thread.priority || thread.cpus)
+        xDRM_RT_Apply(&thread);
+
+    if (!list->rt.lock_memory)
+        return;
+
+    if (!mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+#if __ENABLE_DEBUG_LOG__
+        printf("Memory locked\n");
+#endif
+        return;
+    }
+
+    // without the right to lock everything, lock at least what the flip path touches
+    fprintf(stderr, "mlockall failed: %s, locking buffers only\n", strerror(errno));
+    for (struct modeset_dev *iter = list; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        for (uint32_t i = 0; i < iter->buf_count; i++)
+        {
+            if (iter->bufs[i].map)
+                xDRM_RT_Lock(iter->bufs[i].map, iter->bufs[i].size);
+        }
+    }
+}
+
+void xDRM_Draw(int fd, struct modeset_dev *dev)
+{
+    struct pollfd fds[2];
+    uint64_t wakes;
+    int ret;
+    
+    // Init context
+    drmEventContext ev = {};
+    memset(&ev, 0, sizeof(ev));
+    ev.version = DRM_EVENT_CONTEXT_VERSION;
+    ev.page_flip_handler2 = page_flip_handler;
+    ev.vblank_handler = NULL;
+    
+    // Init FPS
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+        xDRM_Init_FPS_Stats(&iter->fps_stats);
+
+    // priority, affinity and memory lock of this thread
+    modeset_apply_rt(dev);
+    
+    // Set DRM file descriptor, and eventfd written by producers and xDRM_Stop_Draw
+    fds[0].fd = fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = dev->wake_fd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    
+    // execute first atomic page flip, every output in one request
+re_flip:
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+    {
+        iter->pflip_due = !iter->pflip_pending && !iter->mirror_of && !iter->layer_of;
+        iter->pflip_due_present = true;
+    }
+    modeset_queue_flips(fd, dev);
+
+    for (struct modeset_dev *iter = dev; iter; iter = iter->next)
+    {
+        // a layer with nothing to show stays out of the flip
+        if (iter->layer_of)
+            continue;
+
+        if (!iter->pflip_pending && !modeset_source(iter)->pflip_due)
+        {
+            fprintf(stderr, "Initial page flip failed on CRTC %u\n", iter->crtc.id);
+            goto re_flip;
+        }
+    }
+
+    // main loop, until xDRM_Stop_Draw
+    while (!__atomic_load_n(&dev->quit, __ATOMIC_ACQUIRE))
+    {
+        bool due = false;
+
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+
+        // wake up soon to retry a flip which hit EBUSY, otherwise wait for event
+        for (struct modeset_dev *iter = dev; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+            due |= iter->pflip_due;
+
+        ret = poll(fds, dev->wake_fd >= 0 ? 2 : 1, due ? 1 : -1);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            // every output flipped on this dispatch is marked due
+            ret = xdrm_backend->handle_event(fd, &ev);
+            if (ret != 0)
+            {
+                printf("drmHandleEvent failed: %s\n", strerror(errno));
+                break;
+            }
+        }
+
+        // a frame was pushed to an idle output, commit it now rather than on a flip event
+        if (fds[1].revents & POLLIN)
+        {
+            if (read(dev->wake_fd, &wakes, sizeof(wakes)) < 0 && errno != EAGAIN)
+                printf("eventfd read failed: %s\n", strerror(errno));
+            modeset_wake_outputs(dev);
+        }
+
+        modeset_queue_flips(fd, dev);
+    }
+}
+
+/**
+ * @brief Take back the oldest queued dumb buffer for a newer frame, its frame is dropped unseen.
+ * @note Display side may take the same buffer meanwhile, look again when CAS fails.
+ * 
+ * @return buffer index, or -1 when no dumb buffer is queued.
+ */
+static int modeset_reclaim_queued(struct modeset_dev *dev)
+{
+    for (;;)
+    {
+        int oldest = -1;
+        uint64_t seq = 0;
+
+        for (int i = 0; i < dev->buf_count; i++)
+        {
+            uint64_t buf_seq;
+
+            if (modeset_buf_state(&dev->bufs[i]) != MODESET_BUF_QUEUED)
+                continue;
+
+            buf_seq = __atomic_load_n(&dev->bufs[i].seq, __ATOMIC_ACQUIRE);
+            if (oldest < 0 || buf_seq < seq)
+            {
+                oldest = i;
+                seq = buf_seq;
+            }
+        }
+
+        if (oldest < 0)
+            return -1;
+
+        if (modeset_buf_cas(&dev->bufs[oldest], MODESET_BUF_QUEUED, MODESET_BUF_ACQUIRED))
+        {
+            modeset_count(&dev->stats.overwritten, 1);
+            MODESET_TRACE(XDRM_TRACE_DROP, dev, oldest, 0, 0, 0);
+            return oldest;
+        }
+    }
+}
+
+int xDRM_AcquireBuffer(struct modeset_dev *dev, uint8_t **map, uint32_t *stride)
+{
+    int index = -1;
+
+    if (!dev || !map) {
+        return -EINVAL;
+    }
+
+    // a mirror shows buffers of its source
+    dev = modeset_source(dev);
+
+    if (dev->cleanup) {
+        return -ENODEV;
+    }
+
+    for (int i = 0; i < dev->buf_count && index < 0; i++)
+    {
+        if (modeset_buf_cas(&dev->bufs[i], MODESET_BUF_FREE, MODESET_BUF_ACQUIRED))
+            index = i;
+    }
+
+    // nothing free, the newest frame wins over one still waiting
+    if (index < 0)
+        index = modeset_reclaim_queued(dev);
+
+    if (index >= 0)
+    {
+        modeset_stamp_acquire(&dev->bufs[index]);
+        *map = dev->bufs[index].map;
+        if (stride)
+            *stride = dev->bufs[index].stride;
+        return index;
+    }
+
+    // every buffer is on screen, in flight or being written, drop this frame instead of waiting
+    modeset_count(&dev->stats.busy, 1);
+    MODESET_TRACE(XDRM_TRACE_BUSY, dev, -1, 0, 0, 0);
+    return -EBUSY;
+}
+
+/**
+ * @brief Buffer holding the newest submitted frame, front buffer before the first submit.
+ */
+static int modeset_newest_buf(struct modeset_dev *dev)
+{
+    uint64_t seq, newest_seq = 0;
+    int newest = dev->front_buf;
+
+    for (int i = 0; i < modeset_buf_slots(dev); i++)
+    {
+        seq = __atomic_load_n(&dev->bufs[i].seq, __ATOMIC_ACQUIRE);
+        if (seq > newest_seq)
+        {
+            newest_seq = seq;
+            newest = i;
+        }
+    }
+
+    return newest;
+}
+
+/**
+ * @brief Region where buffer index differs from the newest frame, the damage of every frame submitted after its own.
+ * @note A frame in between whose buffer was written again is unknown, then the whole frame is stale.
+ */
+static void modeset_stale_rect(struct modeset_dev *dev, int index, uint64_t newest_seq, struct modeset_rect *stale)
+{
+    uint64_t base = __atomic_load_n(&dev->bufs[index].seq, __ATOMIC_ACQUIRE);
+    uint64_t seq, found = 0;
+
+    memset(stale, 0, sizeof(*stale));
+
+    for (int i = 0; i < modeset_buf_slots(dev); i++)
+    {
+        seq = __atomic_load_n(&dev->bufs[i].seq, __ATOMIC_ACQUIRE);
+        if (i == index || seq <= base || seq > newest_seq)
+            continue;
+
+        modeset_rect_union(stale, &dev->bufs[i].damage);
+        found++;
+    }
+
+    // seqs are unique, a gap means some frame is no longer held by any buffer
+    if (newest_seq > base && found != newest_seq - base)
+    {
+        stale->x = 0;
+        stale->y = 0;
+        stale->width = dev->src_width;
+        stale->height = dev->src_height;
+    }
+}
+
+/**
+ * @brief Queue an acquired buffer whose damage against the frame submitted before it is known.
+ */
+static int modeset_submit_buffer(struct modeset_dev *dev, int index, const struct modeset_rect *damage)
+{
+    uint64_t seq;
+
+    if (modeset_buf_state(&dev->bufs[index]) != MODESET_BUF_ACQUIRED) {
+        return -EINVAL;
+    }
+
+    dev->bufs[index].damage = *damage;
+    dev->bufs[index].stamp.submit_ns = xDRM_Latency_Now();
+
+    seq = __atomic_add_fetch(&dev->submit_seq, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&dev->bufs[index].seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&dev->bufs[index].state, MODESET_BUF_QUEUED, __ATOMIC_RELEASE);
+    MODESET_TRACE(XDRM_TRACE_COPY, dev, index, dev->bufs[index].stamp.acquire_ns, dev->bufs[index].stamp.submit_ns, 0);
+    MODESET_TRACE(XDRM_TRACE_PUSH, dev, index, 0, dev->bufs[index].stamp.submit_ns, 0);
+
+    // drop the oldest frames which fall out of the queue
+    modeset_trim_queue(dev);
+    modeset_wake(dev);
+
+    return 0;
+}
+
+int xDRM_SubmitBuffer(struct modeset_dev *dev, int index)
+{
+    struct modeset_rect full = {0, 0, 0, 0};
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || index < 0 || index >= modeset_buf_slots(dev)) {
+        return -EINVAL;
+    }
+
+    // producer may have written anywhere
+    full.width = dev->src_width;
+    full.height = dev->src_height;
+
+    return modeset_submit_buffer(dev, index, &full);
+}
+
+int xDRM_ImportDmabuf(struct modeset_dev *dev, int dmabuf_fd, uint32_t format, uint32_t stride, uint32_t offset)
+{
+    const struct modeset_format_info *info;
+    struct modeset_buf *buf;
+    uint32_t row, rows;
+    int i, ret;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || dmabuf_fd < 0) {
+        return -EINVAL;
+    }
+
+    if (dev->cleanup) {
+        return -ENODEV;
+    }
+
+    // Step 1 : cached, hand the slot out again once it is off screen
+    for (i = dev->buf_count; i < modeset_buf_slots(dev); i++)
+    {
+        buf = &dev->bufs[i];
+        if (__atomic_load_n(&buf->dmabuf_fd, __ATOMIC_ACQUIRE) != dmabuf_fd)
+            continue;
+
+        if (!modeset_buf_cas(buf, MODESET_BUF_FREE, MODESET_BUF_ACQUIRED))
+        {
+            modeset_count(&dev->stats.busy, 1);
+            MODESET_TRACE(XDRM_TRACE_BUSY, dev, -1, 0, 0, 0);
+            return -EBUSY;
+        }
+
+        // slot may be released and reused between lookup and CAS
+        if (buf->dmabuf_fd != dmabuf_fd)
+        {
+            __atomic_store_n(&buf->state, MODESET_BUF_FREE, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        if (buf->format != format || buf->pitches[0] != stride || buf->offsets[0] != offset)
+        {
+            __atomic_store_n(&buf->state, MODESET_BUF_FREE, __ATOMIC_RELEASE);
+            return -EINVAL;
+        }
+
+        modeset_stamp_acquire(buf);
+        return i;
+    }
+
+    // Step 2 : check layout, and format on every plane which shows this output
+    info = modeset_get_format_info(format);
+    if (!info) {
+        return -EINVAL;
+    }
+
+    modeset_plane_size(info, 0, dev->src_width, dev->src_height, &row, &rows);
+    if (stride < row || dev->src_width % info->hsub || dev->src_height % info->vsub) {
+        return -EINVAL;
+    }
+
+    for (struct modeset_dev *iter = dev; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if ((iter == dev || iter->mirror_of == dev) && !xDRM_Topology_Plane_Has_Format(dev->topology, iter->plane.id, format))
+        {
+            fprintf(stderr, "Plane %u does not support format %.4s\n", iter->plane.id, (const char *)&format);
+            return -EINVAL;
+        }
+    }
+
+    // Step 3 : import into an empty slot
+    for (i = dev->buf_count; i < modeset_buf_slots(dev); i++)
+    {
+        if (modeset_buf_cas(&dev->bufs[i], MODESET_BUF_UNUSED, MODESET_BUF_ACQUIRED))
+            break;
+    }
+
+    if (i == modeset_buf_slots(dev)) {
+        return -ENOSPC;
+    }
+
+    buf = &dev->bufs[i];
+    buf->width = dev->src_width;
+    buf->height = dev->src_height;
+    buf->format = format;
+
+    ret = modeset_import_fb(dev->fd, buf, dmabuf_fd, stride, offset);
+    if (ret < 0)
+    {
+        __atomic_store_n(&buf->state, MODESET_BUF_UNUSED, __ATOMIC_RELEASE);
+        return ret;
+    }
+
+    // publish key last, lookups recheck it after taking the slot
+    __atomic_store_n(&buf->dmabuf_fd, dmabuf_fd, __ATOMIC_RELEASE);
+
+    modeset_stamp_acquire(buf);
+    return i;
+}
+
+int xDRM_ReleaseDmabuf(struct modeset_dev *dev, int dmabuf_fd)
+{
+    struct modeset_buf *buf;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || dmabuf_fd < 0) {
+        return -EINVAL;
+    }
+
+    for (int i = dev->buf_count; i < modeset_buf_slots(dev); i++)
+    {
+        buf = &dev->bufs[i];
+        if (__atomic_load_n(&buf->dmabuf_fd, __ATOMIC_ACQUIRE) != dmabuf_fd)
+            continue;
+
+        // on screen or queued, kernel still reads it
+        if (!modeset_buf_cas(buf, MODESET_BUF_FREE, MODESET_BUF_ACQUIRED))
+            return -EBUSY;
+
+        if (buf->dmabuf_fd != dmabuf_fd)
+        {
+            __atomic_store_n(&buf->state, MODESET_BUF_FREE, __ATOMIC_RELEASE);
+            continue;
+        }
+
+        __atomic_store_n(&buf->dmabuf_fd, -1, __ATOMIC_RELEASE);
+        modeset_release_import(dev->fd, dev, buf);
+        __atomic_store_n(&buf->state, MODESET_BUF_UNUSED, __ATOMIC_RELEASE);
+
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+/**
+ * @brief Place source on the mode of dev.
+ */
+static int modeset_compute_layout(struct modeset_dev *dev, enum modeset_scale mode, const struct modeset_rect *rect, struct modeset_layout *layout)
+{
+    const struct modeset_format_info *info = modeset_get_format_info(dev->format);
+    uint32_t mode_width = dev->mode.hdisplay;
+    uint32_t mode_height = dev->mode.vdisplay;
+    uint32_t width = dev->src_width;
+    uint32_t height = dev->src_height;
+    uint32_t factor;
+
+    memset(layout, 0, sizeof(*layout));
+    layout->src.width = width;
+    layout->src.height = height;
+
+    switch (mode)
+    {
+        case MODESET_SCALE_NONE:
+            layout->crtc.x = (uint32_t)dev->x_offset;
+            layout->crtc.y = (uint32_t)dev->y_offset;
+            layout->crtc.width = width;
+            layout->crtc.height = height;
+            break;
+        case MODESET_SCALE_FIT:
+            if ((uint64_t)mode_width * height <= (uint64_t)mode_height * width)
+            {
+                layout->crtc.width = mode_width;
+                layout->crtc.height = (uint64_t)height * mode_width / width;
+            }
+            else
+            {
+                layout->crtc.width = (uint64_t)width * mode_height / height;
+                layout->crtc.height = mode_height;
+            }
+            break;
+        case MODESET_SCALE_FILL:
+            layout->crtc.width = mode_width;
+            layout->crtc.height = mode_height;
+
+            // crop the longer side of source, keep crop on subsampling grid
+            if ((uint64_t)mode_width * height >= (uint64_t)mode_height * width)
+                layout->src.height = (uint64_t)width * mode_height / mode_width;
+            else
+                layout->src.width = (uint64_t)height * mode_width / mode_height;
+
+            layout->src.width -= layout->src.width % info->hsub;
+            layout->src.height -= layout->src.height % info->vsub;
+            layout->src.x = (width - layout->src.width) / 2;
+            layout->src.y = (height - layout->src.height) / 2;
+            layout->src.x -= layout->src.x % info->hsub;
+            layout->src.y -= layout->src.y % info->vsub;
+            break;
+        case MODESET_SCALE_INTEGER:
+            factor = mode_width / width < mode_height / height ? mode_width / width : mode_height / height;
+            if (!factor)
+                return -ERANGE;
+
+            layout->crtc.width = width * factor;
+            layout->crtc.height = height * factor;
+            break;
+        case MODESET_SCALE_RECT:
+            if (!rect || !rect->width || !rect->height ||
+                rect->x + rect->width > mode_width || rect->y + rect->height > mode_height)
+                return -EINVAL;
+
+            layout->crtc = *rect;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    // centre, letterbox bars show CRTC background
+    if (mode == MODESET_SCALE_FIT || mode == MODESET_SCALE_INTEGER)
+    {
+        layout->crtc.x = (mode_width - layout->crtc.width) / 2;
+        layout->crtc.y = (mode_height - layout->crtc.height) / 2;
+    }
+
+    if (!layout->crtc.width || !layout->crtc.height || !layout->src.width || !layout->src.height)
+        return -EINVAL;
+
+    return 0;
+}
+
+/**
+ * @brief Allocate two mode sized buffers for CPU scaling and row scratch per plane, kept until cleanup.
+ */
+static int modeset_create_scaled(struct modeset_dev *dev)
+{
+    const struct modeset_format_info *info = modeset_get_format_info(dev->format);
+    int i, ret;
+
+    if (dev->scaled[0].fb)
+        return 0;
+
+    if (dev->mode.hdisplay % info->hsub || dev->mode.vdisplay % info->vsub)
+        return -EINVAL;
+
+    // rows are never wider than the mode, so the flip path does no allocation
+    for (i = 0; i < (int)info->planes; i++)
+    {
+        ret = xDRM_Scale_Scratch_Alloc(&dev->scale_scratch[i], dev->mode.hdisplay);
+        if (ret)
+        {
+            while (i--)
+                xDRM_Scale_Scratch_Free(&dev->scale_scratch[i]);
+            return ret;
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        dev->scaled[i].width = dev->mode.hdisplay;
+        dev->scaled[i].height = dev->mode.vdisplay;
+        dev->scaled[i].format = dev->format;
+        dev->scaled[i].dmabuf_fd = -1;
+        dev->scaled_seq[i] = UINT64_MAX;
+
+        ret = modeset_create_fb(dev->fd, &dev->scaled[i]);
+        if (ret)
+        {
+            while (i--)
+            {
+                modeset_destroy_fb(dev->fd, &dev->scaled[i]);
+                dev->scaled[i].fb = 0;
+            }
+            for (i = 0; i < 2; i++)
+                xDRM_Scale_Scratch_Free(&dev->scale_scratch[i]);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Hand layout to display side, which takes it by modeset_take_layout on next flip.
+ * @note One writer at a time, layout_seq is odd while layout_pending is written.
+ */
+static void modeset_publish_layout(struct modeset_dev *dev, const struct modeset_layout *layout)
+{
+    uint32_t seq = dev->layout_seq;
+
+    __atomic_store_n(&dev->layout_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    dev->layout_pending = *layout;
+    __atomic_store_n(&dev->layout_seq, seq + 2, __ATOMIC_RELEASE);
+
+    modeset_wake(dev);
+}
+
+int xDRM_Set_Scale(struct modeset_dev *dev, enum modeset_scale mode, const struct modeset_rect *rect)
+{
+    const struct modeset_format_info *info;
+    struct modeset_layout layout;
+    int ret;
+
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    if (dev->cleanup) {
+        return -ENODEV;
+    }
+
+    // Step 1 : place source on CRTC, stacking is kept
+    ret = modeset_compute_layout(dev, mode, rect, &layout);
+    if (ret < 0) {
+        return ret;
+    }
+    layout.zpos = dev->layout_pending.zpos;
+    layout.alpha = dev->layout_pending.alpha;
+
+    // Step 2 : let the plane scale, checked by a TEST_ONLY commit
+    ret = modeset_test_layout(dev, &modeset_source(dev)->bufs[0], &layout);
+
+    // Step 3 : plane refused, scale by CPU and show the result 1:1
+    if (ret < 0 && (layout.src.width != layout.crtc.width || layout.src.height != layout.crtc.height))
+    {
+#if __ENABLE_DEBUG_LOG__
+        printf("Plane %u cannot scale %ux%u to %ux%u, scale by CPU\n", dev->plane.id,
+               layout.src.width, layout.src.height, layout.crtc.width, layout.crtc.height);
+#endif
+        info = modeset_get_format_info(dev->format);
+        layout.crtc.width -= layout.crtc.width % info->hsub;
+        layout.crtc.height -= layout.crtc.height % info->vsub;
+        layout.cpu_scale = true;
+
+        ret = modeset_create_scaled(dev);
+        if (ret == 0)
+            ret = modeset_test_layout(dev, &dev->scaled[0], &layout);
+    }
+
+    if (ret < 0)
+    {
+        fprintf(stderr, "Plane %u rejects layout %ux%u+%u+%u: %s\n", dev->plane.id,
+                layout.crtc.width, layout.crtc.height, layout.crtc.x, layout.crtc.y, strerror(-ret));
+        return ret;
+    }
+
+    // Step 4 : publish, display side takes it on next flip
+    modeset_publish_layout(dev, &layout);
+
+    return 0;
+}
+
+int xDRM_Set_Layer_Alpha(struct modeset_dev *layer, uint16_t alpha)
+{
+    struct modeset_layout layout;
+
+    if (!layer || !layer->layer_of) {
+        return -EINVAL;
+    }
+
+    if (!layer->plane_props[MODESET_PLANE_ALPHA]) {
+        return -ENOTSUP;
+    }
+
+    layout = layer->layout_pending;
+    layout.alpha = alpha;
+    modeset_publish_layout(layer, &layout);
+
+    return 0;
+}
+
+int xDRM_Add_Soft_Layer(struct modeset_dev *dev, uint32_t width, uint32_t height, uint32_t x_offset, uint32_t y_offset)
+{
+    struct xdrm_blend_layer *layer;
+    uint32_t tiles_y;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || dev->layer_of || !width || !height) {
+        return -EINVAL;
+    }
+
+    // composed in 32bit RGB, the alpha or padding byte of video is kept by the blend rule
+    if (dev->format != DRM_FORMAT_ARGB8888 && dev->format != DRM_FORMAT_XRGB8888) {
+        return -ENOTSUP;
+    }
+
+    if (x_offset + width > dev->src_width || y_offset + height > dev->src_height) {
+        return -EINVAL;
+    }
+
+    if (dev->soft_layer_count >= MODESET_LAYER_MAX) {
+        return -ENOSPC;
+    }
+
+    if (!dev->soft_row)
+    {
+        dev->soft_row = (uint32_t *)malloc(dev->src_width * 4);
+        if (!dev->soft_row)
+            return -ENOMEM;
+    }
+
+    // starts fully transparent, every tile is skipped until first update
+    layer = &dev->soft_layers[dev->soft_layer_count];
+    layer->width = width;
+    layer->height = height;
+    layer->x = x_offset;
+    layer->y = y_offset;
+    layer->tiles_x = (width + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE;
+    tiles_y = (height + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE;
+    layer->pixels = (uint32_t *)calloc((size_t)width * height, 4);
+    layer->tiles = (uint8_t *)calloc((size_t)layer->tiles_x * tiles_y, 1);
+    if (!layer->pixels || !layer->tiles)
+    {
+        free(layer->pixels);
+        free(layer->tiles);
+        memset(layer, 0, sizeof(*layer));
+        return -ENOMEM;
+    }
+
+    return dev->soft_layer_count++;
+}
+
+int xDRM_Update_Soft_Layer(struct modeset_dev *dev, int index, const uint32_t *data, uint32_t stride, bool premultiplied)
+{
+    struct xdrm_blend_layer *layer;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || !data || index < 0 || (uint32_t)index >= dev->soft_layer_count) {
+        return -EINVAL;
+    }
+
+    layer = &dev->soft_layers[index];
+    if (stride < layer->width * 4) {
+        return -EINVAL;
+    }
+
+    xDRM_Blend_Load(layer, data, stride, premultiplied);
+
+    return 0;
+}
+
+int xDRM_Set_Target_FPS(struct modeset_dev *dev, uint32_t fps)
+{
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    // a mirror shows buffers of its source
+    dev = modeset_source(dev);
+
+    __atomic_store_n(&dev->pacer.target_fps, fps, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int xDRM_Wait_Present(struct modeset_dev *dev)
+{
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    // a mirror shows buffers of its source
+    dev = modeset_source(dev);
+
+    // a frame is flipped when pushed, producer keeps its rate but not the vblank phase
+    if (__atomic_load_n(&dev->async_flip, __ATOMIC_RELAXED))
+        xDRM_Wait_Pacer_Interval(&dev->pacer);
+    else
+        xDRM_Wait_Pacer(&dev->pacer);
+
+    return 0;
+}
+
+int xDRM_Set_Queue_Depth(struct modeset_dev *dev, uint32_t depth)
+{
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || depth < 1 || depth >= dev->buf_count) {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&dev->queue_depth, depth, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int xDRM_Get_Buffer_Stats(struct modeset_dev *dev, struct modeset_buf_stats *stats)
+{
+    if (!dev || !stats) {
+        return -EINVAL;
+    }
+
+    // a mirror shows buffers of its source
+    dev = modeset_source(dev);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->count = dev->buf_count;
+    stats->queue_depth = __atomic_load_n(&dev->queue_depth, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < modeset_buf_slots(dev); i++)
+        stats->state[modeset_buf_state(&dev->bufs[i])]++;
+
+    return 0;
+}
+
+int xDRM_PushPlanes(struct modeset_dev *dev, const uint8_t *const data[], const uint32_t strides[])
+{
+    uint64_t push_ns = xDRM_Latency_Now();
+    const struct modeset_format_info *info;
+    struct modeset_buf *buf;
+    uint32_t row, rows;
+    uint8_t *map;
+    int index;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || !data || !strides) {
+        return -EINVAL;
+    }
+
+    info = modeset_get_format_info(dev->format);
+    for (int n = 0; n < info->planes; n++)
+    {
+        modeset_plane_size(info, n, dev->src_width, dev->src_height, &row, &rows);
+        if (!data[n] || strides[n] < row) {
+            return -EINVAL;
+        }
+    }
+
+    index = xDRM_AcquireBuffer(dev, &map, NULL);
+    if (index < 0) {
+        return index;
+    }
+
+    // dumb buffer pitch may be padded, copy by row with streaming stores
+    buf = &dev->bufs[index];
+    buf->stamp.push_ns = push_ns;
+    if (dev->soft_layer_count)
+    {
+        xDRM_Blend_Compose(map, buf->stride, data[0], strides[0], 0, 0, dev->src_width, dev->src_height,
+                           dev->soft_layers, dev->soft_layer_count, dev->soft_row);
+        return xDRM_SubmitBuffer(dev, index);
+    }
+
+    for (int n = 0; n < info->planes; n++)
+    {
+        modeset_plane_size(info, n, dev->src_width, dev->src_height, &row, &rows);
+        xDRM_Copy(map + buf->offsets[n], buf->pitches[n], data[n], strides[n], row, rows);
+    }
+
+    return xDRM_SubmitBuffer(dev, index);
+}
+
+int xDRM_Push(struct modeset_dev *dev, uint32_t *data, size_t size)
+{
+    const struct modeset_format_info *info;
+    const uint8_t *planes[4] = {NULL};
+    uint32_t strides[4] = {0};
+    uint32_t row, rows;
+    size_t offset = 0;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || !data) {
+        return -EINVAL;
+    }
+
+    // planes are packed one after another without padding
+    info = modeset_get_format_info(dev->format);
+    for (int n = 0; n < info->planes; n++)
+    {
+        modeset_plane_size(info, n, dev->src_width, dev->src_height, &row, &rows);
+        planes[n] = (const uint8_t *)data + offset;
+        strides[n] = row;
+        offset += (size_t)row * rows;
+    }
+
+    if (size != offset) {
+        return -EINVAL;
+    }
+
+    return xDRM_PushPlanes(dev, planes, strides);
+}
+
+int xDRM_PushRegion(struct modeset_dev *dev, const struct modeset_rect *rect, const uint32_t *data, uint32_t stride)
+{
+    uint64_t push_ns = xDRM_Latency_Now();
+    const struct modeset_format_info *info;
+    struct modeset_buf *buf, *last;
+    struct modeset_rect stale;
+    uint32_t cpp;
+    uint8_t *map;
+    int index, newest;
+
+    if (dev)
+        dev = modeset_source(dev);
+
+    if (!dev || !rect || !data || !rect->width || !rect->height) {
+        return -EINVAL;
+    }
+
+    // only packed single plane formats, YUYV holds two pixels per macropixel
+    info = modeset_get_format_info(dev->format);
+    if (info->planes != 1) {
+        return -ENOTSUP;
+    }
+
+    // pixels outside rect are carried forward by CPU, an imported frame has no mapping
+    newest = modeset_newest_buf(dev);
+    if (!dev->bufs[newest].map) {
+        return -ENOTSUP;
+    }
+
+    cpp = info->cpp[0];
+    if (rect->x % info->hsub || rect->width % info->hsub) {
+        return -EINVAL;
+    }
+
+    if (rect->x + rect->width > dev->src_width || rect->y + rect->height > dev->src_height || stride < rect->width * cpp) {
+        return -EINVAL;
+    }
+
+    index = xDRM_AcquireBuffer(dev, &map, NULL);
+    if (index < 0) {
+        return index;
+    }
+
+    buf = &dev->bufs[index];
+    buf->stamp.push_ns = push_ns;
+    last = &dev->bufs[newest];
+    modeset_stale_rect(dev, index, __atomic_load_n(&last->seq, __ATOMIC_ACQUIRE), &stale);
+
+    // Step 1 : carry forward pixels this buffer missed, unless the new region covers them
+    if (stale.width && stale.height && index != newest &&
+        !(stale.x >= rect->x && stale.y >= rect->y &&
+          stale.x + stale.width <= rect->x + rect->width && stale.y + stale.height <= rect->y + rect->height))
+    {
+        xDRM_Copy(map + stale.y * buf->stride + stale.x * cpp, buf->stride,
+                  last->map + stale.y * last->stride + stale.x * cpp, last->stride,
+                  stale.width * cpp, stale.height);
+    }
+
+    // Step 2 : copy damaged region, soft layers are composed over it on the way
+    if (dev->soft_layer_count)
+        xDRM_Blend_Compose(map + rect->y * buf->stride + rect->x * cpp, buf->stride, (const uint8_t *)data, stride,
+                           rect->x, rect->y, rect->width, rect->height, dev->soft_layers, dev->soft_layer_count, dev->soft_row);
+    else
+        xDRM_Copy(map + rect->y * buf->stride + rect->x * cpp, buf->stride, (const uint8_t *)data, stride,
+                  rect->width * cpp, rect->height);
+
+    // Step 3 : queue, rect goes to kernel as FB_DAMAGE_CLIPS
+    return modeset_submit_buffer(dev, index, rect);
+}
+
+int xDRM_GetLatencyStats(struct modeset_dev *dev, struct modeset_latency_stats *stats)
+{
+    if (!dev || !stats) {
+        return -EINVAL;
+    }
+
+    // a mirror shows buffers of its source
+    dev = modeset_source(dev);
+
+    for (int i = 0; i < XDRM_LATENCY_STAGE_NUM; i++)
+        xDRM_Latency_Summarize(&dev->latency[i], &stats->stage[i]);
+
+    return 0;
+}
+
+int xDRM_ResetLatencyStats(struct modeset_dev *dev)
+{
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    dev = modeset_source(dev);
+
+    for (int i = 0; i < XDRM_LATENCY_STAGE_NUM; i++)
+        xDRM_Latency_Reset(&dev->latency[i]);
+
+    return 0;
+}
+
+int xDRM_GetStats(struct modeset_dev *dev, struct modeset_stats *stats)
+{
+    struct modeset_dev *source;
+
+    if (!dev || !stats) {
+        return -EINVAL;
+    }
+
+    // vblanks are counted per CRTC, frames by the output owning the buffers
+    source = modeset_source(dev);
+
+    stats->vblanks = __atomic_load_n(&dev->stats.vblanks, __ATOMIC_RELAXED);
+    stats->missed_vblanks = __atomic_load_n(&dev->stats.missed_vblanks, __ATOMIC_RELAXED);
+    stats->presented = __atomic_load_n(&source->stats.presented, __ATOMIC_RELAXED);
+    stats->repeated = __atomic_load_n(&source->stats.repeated, __ATOMIC_RELAXED);
+    stats->held = __atomic_load_n(&source->stats.held, __ATOMIC_RELAXED);
+    stats->overwritten = __atomic_load_n(&source->stats.overwritten, __ATOMIC_RELAXED);
+    stats->busy = __atomic_load_n(&source->stats.busy, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int xDRM_Set_Stats_Log(struct modeset_dev *dev, uint32_t interval_ms)
+{
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&dev->stats_log_ms, interval_ms, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int xDRM_Set_Realtime(struct modeset_dev *dev, const struct xdrm_rt_config *config)
+{
+    if (!dev || !config || config->priority < 0 || config->priority > 99) {
+        return -EINVAL;
+    }
+
+    dev->rt = *config;
+
+    return 0;
+}
+
+int xDRM_Stop_Draw(struct modeset_dev *dev)
+{
+    uint64_t one = 1;
+
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    __atomic_store_n(&dev->quit, true, __ATOMIC_RELEASE);
+    if (dev->wake_fd >= 0 && write(dev->wake_fd, &one, sizeof(one)) < 0) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+int xDRM_Set_Present_On_Push(struct modeset_dev *dev, bool enable)
+{
+    if (!dev) {
+        return -EINVAL;
+    }
+
+    // flag lives on the output whose flip carries the frame
+    dev = dev->layer_of ? dev->layer_of : modeset_source(dev);
+    if (enable && dev->wake_fd < 0) {
+        return -ENOTSUP;
+    }
+
+    __atomic_store_n(&dev->present_on_push, enable, __ATOMIC_RELAXED);
+
+    // an idle output goes back to flipping on every vblank
+    if (!enable)
+    {
+        __atomic_store_n(&dev->idle, true, __ATOMIC_RELAXED);
+        modeset_wake(dev);
+    }
+
+    return 0;
+}
+
+int xDRM_Set_Async_Flip(struct modeset_dev *dev, bool enable)
+{
+    const struct xdrm_topology_plane *plane;
+    uint64_t cap = 0;
+    bool legacy;
+
+    if (!dev || dev->mirror_of || dev->layer_of) {
+        return -EINVAL;
+    }
+
+    if (!enable)
+    {
+        __atomic_store_n(&dev->async_flip, false, __ATOMIC_RELAXED);
+
+        // an idle output goes back to flipping on every vblank
+        __atomic_store_n(&dev->idle, true, __ATOMIC_RELAXED);
+        modeset_wake(dev);
+        return 0;
+    }
+
+    // flips are driven by pushes, mirrors and layers are committed in the same request and cannot go async
+    if (dev->wake_fd < 0) {
+        return -ENOTSUP;
+    }
+
+    for (struct modeset_dev *iter = dev->next; iter; iter = __atomic_load_n(&iter->next, __ATOMIC_ACQUIRE))
+    {
+        if (iter->mirror_of == dev || iter->layer_of == dev)
+            return -EBUSY;
+    }
+
+    // Step 1 : atomic async flip since kernel 6.8, otherwise legacy async page flip of primary plane
+    if (!xdrm_backend->get_cap(dev->fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap) && cap)
+        legacy = false;
+    else if (!xdrm_backend->get_cap(dev->fd, DRM_CAP_ASYNC_PAGE_FLIP, &cap) && cap && xdrm_backend->page_flip)
+    {
+        plane = xDRM_Topology_Get_Plane(dev->topology, dev->plane.id);
+        if (!plane || plane->type != XDRM_PLANE_PRIMARY)
+            return -ENOTSUP;
+        legacy = true;
+    }
+    else
+        return -ENOTSUP;
+
+#if __ENABLE_DEBUG_LOG__
+    printf("Async flip on CRTC %u by %s\n", dev->crtc.id, legacy ? "legacy page flip" : "atomic commit");
+#endif
+
+    // Step 2 : display side reads the mode before the flag
+    __atomic_store_n(&dev->async_legacy, legacy, __ATOMIC_RELAXED);
+    __atomic_store_n(&dev->async_flip, true, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+const struct xdrm_topology *xDRM_Get_Topology(struct modeset_dev *dev)
+{
+    if (!dev)
+        return NULL;
+
+    return dev->topology;
+}
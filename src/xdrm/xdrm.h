@@ -22,6 +22,7 @@
 #include <sys/sem.h>
 #include <math.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
 #include "conf/conf.h"
 
 #ifdef __cplusplus
@@ -30,50 +31,450 @@ extern "C" {
 
 /**
  * @brief xDRM init, Open /dev/dri/card0 then init struct modeset_dev with params
+ * @note Device comes from backend of xDRM_Set_Backend, XDRM_BACKEND=headless runs without display.
  * 
  * @param dev modeset_dev device pointer
  * @param conn_id connector id
- * @param crtc_id CRTC id
- * @param plane_id plane id
+ * @param crtc_id CRTC id, 0 for the one driving connector or the first free one it can reach
+ * @param plane_id plane id, 0 for a primary plane of CRTC
  * @param source_width display width (by pixel) on screen
  * @param source_height display height (by pixel) on screen
  * @param x_offset offset on width
  * @param y_offset offset on height
+ * @param buf_count dumb buffers in swapchain, 2 ~ MODESET_BUF_MAX, 0 for MODESET_BUF_DEFAULT
+ * @param format DRM fourcc of scanout, e.g. MODESET_FORMAT_DEFAULT, DRM_FORMAT_NV12, 0 for the first one plane supports
  * 
  * @return fd or fail
  * @retval -1, Init fail
- * @retval fd, file descriptor of /dev/dri/card0.
+ * @retval fd, file descriptor of /dev/dri/card0, a timerfd for headless.
  */
-int xDRM_Init(struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, uint32_t source_width, uint32_t source_height, int x_offset, int y_offset);
+int xDRM_Init(struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format);
+
+/**
+ * @brief xDRM_Init by connector name, CRTC and plane are picked from the topology of the device.
+ * @note Names are the ones of the kernel, e.g. "DSI-1", "HDMI-A-1", xDRM_Topology_Print lists them.
+ * 
+ * @param connector connector name
+ * @return fd, -1 on fail or unknown connector.
+ */
+int xDRM_Init_Connector(struct modeset_dev **dev, const char *connector, uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format);
+
+/**
+ * @brief Connectors, encoders, CRTCs, planes and their properties as read once by xDRM_Init.
+ * @note Owned by list, valid until xDRM_Exit.
+ * 
+ * @param dev any modeset_dev of the list
+ * @return topology, NULL on invalid param.
+ */
+const struct xdrm_topology *xDRM_Get_Topology(struct modeset_dev *dev);
+
+/**
+ * @brief Add another output on fd opened by xDRM_Init, it shares the draw loop of list.
+ * @note Outputs whose flips are due together are committed in one atomic request.
+ * 
+ * @param fd file descriptor which is created by xDRM_Init
+ * @param list modeset_dev returned by xDRM_Init, the new output is linked by next
+ * @param dev [out] modeset_dev of the new output, for xDRM_Push and friends
+ * @param conn_id connector id
+ * @param crtc_id CRTC id, must not be used by list, 0 picks a free one
+ * @param plane_id plane id, must not be used by list, 0 picks a free primary plane of CRTC
+ * @param source_width display width (by pixel) on screen
+ * @param source_height display height (by pixel) on screen
+ * @param x_offset offset on width
+ * @param y_offset offset on height
+ * @param buf_count dumb buffers in swapchain, 2 ~ MODESET_BUF_MAX, 0 for MODESET_BUF_DEFAULT
+ * @param format DRM fourcc of scanout, 0 for the first one plane supports
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param or plane lacks format
+ * @retval -ENODEV, unknown connector
+ * @retval -EBUSY, CRTC or plane already used by list, or none is free
+ * @retval -ENOSPC, list already has MODESET_OUTPUT_MAX outputs
+ */
+int xDRM_Add_Output(int fd, struct modeset_dev *list, struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format);
+
+/**
+ * @brief xDRM_Add_Output by connector name, CRTC and plane are picked among the ones list leaves free.
+ * 
+ * @param connector connector name, e.g. "DSI-2"
+ * @return as xDRM_Add_Output.
+ */
+int xDRM_Add_Output_Connector(int fd, struct modeset_dev *list, struct modeset_dev **dev, const char *connector, uint32_t source_width, uint32_t source_height, int x_offset, int y_offset, uint32_t buf_count, uint32_t format);
+
+/**
+ * @brief Add an output which mirrors source, it scans out the same framebuffer with own position.
+ * @note Mirror allocates no buffers and flips along with source, producer calls on it act on source.
+ * @note Plane of mirror must support the format of source.
+ * 
+ * @param fd file descriptor which is created by xDRM_Init
+ * @param list modeset_dev returned by xDRM_Init, the new output is linked by next
+ * @param source output in list which owns the buffers, must not be a mirror
+ * @param dev [out] modeset_dev of the mirror
+ * @param conn_id connector id
+ * @param crtc_id CRTC id, must not be used by list, 0 picks a free one
+ * @param plane_id plane id, must not be used by list, 0 picks a free one showing format of source
+ * @param x_offset offset on width
+ * @param y_offset offset on height
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param or source is not in list
+ * @retval -ENODEV, unknown connector
+ * @retval -EBUSY, CRTC or plane already used by list, or none is free, or source flips async
+ * @retval -ENOSPC, list already has MODESET_OUTPUT_MAX outputs
+ */
+int xDRM_Add_Mirror(int fd, struct modeset_dev *list, struct modeset_dev *source, struct modeset_dev **dev, uint32_t conn_id, uint32_t crtc_id, uint32_t plane_id, int x_offset, int y_offset);
+
+/**
+ * @brief xDRM_Add_Mirror by connector name, CRTC and plane are picked among the ones list leaves free.
+ * 
+ * @param connector connector name, e.g. "DSI-2"
+ * @return as xDRM_Add_Mirror.
+ */
+int xDRM_Add_Mirror_Connector(int fd, struct modeset_dev *list, struct modeset_dev *source, struct modeset_dev **dev, const char *connector, int x_offset, int y_offset);
+
+/**
+ * @brief Attach an overlay plane to output, e.g. OSD above the video, it is committed in the same request as output.
+ * @note Layer has own buffers, xDRM_Push, xDRM_PushRegion and friends on it only redraw the overlay.
+ *       Its plane is only touched by a flip when a new frame was submitted, video stays zero-blend.
+ * 
+ * @param fd file descriptor which is created by xDRM_Init
+ * @param list modeset_dev returned by xDRM_Init, the layer is linked by next
+ * @param output output in list which owns the CRTC, must not be a mirror or a layer
+ * @param layer [out] modeset_dev of the layer
+ * @param plane_id overlay plane id, must not be used by list, 0 picks a free overlay of the CRTC showing format
+ * @param width layer width (by pixel)
+ * @param height layer height (by pixel)
+ * @param x_offset offset on width of CRTC
+ * @param y_offset offset on height of CRTC
+ * @param zpos stacking order, above 0 of video plane
+ * @param buf_count dumb buffers of layer, 2 ~ MODESET_BUF_MAX, 0 for MODESET_BUF_DEFAULT
+ * @param format DRM fourcc with alpha, e.g. MODESET_FORMAT_DEFAULT
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param or output is not in list
+ * @retval -EBUSY, plane already used by list, or none is free, or output flips async
+ * @retval -ENOSPC, output already has MODESET_LAYER_MAX layers
+ * @retval others, kernel rejects plane, position or zpos by TEST_ONLY commit
+ * @note When no plane is free or every one is rejected, fall back to xDRM_Add_Soft_Layer.
+ */
+int xDRM_Add_Layer(int fd, struct modeset_dev *list, struct modeset_dev *output, struct modeset_dev **layer, uint32_t plane_id,
+    uint32_t width, uint32_t height, int x_offset, int y_offset, uint32_t zpos, uint32_t buf_count, uint32_t format);
+
+/**
+ * @brief Set opacity of a layer plane, taken on next flip of its output.
+ * 
+ * @param layer modeset_dev returned by xDRM_Add_Layer
+ * @param alpha 0 is transparent, 0xFFFF is opaque
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, not a layer
+ * @retval -ENOTSUP, plane has no alpha property
+ */
+int xDRM_Set_Layer_Alpha(struct modeset_dev *layer, uint16_t alpha);
+
+/**
+ * @brief Add a layer composed by CPU into every pushed frame, fallback when no overlay plane is free.
+ * @note Blending is fused with the copy of xDRM_Push, xDRM_PushPlanes and xDRM_PushRegion, each pixel
+ *       of the dumb buffer is still written once. Frames from xDRM_AcquireBuffer or xDRM_ImportDmabuf
+ *       are not composed. Layers are stacked in the order they are added.
+ * @note Owned by producer, add and update from the thread which pushes frames.
+ * 
+ * @param dev modeset_dev of an output in ARGB8888 or XRGB8888, a mirror adds to its source
+ * @param width layer width (by pixel)
+ * @param height layer height (by pixel)
+ * @param x_offset offset on width of frame
+ * @param y_offset offset on height of frame
+ * @return layer index or fail
+ * @retval >=0, index for xDRM_Update_Soft_Layer, layer is transparent until updated
+ * @retval -EINVAL, invalid param or layer outside frame
+ * @retval -ENOTSUP, output format is not ARGB8888 or XRGB8888
+ * @retval -ENOSPC, output already has MODESET_LAYER_MAX soft layers
+ * @retval -ENOMEM
+ */
+int xDRM_Add_Soft_Layer(struct modeset_dev *dev, uint32_t width, uint32_t height, uint32_t x_offset, uint32_t y_offset);
+
+/**
+ * @brief Replace the image of a soft layer, shown from the next pushed frame on.
+ * @note Image is premultiplied and split into transparent, opaque and mixed tiles here, so an OSD
+ *       that rarely changes costs per frame only the blend of its visible tiles.
+ * @note xDRM_PushRegion only composes its rect, push a full frame to show a change elsewhere.
+ * 
+ * @param dev modeset_dev passed to xDRM_Add_Soft_Layer
+ * @param index returned by xDRM_Add_Soft_Layer
+ * @param data ARGB8888 image of layer size
+ * @param stride bytes per row of data
+ * @param premultiplied data is premultiplied ARGB, otherwise straight alpha
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Update_Soft_Layer(struct modeset_dev *dev, int index, const uint32_t *data, uint32_t stride, bool premultiplied);
 
 /**
  * @brief xDRM cleanup, release modeset_dev and close fd
  * 
  * @param fd file descriptor which is created by xDRM_Init
- * @param dev modeset_dev pointer
+ * @param dev modeset_dev returned by xDRM_Init, outputs added by xDRM_Add_Output are released too
  */
 void xDRM_Exit(int fd, struct modeset_dev *dev);
 
 /**
- * @brief xDRM draw loop, draw dev->data_buffer to panel
+ * @brief xDRM draw loop, flip submitted buffers to panel
+ * @note Flips are queued with NONBLOCK and completed by page flip event, a flip which hits EBUSY is retried from this loop.
+ * @note One loop drives dev and every output added by xDRM_Add_Output.
  * 
  * @param fd file descriptor which is created by xDRM_Init
- * @param dev modeset_dev pointer
+ * @param dev modeset_dev returned by xDRM_Init
  */
 void xDRM_Draw(int fd, struct modeset_dev *dev);
 
 /**
- * @brief Copy data from param to dev->data_buffer
+ * @brief Make xDRM_Draw return promptly, safe from any thread and from a signal handler.
+ * @note Flips in flight complete in xDRM_Exit, call it once xDRM_Draw returned.
+ * 
+ * @param dev modeset_dev passed to xDRM_Draw
+ * @return 0 on success, -EINVAL on invalid param, -errno when the loop cannot be woken, it stops on next event then.
+ */
+int xDRM_Stop_Draw(struct modeset_dev *dev);
+
+/**
+ * @brief Flip only when a new frame is pushed, committed as soon as no flip is pending instead of on next flip event.
+ * @note Saves up to one refresh of latency. The plane keeps its frame while nothing is pushed, no vblank is missed then,
+ *       and target fps of xDRM_Set_Target_FPS is left to the producer.
+ * 
+ * @param dev output, for a mirror or layer the output it flips with
+ * @param enable true for present on push, false to flip on every vblank
+ * @return 0 on success, -EINVAL on invalid param, -ENOTSUP when xDRM_Init got no eventfd.
+ */
+int xDRM_Set_Present_On_Push(struct modeset_dev *dev, bool enable);
+
+/**
+ * @brief Put a pushed frame on glass at once with DRM_MODE_PAGE_FLIP_ASYNC, without waiting for vblank, e.g. for EVF.
+ * @note Scanout may tear. Flips happen on push as with xDRM_Set_Present_On_Push, xDRM_Wait_Present keeps
+ *       the producer at refresh rate or target fps without aligning it to vblank.
+ *       Atomic async flip is used where the driver has it, legacy async page flip of a primary plane otherwise.
+ *       A scale or layout change goes through one synced flip, a driver which refuses an async flip falls back to vsync.
+ *       xDRM_GetLatencyStats reports the same stages for both modes, for comparison.
+ * 
+ * @param dev output with no mirrors or layers, which cannot be added while it flips async
+ * @param enable true for async flips, false for vsynced ones
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param or dev is a mirror or layer
+ * @retval -EBUSY, dev has mirrors or layers
+ * @retval -ENOTSUP, driver has no async flip for the plane, or xDRM_Init got no eventfd
+ */
+int xDRM_Set_Async_Flip(struct modeset_dev *dev, bool enable);
+
+/**
+ * @brief Run the display thread of dev under SCHED_FIFO, pinned to cpus, with memory locked, from next xDRM_Draw.
+ * @note Producers pin themselves, and the copy work of xDRM_Push with them, by xDRM_RT_Apply on their own thread.
+ *       Without the right to lock all memory, buffers of every output are locked instead.
+ *       FPS stats print how late flip events are handled after vblank, the effect to watch.
+ * 
+ * @param dev modeset_dev passed to xDRM_Draw
+ * @param config priority 0 ~ 99, cpus mask, lock_memory
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Set_Realtime(struct modeset_dev *dev, const struct xdrm_rt_config *config);
+
+/**
+ * @brief Get a dumb buffer which is not on screen, producer renders into it directly.
+ * @note Lock-free and never blocks, safe to call from several producer threads.
+ * @note With no free buffer the oldest queued frame is dropped and its buffer handed out, counted as overwritten.
+ * 
+ * @param dev modeset_dev pointer
+ * @param map [out] mapped buffer in dev->format, plane n at map + bufs[index].offsets[n]
+ * @param stride [out] bytes per row of plane 0, may be larger than src_width * cpp
+ * @return buffer index or fail
+ * @retval >=0, buffer index for xDRM_SubmitBuffer
+ * @retval -EINVAL, invalid param
+ * @retval -EBUSY, every buffer is on screen, in flight or acquired, drop this frame
+ * @retval -ENODEV, device is cleaning up
+ */
+int xDRM_AcquireBuffer(struct modeset_dev *dev, uint8_t **map, uint32_t *stride);
+
+/**
+ * @brief Queue an acquired buffer, frames are shown one per flip in submit order.
+ * @note When more than queue_depth frames are waiting, the oldest ones are dropped.
+ * 
+ * @param dev modeset_dev pointer
+ * @param index buffer index returned by xDRM_AcquireBuffer or xDRM_ImportDmabuf
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, buffer is not acquired
+ */
+int xDRM_SubmitBuffer(struct modeset_dev *dev, int index);
+
+/**
+ * @brief Wrap a dma-buf from ISP, V4L2 or udmabuf as framebuffer, frame goes to display without CPU copy.
+ * @note Import is cached by dmabuf_fd, importing the same fd again only takes its slot back.
+ * @note Chroma planes follow plane 0 in the same dma-buf, at the same stride.
+ * 
+ * @param dev modeset_dev pointer
+ * @param dmabuf_fd dma-buf of a src_width x src_height frame, must stay open until xDRM_ReleaseDmabuf
+ * @param format DRM fourcc of frame, plane of dev and of its mirrors must support it
+ * @param stride bytes per row of plane 0
+ * @param offset byte offset of plane 0 in dma-buf
+ * @return buffer index or fail
+ * @retval >=0, buffer index for xDRM_SubmitBuffer
+ * @retval -EINVAL, invalid param, or dmabuf_fd is cached with another layout
+ * @retval -EBUSY, frame of dmabuf_fd is still on screen or queued
+ * @retval -ENOSPC, every one of MODESET_IMPORT_MAX slots holds a dma-buf
+ * @retval -ENODEV, device is cleaning up
+ */
+int xDRM_ImportDmabuf(struct modeset_dev *dev, int dmabuf_fd, uint32_t format, uint32_t stride, uint32_t offset);
+
+/**
+ * @brief Drop the framebuffer cached for dmabuf_fd, call it before closing dmabuf_fd.
+ * 
+ * @param dev modeset_dev pointer
+ * @param dmabuf_fd dma-buf passed to xDRM_ImportDmabuf
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param
+ * @retval -EBUSY, frame is acquired, on screen or queued, try again after next flip
+ * @retval -ENOENT, dmabuf_fd is not imported
+ */
+int xDRM_ReleaseDmabuf(struct modeset_dev *dev, int dmabuf_fd);
+
+/**
+ * @brief Copy data from param to a free dumb buffer and submit it
  * 
  * @param dev modeset_dev pointer
- * @param data ARGB array of image
- * @param size array size
+ * @param data image in dev->format, planes packed one after another, e.g. Y then UV for NV12
+ * @param size array size in bytes
  * @return success or not
  * @retval 0, success
  * @retval -EINVAL, fail
+ * @retval -EBUSY, every buffer is on screen, in flight or acquired, frame dropped
  */
 int xDRM_Push(struct modeset_dev *dev, uint32_t *data, size_t size);
 
+/**
+ * @brief Copy each plane of an image to a free dumb buffer and submit it, planes may live apart.
+ * 
+ * @param dev modeset_dev pointer
+ * @param data plane pointers in dev->format, e.g. {Y, UV} for NV12
+ * @param strides bytes per row of each plane
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, fail
+ * @retval -EBUSY, every buffer is on screen, in flight or acquired, frame dropped
+ */
+int xDRM_PushPlanes(struct modeset_dev *dev, const uint8_t *const data[], const uint32_t strides[]);
+
+/**
+ * @brief Place source on the CRTC of dev, the display plane scales when SRC and CRTC rects differ.
+ * @note Layout is checked by a TEST_ONLY commit. When the plane refuses to scale, frames are scaled
+ *       by CPU on the display thread into two mode sized buffers, imported dma-bufs are not shown then.
+ * @note Applies to dev only, a mirror has its own layout. Taken on next flip, one caller at a time.
+ * 
+ * @param dev modeset_dev pointer
+ * @param mode MODESET_SCALE_NONE restores 1:1 at x_offset, y_offset
+ * @param rect region on CRTC for MODESET_SCALE_RECT, inside the mode, NULL otherwise
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param
+ * @retval -ERANGE, source is larger than mode for MODESET_SCALE_INTEGER
+ * @retval -ENODEV, device is cleaning up
+ * @retval others, plane rejects layout even without scaling
+ */
+int xDRM_Set_Scale(struct modeset_dev *dev, enum modeset_scale mode, const struct modeset_rect *rect);
+
+/**
+ * @brief Set rate of new frames, e.g. 30/50/60. Flips stay on vblank, a new frame is taken
+ *        on the vblank nearest to each 1/fps deadline, timed by kernel flip timestamps.
+ * 
+ * @param dev modeset_dev pointer
+ * @param fps target rate, 0 or above panel refresh for every vblank
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, fail
+ */
+int xDRM_Set_Target_FPS(struct modeset_dev *dev, uint32_t fps);
+
+/**
+ * @brief Sleep calling producer until the next vblank which takes a new frame,
+ *        so producer runs on display clock and never drifts against it.
+ * @note With xDRM_Set_Async_Flip, sleep one interval from last wake instead, not aligned to vblank.
+ * 
+ * @param dev modeset_dev pointer
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, fail
+ */
+int xDRM_Wait_Present(struct modeset_dev *dev);
+
+/**
+ * @brief Set how many submitted frames may wait for display.
+ * @note 1 (default) is a mailbox, the newest frame always wins. Larger depth lets producer
+ *       run ahead and absorb jitter, at the cost of depth frames of latency.
+ * 
+ * @param dev modeset_dev pointer
+ * @param depth 1 ~ buf_count - 1
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, fail
+ */
+int xDRM_Set_Queue_Depth(struct modeset_dev *dev, uint32_t depth);
+
+/**
+ * @brief Snapshot buffer count, queue depth and buffers per state, for tuning.
+ * 
+ * @param dev modeset_dev pointer
+ * @param stats [out] buffer stats
+ * @return success or not
+ * @retval 0, success
+ * @retval -EINVAL, fail
+ */
+int xDRM_Get_Buffer_Stats(struct modeset_dev *dev, struct modeset_buf_stats *stats);
+
+/**
+ * @brief Update a rectangle of the frame, the rest is carried forward from the newest submitted frame.
+ * @note Only the region and the pixels this buffer missed are copied, region is passed to kernel as FB_DAMAGE_CLIPS.
+ * @note Single producer, once an output takes xDRM_PushRegion it is the only thread pushing frames to that
+ *       output, xDRM_Push and xDRM_AcquireBuffer from the same thread mix freely with it.
+ * 
+ * @param dev modeset_dev pointer
+ * @param rect region on source, must lie inside src_width x src_height
+ * @param data pixels of the region in dev->format, first pixel at (rect->x, rect->y)
+ * @param stride bytes per row of data, at least rect->width * cpp
+ * @return 0 on success, others on fail
+ * @retval -EINVAL, invalid param, x and width must be even for YUYV
+ * @retval -ENOTSUP, format has more than one plane, or newest frame is an imported dma-buf
+ * @retval -EBUSY, every buffer is on screen, in flight or acquired, drop this frame
+ * @retval -ENODEV, device is cleaning up
+ */
+int xDRM_PushRegion(struct modeset_dev *dev, const struct modeset_rect *rect, const uint32_t *data, uint32_t stride);
+
+/**
+ * @brief Count missed vblanks, repeated and held flips, overwritten and refused pushes, for sizing buffers and pacing.
+ * @note Missed vblanks come from gaps in kernel sequence of flip events, a flip is queued on every vblank.
+ * 
+ * @param dev modeset_dev pointer, a mirror reports vblanks of its own CRTC and frames of its source
+ * @param stats [out] counters since xDRM_Init
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_GetStats(struct modeset_dev *dev, struct modeset_stats *stats);
+
+/**
+ * @brief Print what xDRM_GetStats counted during each interval, from the display thread.
+ * 
+ * @param dev modeset_dev pointer
+ * @param interval_ms interval between two lines, 0 turns logging off
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_Set_Stats_Log(struct modeset_dev *dev, uint32_t interval_ms);
+
+/**
+ * @brief Latency of frames which reached the screen, p50, p99 and max per stage from push to vblank.
+ * @note Stamped with CLOCK_MONOTONIC and the kernel vblank timestamp, dropped frames are not counted.
+ * 
+ * @param dev modeset_dev pointer, a mirror reports its source
+ * @param stats [out] summary per enum xdrm_latency_stage
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_GetLatencyStats(struct modeset_dev *dev, struct modeset_latency_stats *stats);
+
+/**
+ * @brief Start latency histograms of dev over, e.g. between benchmark runs.
+ * 
+ * @return 0 on success, -EINVAL on invalid param.
+ */
+int xDRM_ResetLatencyStats(struct modeset_dev *dev);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
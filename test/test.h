@@ -0,0 +1,75 @@
+#pragma once
+
+#include "xdrm/xdrm.h"
+
+#include <cstdio>
+#include <chrono>
+#include <atomic>
+
+// failed checks of this test, exit status of test_result
+inline std::atomic<long> test_failures{0};
+
+/**
+ * @brief Count and print a failed check, keep going so one run shows every failure.
+ */
+#define TEST_CHECK(cond)                                                            \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            test_failures++;                                                        \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        }                                                                           \
+    } while (0)
+
+/**
+ * @brief Check a == b, print both when they differ.
+ */
+#define TEST_CHECK_EQ(a, b)                                                                     \
+    do                                                                                          \
+    {                                                                                           \
+        long long _a_ = (long long)(a), _b_ = (long long)(b);                                   \
+        if (_a_ != _b_)                                                                         \
+        {                                                                                       \
+            test_failures++;                                                                    \
+            fprintf(stderr, "%s:%d: check failed: %s == %s, %lld != %lld\n", __FILE__, __LINE__, \
+                    #a, #b, _a_, _b_);                                                          \
+        }                                                                                       \
+    } while (0)
+
+inline double test_now_ns()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Present until shown() holds, a frame may take a flip or two to reach the screen.
+ */
+template <class F>
+bool test_present_until(struct modeset_dev *dev, F &&shown)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        xDRM_Wait_Present(dev);
+        if (shown())
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Exit status for ctest, print summary.
+ */
+inline int test_result(const char *name)
+{
+    long failures = test_failures.load();
+
+    if (failures)
+        fprintf(stderr, "%s: %ld checks failed\n", name, failures);
+    else
+        printf("%s: passed\n", name);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * Soft layer blending: the SIMD kernel of xDRM_Blend is bit exact with xDRM_Blend_Scalar, and xDRM_Blend_Compose
+ * skipping transparent tiles and copying opaque ones writes the same frame as blending every pixel.
+ */
+
+#include "test.h"
+#include "xdrm/blend/blend.h"
+
+#include <random>
+#include <vector>
+#include <cstring>
+
+static const uint32_t width = 200, height = 120;
+
+/**
+ * @brief Premultiplied pixel, every channel at most alpha, fully transparent and opaque ones come up often.
+ */
+static uint32_t blend_pixel(std::mt19937 &rng)
+{
+    uint32_t a, pixel;
+
+    switch (rng() % 4)
+    {
+        case 0:
+            return 0;
+        case 1:
+            a = 255;
+            break;
+        default:
+            a = rng() % 256;
+            break;
+    }
+
+    pixel = a << 24;
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+        pixel |= (a ? rng() % (a + 1) : 0) << shift;
+
+    return pixel;
+}
+
+static void test_kernel()
+{
+    std::mt19937 rng(17);
+    std::vector<uint32_t> src(1100), dst(1100), expected(1100);
+    long failures = test_failures;
+
+    // Step 1 : every count around the vector widths, then random counts at odd offsets
+    for (uint32_t round = 0; round < 300; round++)
+    {
+        uint32_t count = round < 40 ? round : rng() % 1024;
+        uint32_t offset = round < 40 ? 0 : rng() % 7;
+
+        for (uint32_t i = 0; i < count + offset; i++)
+        {
+            src[i] = blend_pixel(rng);
+            dst[i] = expected[i] = rng();
+        }
+
+        xDRM_Blend_Scalar(expected.data() + offset, src.data() + offset, count);
+        xDRM_Blend(dst.data() + offset, src.data() + offset, count);
+
+        if (memcmp(dst.data(), expected.data(), (count + offset) * 4))
+        {
+            fprintf(stderr, "xDRM_Blend: count %u offset %u differs\n", count, offset);
+            TEST_CHECK(false);
+        }
+    }
+
+    printf("kernel: %s\n", test_failures == failures ? "passed" : "failed");
+}
+
+/**
+ * @brief Layer whose tiles are transparent, opaque or mixed at random, loaded through xDRM_Blend_Load.
+ */
+static void blend_layer_create(struct xdrm_blend_layer &layer, std::vector<uint32_t> &pixels, std::vector<uint8_t> &tiles,
+                               uint32_t layer_width, uint32_t layer_height, uint32_t x, uint32_t y, bool premultiplied, std::mt19937 &rng)
+{
+    uint32_t tiles_x = (layer_width + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE;
+    uint32_t tiles_y = (layer_height + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE;
+    std::vector<uint8_t> kinds(tiles_x * tiles_y);
+    std::vector<uint32_t> image((size_t)layer_width * layer_height);
+
+    for (auto &kind : kinds)
+        kind = rng() % 3;
+
+    for (uint32_t py = 0; py < layer_height; py++)
+    {
+        for (uint32_t px = 0; px < layer_width; px++)
+        {
+            uint8_t kind = kinds[(py / XDRM_BLEND_TILE) * tiles_x + px / XDRM_BLEND_TILE];
+            uint32_t pixel = blend_pixel(rng);
+
+            if (kind == XDRM_BLEND_TRANSPARENT)
+                pixel = 0;
+            else if (kind == XDRM_BLEND_OPAQUE)
+                pixel |= 0xFF000000;
+            else if (!premultiplied)
+                pixel = (pixel & 0xFF000000) | (rng() & 0xFFFFFF);
+
+            image[(size_t)py * layer_width + px] = pixel;
+        }
+    }
+
+    pixels.assign(image.size(), 0);
+    tiles.assign(kinds.size(), 0xFF);
+    layer = {pixels.data(), tiles.data(), tiles_x, layer_width, layer_height, x, y};
+    xDRM_Blend_Load(&layer, image.data(), layer_width * 4, premultiplied);
+}
+
+static void test_compose()
+{
+    std::mt19937 rng(29);
+    std::vector<uint32_t> video((size_t)width * height), reference, dst, row(width);
+    std::vector<uint32_t> pixels[3];
+    std::vector<uint8_t> tiles[3];
+    struct xdrm_blend_layer layers[3];
+    uint32_t kinds[3] = {0, 0, 0};
+    long failures = test_failures;
+
+    // sizes off the tile grid, at odd positions, overlapping each other, one with straight alpha
+    blend_layer_create(layers[0], pixels[0], tiles[0], 77, 45, 3, 5, true, rng);
+    blend_layer_create(layers[1], pixels[1], tiles[1], 130, 70, 41, 30, false, rng);
+    blend_layer_create(layers[2], pixels[2], tiles[2], 16, 100, 180, 17, true, rng);
+
+    for (auto &layer : layers)
+    {
+        for (uint32_t t = 0; t < layer.tiles_x * ((layer.height + XDRM_BLEND_TILE - 1) / XDRM_BLEND_TILE); t++)
+            kinds[layer.tiles[t]]++;
+    }
+    TEST_CHECK(kinds[XDRM_BLEND_TRANSPARENT] > 0 && kinds[XDRM_BLEND_OPAQUE] > 0 && kinds[XDRM_BLEND_MIXED] > 0);
+
+    for (auto &pixel : video)
+        pixel = rng();
+
+    // Step 1 : reference blends every pixel of every layer, bottom first
+    reference = video;
+    for (auto &layer : layers)
+    {
+        for (uint32_t py = 0; py < layer.height; py++)
+            xDRM_Blend_Scalar(&reference[(size_t)(layer.y + py) * width + layer.x], layer.pixels + (size_t)py * layer.width, layer.width);
+    }
+
+    // Step 2 : whole frame, then random regions into a padded destination
+    for (uint32_t round = 0; round < 200; round++)
+    {
+        uint32_t w = round ? 1 + rng() % width : width;
+        uint32_t h = round ? 1 + rng() % height : height;
+        uint32_t x = round ? rng() % (width - w + 1) : 0;
+        uint32_t y = round ? rng() % (height - h + 1) : 0;
+        uint32_t pitch = w + 5;
+
+        dst.assign((size_t)pitch * h, 0xDEADBEEF);
+        xDRM_Blend_Compose((uint8_t *)dst.data(), pitch * 4, (const uint8_t *)&video[(size_t)y * width + x], width * 4,
+                           x, y, w, h, layers, 3, row.data());
+
+        for (uint32_t py = 0; py < h; py++)
+        {
+            const uint32_t *line = &dst[(size_t)py * pitch];
+
+            if (memcmp(line, &reference[(size_t)(y + py) * width + x], w * 4))
+            {
+                fprintf(stderr, "xDRM_Blend_Compose: region %ux%u at %u,%u differs in row %u\n", w, h, x, y, py);
+                TEST_CHECK(false);
+                break;
+            }
+
+            // padding of destination rows stays untouched
+            for (uint32_t px = w; px < pitch; px++)
+                TEST_CHECK_EQ(line[px], 0xDEADBEEF);
+        }
+    }
+
+    printf("compose: %s\n", test_failures == failures ? "passed" : "failed");
+}
+
+int main()
+{
+    test_kernel();
+    test_compose();
+
+    return test_result("test_blend");
+}
@@ -0,0 +1,112 @@
+/**
+ * Row copy kernels: every kernel this CPU supports writes exactly what xDRM_Copy_Scalar writes, over random
+ * widths, padded pitches, misaligned destinations and tails shorter than one vector, and nothing outside the rows.
+ */
+
+#include "test.h"
+#include "xdrm/copy/copy.h"
+
+#include <random>
+#include <vector>
+#include <cstring>
+
+// room around every copy, bytes outside the rows must keep the guard value
+static const size_t guard = 128;
+static const uint8_t guard_value = 0xA5;
+
+struct copy_case
+{
+    uint32_t row_bytes;
+    uint32_t rows;
+    // padding after each row, pitch is row_bytes + pad
+    uint32_t dst_pad;
+    uint32_t src_pad;
+    // offset of first byte from a 64 byte boundary
+    uint32_t dst_misalign;
+    uint32_t src_misalign;
+};
+
+/**
+ * @brief Run one case through xDRM_Copy and xDRM_Copy_Scalar, destinations must match byte for byte.
+ */
+static bool copy_check(const copy_case &c, std::mt19937 &rng)
+{
+    uint32_t dst_stride = c.row_bytes + c.dst_pad, src_stride = c.row_bytes + c.src_pad;
+    size_t dst_size = guard * 2 + (size_t)dst_stride * c.rows, src_size = guard + c.src_misalign + (size_t)src_stride * c.rows;
+    std::vector<uint8_t> src(src_size + 64), expected(dst_size + 64, guard_value), actual(dst_size + 64, guard_value);
+    uint8_t *src_base, *expected_window, *actual_window;
+
+    // align each window to 64 bytes, copies start off it by the misalignment of the case
+    src_base = (uint8_t *)(((uintptr_t)src.data() + 63) & ~(uintptr_t)63) + c.src_misalign;
+    expected_window = (uint8_t *)(((uintptr_t)expected.data() + 63) & ~(uintptr_t)63);
+    actual_window = (uint8_t *)(((uintptr_t)actual.data() + 63) & ~(uintptr_t)63);
+
+    for (auto &byte : src)
+        byte = (uint8_t)rng();
+
+    xDRM_Copy_Scalar(expected_window + guard + c.dst_misalign, dst_stride, src_base, src_stride, c.row_bytes, c.rows);
+    xDRM_Copy(actual_window + guard + c.dst_misalign, dst_stride, src_base, src_stride, c.row_bytes, c.rows);
+
+    if (memcmp(expected_window, actual_window, dst_size) == 0)
+        return true;
+
+    fprintf(stderr, "%s: row_bytes %u rows %u dst pad %u misalign %u, src pad %u misalign %u\n",
+            xDRM_Copy_Kernel_Name(xDRM_Copy_Get_Kernel()), c.row_bytes, c.rows, c.dst_pad, c.dst_misalign, c.src_pad, c.src_misalign);
+    return false;
+}
+
+static void test_kernel(enum xdrm_copy_kernel kernel)
+{
+    std::mt19937 rng(kernel * 7919);
+    long failures = test_failures;
+    int ret = xDRM_Copy_Set_Kernel(kernel);
+
+    if (ret == -ENOTSUP)
+    {
+        printf("%s: not supported, skipped\n", xDRM_Copy_Kernel_Name(kernel));
+        return;
+    }
+
+    TEST_CHECK_EQ(ret, 0);
+    TEST_CHECK_EQ(xDRM_Copy_Get_Kernel(), kernel);
+
+    // Step 1 : every length past two of the widest loops, tails below 16, 32 and 64 bytes, at each alignment
+    for (uint32_t row_bytes = 1; row_bytes <= 300; row_bytes++)
+    {
+        for (uint32_t misalign = 0; misalign < 64; misalign += 7)
+            TEST_CHECK(copy_check({row_bytes, 3, 0, 0, misalign, 0}, rng));
+    }
+
+    // Step 2 : packed frame, the whole copy may run as one block
+    TEST_CHECK(copy_check({640 * 4, 512, 0, 0, 0, 0}, rng));
+
+    // Step 3 : random widths, padded pitches and misaligned source and destination
+    for (int i = 0; i < 500; i++)
+    {
+        copy_case c;
+
+        c.row_bytes = 1 + rng() % 8192;
+        c.rows = 1 + rng() % 16;
+        c.dst_pad = rng() % 4 ? rng() % 256 : 0;
+        c.src_pad = rng() % 4 ? rng() % 256 : 0;
+        c.dst_misalign = rng() % 64;
+        c.src_misalign = rng() % 64;
+        TEST_CHECK(copy_check(c, rng));
+    }
+
+    printf("%s: %s\n", xDRM_Copy_Kernel_Name(kernel), test_failures == failures ? "passed" : "failed");
+}
+
+int main()
+{
+    TEST_CHECK_EQ(xDRM_Copy_Set_Kernel(XDRM_COPY_KERNEL_NUM), -EINVAL);
+
+    for (int kernel = XDRM_COPY_SCALAR; kernel < XDRM_COPY_KERNEL_NUM; kernel++)
+        test_kernel((enum xdrm_copy_kernel)kernel);
+
+    // back to the best kernel, it must be one of the above
+    TEST_CHECK_EQ(xDRM_Copy_Set_Kernel(XDRM_COPY_AUTO), 0);
+    TEST_CHECK(xDRM_Copy_Get_Kernel() > XDRM_COPY_AUTO && xDRM_Copy_Get_Kernel() < XDRM_COPY_KERNEL_NUM);
+
+    return test_result("test_copy");
+}
@@ -0,0 +1,248 @@
+/**
+ * Display path end to end on the headless backend: scanout is pixel exact, flips follow the mode rate,
+ * a plane without scaler falls back to the CPU scaler, and Exit releases everything.
+ */
+
+#include "test.h"
+
+#include <thread>
+#include <vector>
+#include <cstring>
+
+static const uint32_t width = 640, height = 512;
+
+// headless backend which snapshots its counters right before the device closes
+static struct xdrm_backend headless_checked;
+static struct xdrm_headless_stats at_close;
+
+static int headless_checked_close(int fd)
+{
+    xDRM_Headless_Get_Stats(&at_close);
+    return xdrm_backend_headless.close(fd);
+}
+
+struct headless_output
+{
+    struct modeset_dev *dev = nullptr;
+    int fd = -1;
+    std::thread draw;
+};
+
+static bool headless_open(headless_output &out, const struct xdrm_headless_config &config, uint32_t x, uint32_t y)
+{
+    TEST_CHECK_EQ(xDRM_Headless_Configure(&config), 0);
+
+    out.fd = xDRM_Init(&out.dev, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, width, height, x, y, 0, DRM_FORMAT_ARGB8888);
+    TEST_CHECK(out.fd >= 0);
+    if (out.fd < 0)
+        return false;
+
+    out.draw = std::thread([fd = out.fd, dev = out.dev] { xDRM_Draw(fd, dev); });
+    return true;
+}
+
+/**
+ * @brief Stop the loop and release, every buffer, fb and blob must be gone before the device closes.
+ */
+static void headless_close(headless_output &out)
+{
+    TEST_CHECK_EQ(xDRM_Stop_Draw(out.dev), 0);
+    out.draw.join();
+
+    memset(&at_close, 0xff, sizeof(at_close));
+    xDRM_Exit(out.fd, out.dev);
+
+    TEST_CHECK_EQ(at_close.bufs, 0);
+    TEST_CHECK_EQ(at_close.fbs, 0);
+    TEST_CHECK_EQ(at_close.blobs, 0);
+}
+
+/**
+ * @brief Rows of plane which differ from image, -1 when the plane shows nothing.
+ */
+static int headless_diff(uint32_t plane_id, const uint32_t *image, uint32_t image_width, uint32_t image_height)
+{
+    struct xdrm_headless_plane plane;
+    int rows = 0;
+
+    if (xDRM_Headless_Get_Plane(plane_id, &plane) < 0 || !plane.map)
+        return -1;
+
+    for (uint32_t y = 0; y < image_height; y++)
+    {
+        if (memcmp(plane.map + plane.offsets[0] + (size_t)y * plane.pitches[0], image + (size_t)y * image_width, image_width * 4))
+            rows++;
+    }
+
+    return rows;
+}
+
+static void headless_fill(std::vector<uint32_t> &image, uint32_t seed)
+{
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = 0xFF000000 | (uint32_t)(i * 2654435761u + seed);
+}
+
+static void test_scanout()
+{
+    struct xdrm_headless_config config = {1280, 720, 60, false};
+    std::vector<uint32_t> frame((size_t)width * height);
+    struct xdrm_headless_plane plane;
+    headless_output out;
+
+    if (!headless_open(out, config, 10, 20))
+        return;
+
+    for (uint32_t f = 0; f < 10; f++)
+    {
+        headless_fill(frame, f);
+        TEST_CHECK_EQ(xDRM_Push(out.dev, frame.data(), frame.size() * 4), 0);
+        TEST_CHECK(test_present_until(out.dev, [&] { return headless_diff(PLANE_ID_DSI1, frame.data(), width, height) == 0; }));
+    }
+
+    TEST_CHECK_EQ(xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &plane), 0);
+    TEST_CHECK_EQ(plane.crtc, CRTC_ID_DSI1);
+    TEST_CHECK_EQ(plane.format, DRM_FORMAT_ARGB8888);
+    TEST_CHECK_EQ(plane.crtc_x, 10);
+    TEST_CHECK_EQ(plane.crtc_y, 20);
+    TEST_CHECK_EQ(plane.crtc_w, width);
+    TEST_CHECK_EQ(plane.crtc_h, height);
+    TEST_CHECK_EQ(plane.src_w >> 16, width);
+    TEST_CHECK_EQ(plane.src_h >> 16, height);
+
+    headless_close(out);
+}
+
+static void test_rate(uint32_t refresh_hz)
+{
+    struct xdrm_headless_config config = {1280, 720, refresh_hz, false};
+    std::vector<uint32_t> frame((size_t)width * height, 0xFF204060);
+    struct xdrm_headless_stats before, after;
+    double start, elapsed, rate;
+    headless_output out;
+
+    if (!headless_open(out, config, 0, 0))
+        return;
+
+    TEST_CHECK(out.dev->pacer.refresh_ns > 1e9 / refresh_hz * 0.999 && out.dev->pacer.refresh_ns < 1e9 / refresh_hz * 1.001);
+
+    // settle, then one new frame per vblank for a second
+    for (int i = 0; i < 10; i++)
+    {
+        xDRM_Push(out.dev, frame.data(), frame.size() * 4);
+        xDRM_Wait_Present(out.dev);
+    }
+
+    xDRM_Headless_Get_Stats(&before);
+    start = test_now_ns();
+    while (test_now_ns() - start < 1e9)
+    {
+        xDRM_Push(out.dev, frame.data(), frame.size() * 4);
+        xDRM_Wait_Present(out.dev);
+    }
+    elapsed = test_now_ns() - start;
+    xDRM_Headless_Get_Stats(&after);
+
+    rate = (after.flips - before.flips) / elapsed * 1e9;
+    printf("%u Hz: %.2f flips/s\n", refresh_hz, rate);
+    TEST_CHECK(rate > refresh_hz - 1.5 && rate < refresh_hz + 1.5);
+    TEST_CHECK_EQ(after.busy, before.busy);
+
+    headless_close(out);
+}
+
+static void test_cpu_scale()
+{
+    // plane without scaler, FIT goes through the CPU scaler
+    struct xdrm_headless_config config = {1280, 720, 60, true};
+    std::vector<uint32_t> frame((size_t)width * height), expected;
+    struct xdrm_headless_plane plane;
+    uint32_t scaled_width, scaled_height;
+    headless_output out;
+
+    if (!headless_open(out, config, 0, 0))
+        return;
+
+    TEST_CHECK_EQ(xDRM_Set_Scale(out.dev, MODESET_SCALE_FIT, NULL), 0);
+
+    headless_fill(frame, 7);
+    TEST_CHECK_EQ(xDRM_Push(out.dev, frame.data(), frame.size() * 4), 0);
+    for (int i = 0; i < 3; i++)
+        xDRM_Wait_Present(out.dev);
+
+    TEST_CHECK(out.dev->layout.cpu_scale);
+    TEST_CHECK_EQ(xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &plane), 0);
+
+    // plane shows the scaled frame 1:1, 640x512 fit into 1280x720 is 900x720
+    scaled_width = plane.crtc_w;
+    scaled_height = plane.crtc_h;
+    TEST_CHECK_EQ(scaled_width, 900);
+    TEST_CHECK_EQ(scaled_height, 720);
+    TEST_CHECK_EQ(plane.src_w >> 16, scaled_width);
+    TEST_CHECK_EQ(plane.src_h >> 16, scaled_height);
+
+    // nearest neighbour sampled at pixel centre
+    expected.resize((size_t)scaled_width * scaled_height);
+    for (uint32_t y = 0; y < scaled_height; y++)
+    {
+        uint32_t sy = (uint32_t)(((2ull * y + 1) * height) / (2ull * scaled_height));
+        for (uint32_t x = 0; x < scaled_width; x++)
+        {
+            uint32_t sx = (uint32_t)(((2ull * x + 1) * width) / (2ull * scaled_width));
+            expected[(size_t)y * scaled_width + x] = frame[(size_t)sy * width + sx];
+        }
+    }
+    TEST_CHECK_EQ(headless_diff(PLANE_ID_DSI1, expected.data(), scaled_width, scaled_height), 0);
+
+    headless_close(out);
+}
+
+static void test_reinit()
+{
+    struct xdrm_headless_config config = {1280, 720, 60, false};
+    std::vector<uint32_t> frame((size_t)width * height, 0xFF102030), small(320 * 240, 0xFF405060);
+
+    // outputs and layers of the list are released with it, twice in a row
+    for (int round = 0; round < 2; round++)
+    {
+        struct modeset_dev *second = nullptr, *layer = nullptr;
+        headless_output out;
+
+        TEST_CHECK_EQ(xDRM_Headless_Configure(&config), 0);
+        out.fd = xDRM_Init(&out.dev, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, width, height, 0, 0, 0, DRM_FORMAT_ARGB8888);
+        TEST_CHECK(out.fd >= 0);
+        if (out.fd < 0)
+            return;
+
+        TEST_CHECK(xDRM_Add_Output(out.fd, out.dev, &second, CONN_ID_DSI2, CRTC_ID_DSI2, PLANE_ID_DSI2, 320, 240, 0, 0, 0, DRM_FORMAT_ARGB8888) >= 0);
+        TEST_CHECK(xDRM_Add_Layer(out.fd, out.dev, out.dev, &layer, XDRM_HEADLESS_PLANE_OVERLAY0, 320, 240, 40, 40, 1, 0, DRM_FORMAT_ARGB8888) >= 0);
+        out.draw = std::thread([fd = out.fd, dev = out.dev] { xDRM_Draw(fd, dev); });
+
+        for (int i = 0; i < 10; i++)
+        {
+            xDRM_Push(out.dev, frame.data(), frame.size() * 4);
+            if (second)
+                xDRM_Push(second, small.data(), small.size() * 4);
+            if (layer)
+                xDRM_Push(layer, small.data(), small.size() * 4);
+            xDRM_Wait_Present(out.dev);
+        }
+
+        headless_close(out);
+    }
+}
+
+int main()
+{
+    headless_checked = xdrm_backend_headless;
+    headless_checked.close = headless_checked_close;
+    xDRM_Set_Backend(&headless_checked);
+
+    test_scanout();
+    test_rate(50);
+    test_rate(60);
+    test_cpu_scale();
+    test_reinit();
+
+    return test_result("test_headless");
+}
@@ -0,0 +1,139 @@
+/**
+ * Zero-copy import on the headless backend: memfd stands in for dma-buf, imports are cached by fd,
+ * frames scan out bit exact and xDRM_ReleaseDmabuf hands every fb and handle back.
+ */
+
+#include "test.h"
+
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static const uint32_t width = 640, height = 512;
+static const uint32_t pitch = width * 4, offset = 256;
+static const size_t size = offset + (size_t)pitch * height;
+static const int dmabuf_count = 4;
+
+struct import_dmabuf
+{
+    int fd;
+    uint8_t *map;
+};
+
+static import_dmabuf import_create(uint8_t seed)
+{
+    import_dmabuf buf = {memfd_create("xdrm_import", 0), nullptr};
+
+    TEST_CHECK(buf.fd >= 0);
+    TEST_CHECK_EQ(ftruncate(buf.fd, size), 0);
+
+    buf.map = (uint8_t *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buf.fd, 0);
+    TEST_CHECK(buf.map != MAP_FAILED);
+    for (size_t i = 0; i < size; i++)
+        buf.map[i] = (uint8_t)(i * 13 + seed);
+
+    return buf;
+}
+
+/**
+ * @brief Plane scans out the frame of buf, at its offset and pitch.
+ */
+static bool import_on_screen(const import_dmabuf &buf)
+{
+    struct xdrm_headless_plane plane;
+
+    if (xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &plane) < 0 || !plane.map)
+        return false;
+
+    if (plane.offsets[0] != offset || plane.pitches[0] != pitch)
+        return false;
+
+    return memcmp(plane.map + offset, buf.map + offset, (size_t)pitch * height) == 0;
+}
+
+int main()
+{
+    struct xdrm_headless_config config = {1280, 720, 60, false};
+    std::vector<uint32_t> frame((size_t)width * height, 0xFF336699);
+    struct xdrm_headless_stats before, stats;
+    struct modeset_buf_stats buf_stats;
+    import_dmabuf bufs[dmabuf_count];
+    struct modeset_dev *dev = nullptr;
+    int fd, index, shown = 0, busy = 0;
+
+    xDRM_Set_Backend(&xdrm_backend_headless);
+    TEST_CHECK_EQ(xDRM_Headless_Configure(&config), 0);
+
+    fd = xDRM_Init(&dev, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, width, height, 0, 0, 0, DRM_FORMAT_ARGB8888);
+    TEST_CHECK(fd >= 0);
+    if (fd < 0)
+        return test_result("test_import");
+
+    std::thread draw([fd, dev] { xDRM_Draw(fd, dev); });
+    xDRM_Wait_Present(dev);
+    xDRM_Headless_Get_Stats(&before);
+
+    for (int k = 0; k < dmabuf_count; k++)
+        bufs[k] = import_create((uint8_t)k);
+
+    // Step 1 : 120 flips over 4 dma-bufs, each imported once and taken from cache afterwards
+    for (int f = 0; f < 120; f++)
+    {
+        const import_dmabuf &buf = bufs[f % dmabuf_count];
+
+        index = xDRM_ImportDmabuf(dev, buf.fd, DRM_FORMAT_ARGB8888, pitch, offset);
+        if (index == -EBUSY)
+        {
+            busy++;
+            xDRM_Wait_Present(dev);
+            continue;
+        }
+
+        TEST_CHECK(index >= (int)dev->buf_count);
+        if (index < 0)
+            continue;
+
+        TEST_CHECK_EQ(xDRM_SubmitBuffer(dev, index), 0);
+        TEST_CHECK(test_present_until(dev, [&] { return import_on_screen(buf); }));
+        shown++;
+    }
+
+    xDRM_Headless_Get_Stats(&stats);
+    printf("shown %d busy %d fbs %u handles %u\n", shown, busy, stats.fbs - before.fbs, stats.bufs - before.bufs);
+    TEST_CHECK(shown >= 110);
+    TEST_CHECK_EQ(stats.fbs - before.fbs, dmabuf_count);
+    TEST_CHECK_EQ(stats.bufs - before.bufs, dmabuf_count);
+
+    // Step 2 : frame on screen stays until a flip takes it off
+    TEST_CHECK_EQ(xDRM_ReleaseDmabuf(dev, bufs[(120 - 1) % dmabuf_count].fd), -EBUSY);
+
+    TEST_CHECK_EQ(xDRM_Push(dev, frame.data(), frame.size() * 4), 0);
+    for (int i = 0; i < 3; i++)
+        xDRM_Wait_Present(dev);
+
+    // Step 3 : release hands back every fb and handle, once
+    for (int k = 0; k < dmabuf_count; k++)
+        TEST_CHECK_EQ(xDRM_ReleaseDmabuf(dev, bufs[k].fd), 0);
+    TEST_CHECK_EQ(xDRM_ReleaseDmabuf(dev, bufs[0].fd), -ENOENT);
+
+    xDRM_Headless_Get_Stats(&stats);
+    TEST_CHECK_EQ(stats.fbs, before.fbs);
+    TEST_CHECK_EQ(stats.bufs, before.bufs);
+
+    TEST_CHECK_EQ(xDRM_Get_Buffer_Stats(dev, &buf_stats), 0);
+    TEST_CHECK_EQ(buf_stats.state[MODESET_BUF_UNUSED], MODESET_IMPORT_MAX);
+
+    for (int k = 0; k < dmabuf_count; k++)
+    {
+        munmap(bufs[k].map, size);
+        close(bufs[k].fd);
+    }
+
+    TEST_CHECK_EQ(xDRM_Stop_Draw(dev), 0);
+    draw.join();
+    xDRM_Exit(fd, dev);
+
+    return test_result("test_import");
+}
@@ -0,0 +1,251 @@
+/**
+ * Buffer mailbox under contention: producers push and acquire from several threads while xDRM_Draw flips,
+ * every buffer has one owner at a time, every submitted frame is accounted once and the newest one is shown.
+ */
+
+#include "test.h"
+
+#include <thread>
+#include <vector>
+#include <cstring>
+
+static const uint32_t width = 640, height = 512;
+
+struct mailbox_run
+{
+    uint32_t producers;
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> value{1};
+    std::atomic<long> submitted{0};
+    std::atomic<long> busy{0};
+    // thread holding each buffer between acquire and submit, 0 when none
+    std::atomic<uint32_t> owner[MODESET_BUF_MAX];
+};
+
+/**
+ * @brief Fill a buffer with one value, read it back, another writer on it shows as a mixed buffer.
+ */
+static bool mailbox_fill(uint8_t *map, uint32_t stride, uint32_t value)
+{
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint32_t *row = (uint32_t *)(map + (size_t)y * stride);
+        for (uint32_t x = 0; x < width; x++)
+            row[x] = value;
+    }
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint32_t *row = (const uint32_t *)(map + (size_t)y * stride);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (row[x] != value)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Frame tag on screen, every frame is filled with its tag.
+ */
+static uint32_t mailbox_shown()
+{
+    struct xdrm_headless_plane plane;
+
+    if (xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &plane) < 0 || !plane.map)
+        return 0;
+
+    return *(const uint32_t *)(plane.map + plane.offsets[0]);
+}
+
+static void mailbox_producer(struct modeset_dev *dev, mailbox_run &run, uint32_t id)
+{
+    std::vector<uint32_t> frame((size_t)width * height);
+
+    while (!run.stop.load(std::memory_order_relaxed))
+    {
+        uint32_t value = run.value++;
+        long submitted;
+
+        // odd frames are written in place, even frames are copied through xDRM_Push
+        if (value & 1)
+        {
+            uint32_t expected = 0, stride = 0;
+            uint8_t *map = nullptr;
+            int index = xDRM_AcquireBuffer(dev, &map, &stride);
+
+            if (index == -EBUSY)
+            {
+                run.busy++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            TEST_CHECK(index >= 0 && index < (int)dev->buf_count);
+            if (index < 0 || index >= (int)dev->buf_count)
+                continue;
+
+            TEST_CHECK(run.owner[index].compare_exchange_strong(expected, id + 1));
+            TEST_CHECK(mailbox_fill(map, stride, value));
+            run.owner[index].store(0);
+
+            TEST_CHECK_EQ(xDRM_SubmitBuffer(dev, index), 0);
+        }
+        else
+        {
+            int ret;
+
+            std::fill(frame.begin(), frame.end(), value);
+            ret = xDRM_Push(dev, frame.data(), frame.size() * 4);
+
+            if (ret == -EBUSY)
+            {
+                run.busy++;
+                std::this_thread::yield();
+                continue;
+            }
+
+            TEST_CHECK_EQ(ret, 0);
+        }
+
+        // a lone producer is never refused, and a pause shows its last frame, not one queued before
+        submitted = ++run.submitted;
+        if (run.producers == 1 && submitted % 32 == 0)
+            TEST_CHECK(test_present_until(dev, [&] { return mailbox_shown() == value; }));
+    }
+}
+
+/**
+ * @brief Buffer on screen is never written, sampled rows hold one value while it stays on the plane.
+ */
+static bool mailbox_screen_intact(uint32_t plane_id)
+{
+    struct xdrm_headless_plane before, after;
+    uint32_t first;
+    bool intact = true;
+
+    if (xDRM_Headless_Get_Plane(plane_id, &before) < 0 || !before.map)
+        return true;
+
+    first = *(const uint32_t *)(before.map + before.offsets[0]);
+    for (uint32_t y = 0; y < height && intact; y += 7)
+    {
+        const uint32_t *row = (const uint32_t *)(before.map + before.offsets[0] + (size_t)y * before.pitches[0]);
+        for (uint32_t x = 0; x < width; x += 13)
+        {
+            if (row[x] != first)
+            {
+                intact = false;
+                break;
+            }
+        }
+    }
+
+    // flipped away meanwhile, the buffer went back to producers legitimately
+    if (xDRM_Headless_Get_Plane(plane_id, &after) < 0 || after.fb != before.fb)
+        return true;
+
+    return intact;
+}
+
+static void mailbox_round(uint32_t buf_count, uint32_t queue_depth, uint32_t producers, double seconds)
+{
+    std::vector<uint32_t> frame((size_t)width * height);
+    struct modeset_dev *dev = nullptr;
+    struct modeset_buf_stats buf_stats;
+    struct modeset_stats stats;
+    std::vector<std::thread> threads;
+    mailbox_run run;
+    long samples = 0, torn = 0;
+    uint32_t value;
+    int fd;
+
+    run.producers = producers;
+    for (auto &owner : run.owner)
+        owner.store(0);
+
+    fd = xDRM_Init(&dev, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, width, height, 0, 0, buf_count, DRM_FORMAT_ARGB8888);
+    TEST_CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+
+    TEST_CHECK_EQ(xDRM_Set_Queue_Depth(dev, queue_depth), 0);
+
+    std::thread draw([fd, dev] { xDRM_Draw(fd, dev); });
+    for (uint32_t i = 0; i < producers; i++)
+        threads.emplace_back(mailbox_producer, dev, std::ref(run), i);
+
+    // Step 1 : sample states and screen while producers and display race
+    for (double end = test_now_ns() + seconds * 1e9; test_now_ns() < end; samples++)
+    {
+        uint32_t owned = 0;
+
+        TEST_CHECK_EQ(xDRM_Get_Buffer_Stats(dev, &buf_stats), 0);
+        for (int s = MODESET_BUF_FREE; s <= MODESET_BUF_SCANOUT; s++)
+            owned += buf_stats.state[s];
+        TEST_CHECK_EQ(owned, buf_stats.count);
+        TEST_CHECK_EQ(buf_stats.state[MODESET_BUF_UNUSED], MODESET_IMPORT_MAX);
+        TEST_CHECK(buf_stats.state[MODESET_BUF_SCANOUT] <= 1);
+        TEST_CHECK(buf_stats.state[MODESET_BUF_QUEUED] <= queue_depth + producers);
+
+        if (!mailbox_screen_intact(PLANE_ID_DSI1))
+            torn++;
+
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    run.stop = true;
+    for (auto &thread : threads)
+        thread.join();
+
+    // newest frame takes the place of whatever still waits and reaches the screen
+    value = run.value++;
+    std::fill(frame.begin(), frame.end(), value);
+    TEST_CHECK_EQ(xDRM_Push(dev, frame.data(), frame.size() * 4), 0);
+    run.submitted++;
+    TEST_CHECK(test_present_until(dev, [&] { return mailbox_shown() == value; }));
+
+    // Step 2 : loop leaves through Stop_Draw
+    TEST_CHECK_EQ(xDRM_Stop_Draw(dev), 0);
+    draw.join();
+
+    // Step 3 : each submitted frame was shown, overwritten or still waits, never two of them
+    TEST_CHECK_EQ(xDRM_GetStats(dev, &stats), 0);
+    TEST_CHECK_EQ(xDRM_Get_Buffer_Stats(dev, &buf_stats), 0);
+    TEST_CHECK_EQ(buf_stats.state[MODESET_BUF_ACQUIRED], 0);
+    TEST_CHECK_EQ(stats.presented + stats.overwritten + buf_stats.state[MODESET_BUF_QUEUED], run.submitted.load());
+    TEST_CHECK_EQ(stats.busy, run.busy.load());
+    TEST_CHECK(stats.presented > 0);
+    TEST_CHECK_EQ(torn, 0);
+
+    // one buffer on screen and one in flight leave the producer a free or queued one
+    if (producers == 1)
+        TEST_CHECK_EQ(run.busy.load(), 0);
+
+    printf("buffers %u depth %u producers %u: submitted %ld presented %llu overwritten %llu busy %ld samples %ld\n",
+           buf_count, queue_depth, producers, run.submitted.load(), (unsigned long long)stats.presented,
+           (unsigned long long)stats.overwritten, run.busy.load(), samples);
+
+    xDRM_Exit(fd, dev);
+}
+
+int main()
+{
+    // fast refresh, many flips against the producers
+    struct xdrm_headless_config config = {width, height, 240, false};
+
+    xDRM_Set_Backend(&xdrm_backend_headless);
+    TEST_CHECK_EQ(xDRM_Headless_Configure(&config), 0);
+
+    // triple buffer mailbox, the newest frame takes the queued buffer back
+    mailbox_round(MODESET_BUF_DEFAULT, 1, 1, 1.0);
+    mailbox_round(MODESET_BUF_DEFAULT, 1, 4, 1.0);
+    // spare buffers, newer frames overwrite the queued one
+    mailbox_round(6, 1, 4, 1.0);
+    // FIFO, frames wait behind each other
+    mailbox_round(6, 3, 4, 1.0);
+
+    return test_result("test_mailbox");
+}
@@ -0,0 +1,204 @@
+/**
+ * Partial updates on the headless backend: xDRM_PushRegion mixed with xDRM_Push over five buffers scans out
+ * pixel exact, carried forward pixels included, and FB_DAMAGE_CLIPS goes along only with a frame which
+ * directly follows the one on screen.
+ */
+
+#include "test.h"
+
+#include <random>
+#include <vector>
+#include <thread>
+#include <cstring>
+
+static const uint32_t width = 640, height = 512;
+static const uint32_t buf_count = 5;
+
+// headless backend which checks damage of every commit against the frame it replaces
+static struct xdrm_backend region_checked;
+static struct modeset_dev *region_dev;
+static struct drm_mode_rect region_clip;
+static bool region_clip_pending;
+static std::atomic<long> region_damaged{0}, region_undamaged{0};
+
+static int region_create_property_blob(int fd, const void *data, size_t size, uint32_t *id)
+{
+    // damage is the only blob of the size of a rect created while drawing
+    if (region_dev && size == sizeof(region_clip))
+    {
+        memcpy(&region_clip, data, size);
+        region_clip_pending = true;
+    }
+
+    return xdrm_backend_headless.create_property_blob(fd, data, size, id);
+}
+
+/**
+ * @brief Buffer of dev scanning out fb, -1 for none.
+ */
+static int region_buf(uint32_t fb)
+{
+    for (uint32_t i = 0; i < region_dev->buf_count; i++)
+    {
+        if (region_dev->bufs[i].fb == fb)
+            return i;
+    }
+
+    return -1;
+}
+
+static int region_atomic_commit(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *user_data)
+{
+    struct xdrm_headless_plane before, after;
+    bool damaged = region_clip_pending;
+    int ret, prev, next;
+
+    if (!region_dev || (flags & DRM_MODE_ATOMIC_TEST_ONLY))
+        return xdrm_backend_headless.atomic_commit(fd, req, flags, user_data);
+    region_clip_pending = false;
+
+    xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &before);
+    ret = xdrm_backend_headless.atomic_commit(fd, req, flags, user_data);
+    xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &after);
+
+    // plane turned on by xDRM_Init or off by xDRM_Exit, no frame follows another
+    if (!before.fb || !after.fb)
+        return ret;
+
+    if (ret < 0 || after.fb == before.fb)
+    {
+        TEST_CHECK(ret < 0 || !damaged);
+        return ret;
+    }
+
+    // buffers in flight and on screen stay put while the commit runs
+    prev = region_buf(before.fb);
+    next = region_buf(after.fb);
+    TEST_CHECK(prev >= 0 && next >= 0);
+    if (prev < 0 || next < 0)
+        return ret;
+
+    TEST_CHECK_EQ(damaged, region_dev->bufs[next].seq == region_dev->bufs[prev].seq + 1);
+    if (damaged)
+    {
+        const struct modeset_rect &damage = region_dev->bufs[next].damage;
+
+        TEST_CHECK_EQ(region_clip.x1, (int32_t)damage.x);
+        TEST_CHECK_EQ(region_clip.y1, (int32_t)damage.y);
+        TEST_CHECK_EQ(region_clip.x2, (int32_t)(damage.x + damage.width));
+        TEST_CHECK_EQ(region_clip.y2, (int32_t)(damage.y + damage.height));
+        region_damaged++;
+    }
+    else
+    {
+        region_undamaged++;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Plane shows image pixel for pixel.
+ */
+static bool region_shows(const std::vector<uint32_t> &image)
+{
+    struct xdrm_headless_plane plane;
+
+    if (xDRM_Headless_Get_Plane(PLANE_ID_DSI1, &plane) < 0 || !plane.map)
+        return false;
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        if (memcmp(plane.map + plane.offsets[0] + (size_t)y * plane.pitches[0], &image[(size_t)y * width], width * 4))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Next frame, a full push or a random region, applied to reference as the plane should show it.
+ */
+static int region_step(std::mt19937 &rng, std::vector<uint32_t> &reference, std::vector<uint32_t> &frame, bool full)
+{
+    struct modeset_rect rect;
+    uint32_t seed = rng();
+
+    if (full)
+    {
+        for (size_t i = 0; i < frame.size(); i++)
+            frame[i] = 0xFF000000 | (uint32_t)(i * 2654435761u + seed);
+
+        reference = frame;
+        return xDRM_Push(region_dev, frame.data(), frame.size() * 4);
+    }
+
+    rect.width = 1 + rng() % (width / 2);
+    rect.height = 1 + rng() % (height / 2);
+    rect.x = rng() % (width - rect.width + 1);
+    rect.y = rng() % (height - rect.height + 1);
+
+    // region is packed in frame with a padded stride
+    for (uint32_t y = 0; y < rect.height; y++)
+    {
+        for (uint32_t x = 0; x < rect.width; x++)
+        {
+            uint32_t pixel = 0xFF000000 | ((x * 31 + y * 17) ^ seed);
+
+            frame[(size_t)y * (rect.width + 3) + x] = pixel;
+            reference[(size_t)(rect.y + y) * width + rect.x + x] = pixel;
+        }
+    }
+
+    return xDRM_PushRegion(region_dev, &rect, frame.data(), (rect.width + 3) * 4);
+}
+
+int main()
+{
+    struct xdrm_headless_config config = {width, height, 120, false};
+    std::vector<uint32_t> reference((size_t)width * height, 0), frame((size_t)width * height);
+    std::mt19937 rng(2024);
+    int fd;
+
+    region_checked = xdrm_backend_headless;
+    region_checked.create_property_blob = region_create_property_blob;
+    region_checked.atomic_commit = region_atomic_commit;
+    xDRM_Set_Backend(&region_checked);
+    TEST_CHECK_EQ(xDRM_Headless_Configure(&config), 0);
+
+    fd = xDRM_Init(&region_dev, CONN_ID_DSI1, CRTC_ID_DSI1, PLANE_ID_DSI1, width, height, 0, 0, buf_count, DRM_FORMAT_ARGB8888);
+    TEST_CHECK(fd >= 0);
+    if (fd < 0)
+        return test_result("test_region");
+
+    std::thread draw([fd] { xDRM_Draw(fd, region_dev); });
+
+    // Step 1 : one frame per vblank, every region is carried forward from the frame before it
+    for (int f = 0; f < 60; f++)
+    {
+        TEST_CHECK_EQ(region_step(rng, reference, frame, f % 8 == 0), 0);
+        TEST_CHECK(test_present_until(region_dev, [&] { return region_shows(reference); }));
+    }
+
+    // Step 2 : bursts, queued frames are overwritten and a buffer misses several frames before it is reused
+    for (int f = 0; f < 60; f++)
+    {
+        int burst = 1 + rng() % 6;
+
+        for (int i = 0; i < burst; i++)
+            TEST_CHECK_EQ(region_step(rng, reference, frame, rng() % 10 == 0), 0);
+        TEST_CHECK(test_present_until(region_dev, [&] { return region_shows(reference); }));
+    }
+
+    TEST_CHECK_EQ(xDRM_Stop_Draw(region_dev), 0);
+    draw.join();
+
+    printf("flips with damage %ld without %ld\n", region_damaged.load(), region_undamaged.load());
+    TEST_CHECK(region_damaged > 0);
+    TEST_CHECK(region_undamaged > 0);
+
+    xDRM_Exit(fd, region_dev);
+    region_dev = nullptr;
+
+    return test_result("test_region");
+}